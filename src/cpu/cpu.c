@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "types.h"
@@ -59,6 +60,31 @@ int cpu_exec(struct cpu *c)
 	return c->cpu->cops->exec(c);
 }
 
+/**
+ * Run cpu for at most budget instructions. The cpu stops earlier on error
+ * mode, on caught trap, on PC breakpoint or on device stop request.
+ *
+ * @param c: cpu instance
+ * @param budget: Maximum number of instructions to execute
+ * @param res: Filled with the reason the cpu stopped and the number of
+ * executed instructions
+ * @return: 0 on success, negative number otherwise
+ */
+int cpu_run(struct cpu *c, size_t budget, struct cpu_run *res)
+{
+	return c->cpu->cops->run(c, budget, res);
+}
+
+/**
+ * Request a running cpu to stop before its next instruction
+ *
+ * @param c: cpu instance
+ */
+void cpu_stop_request(struct cpu *c)
+{
+	c->stopreq = 1;
+}
+
 /**
  * Boot a specific cpu
  *
@@ -92,6 +118,7 @@ struct cpu *cpu_create(struct cpucfg const *cpu)
 		return NULL;
 
 	c->cpu = cdesc;
+	c->stopreq = 0;
 	strcpy(c->name, cpu->name);
 	list_add_tail(&c->next, &cpulst);
 	return c;
@@ -128,3 +155,95 @@ struct cpu *cpu_get(char const *name)
 out:
 	return cpu;
 }
+
+/**
+ * Saved state of one cpu
+ */
+struct cpu_snapshot_entry {
+	struct cpu *cpu;
+	void *data;
+};
+
+/**
+ * Saved state of all cpus
+ */
+struct cpu_snapshot {
+	size_t nr;
+	struct cpu_snapshot_entry cpu[];
+};
+
+/**
+ * Save state of every cpu. Cpus must not be created or destroyed while
+ * snapshot is in use.
+ *
+ * @return: New snapshot, NULL pointer on error
+ */
+struct cpu_snapshot *cpu_snapshot_take(void)
+{
+	struct cpu_snapshot *snap;
+	struct cpu *c;
+	size_t nr = 0;
+	int ret;
+
+	list_for_each_entry(c, &cpulst, next) {
+		if(!c->cpu->cops->snapshot)
+			return NULL;
+		++nr;
+	}
+
+	snap = malloc(sizeof(*snap) + nr * sizeof(*snap->cpu));
+	if(snap == NULL)
+		return NULL;
+
+	snap->nr = 0;
+	list_for_each_entry(c, &cpulst, next) {
+		ret = c->cpu->cops->snapshot(c, &snap->cpu[snap->nr].data);
+		if(ret != 0) {
+			cpu_snapshot_free(snap);
+			return NULL;
+		}
+		snap->cpu[snap->nr].cpu = c;
+		++snap->nr;
+	}
+
+	return snap;
+}
+
+/**
+ * Restore state of every cpu from a snapshot
+ *
+ * @param snap: Snapshot to restore
+ * @return: 0 on success, negative number otherwise
+ */
+int cpu_snapshot_restore(struct cpu_snapshot const *snap)
+{
+	struct cpu *c;
+	size_t i;
+	int ret;
+
+	for(i = 0; i < snap->nr; ++i) {
+		c = snap->cpu[i].cpu;
+		ret = c->cpu->cops->restore(c, snap->cpu[i].data);
+		if(ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * Free a cpu snapshot
+ *
+ * @param snap: Snapshot to free
+ */
+void cpu_snapshot_free(struct cpu_snapshot *snap)
+{
+	struct cpu *c;
+	size_t i;
+
+	for(i = 0; i < snap->nr; ++i) {
+		c = snap->cpu[i].cpu;
+		c->cpu->cops->snapshot_free(c, snap->cpu[i].data);
+	}
+	free(snap);
+}
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+
+#include "isn.h"
+#include "icache.h"
+#include "block.h"
+
+/**
+ * Instruction kind regarding block formation
+ */
+enum block_isn {
+	/* Instruction does not end a block */
+	BI_NONE,
+	/* Delayed control transfer instruction, ends block after delay slot */
+	BI_DCTI,
+	/* Trap instruction, ends block */
+	BI_TICC,
+	/* Instruction that can change instruction memory, ends block */
+	BI_END,
+};
+
+/**
+ * Get how an instruction takes part in block formation
+ */
+static inline enum block_isn block_isn_kind(struct sparc_isn const *isn)
+{
+	if((isn->id == SI_CALL) || (isn->id == SI_JMPL) ||
+			(isn->id == SI_RETT) ||
+			((isn->id >= SI_BN) && (isn->id <= SI_BVS)))
+		return BI_DCTI;
+
+	if((isn->id >= SI_TA) && (isn->id <= SI_TVS))
+		return BI_TICC;
+
+	/* Supervisor bit change selects another instruction memory */
+	if(isn->id == SI_WRPSR)
+		return BI_END;
+
+	return BI_NONE;
+}
+
+/**
+ * Fetch a block instruction that is on the same page as the block start
+ *
+ * @return: 0 on success, negative number if instruction cannot be part of the
+ * block
+ */
+static inline int block_fetch(struct icache *ic, struct dev *mem, addr_t pc,
+		addr_t addr, union sparc_isn_fill *isn)
+{
+	if(ICACHE_PAGE_ADDR(addr) != ICACHE_PAGE_ADDR(pc))
+		return -1;
+
+	if(icache_fetch(ic, mem, addr, isn) != 0)
+		return -1;
+
+	if(isn->isn.fmt == SIF_UNKNOW)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Fuse block instruction pairs, an instruction cannot be part of two pairs
+ * and a delay slot is never fused
+ *
+ * @param b: Block to fuse instructions of
+ */
+static void block_fuse(struct block *b)
+{
+	uint8_t i, nr = b->nr;
+
+	if(b->end == BE_DCTI)
+		--nr;
+
+	for(i = 0; i < b->nr; ++i)
+		b->isn[i].isn.fuse = SF_NONE;
+
+	for(i = 0; i + 1 < nr; ++i) {
+		b->isn[i].isn.fuse = isn_get_fuse(&b->isn[i].isn,
+				&b->isn[i + 1].isn);
+		if(b->isn[i].isn.fuse != SF_NONE)
+			++i;
+	}
+}
+
+/**
+ * Build a block from predecoded instructions. A block does not cross a
+ * predecoded page boundary, a delayed control transfer instruction is only
+ * part of a block along with its delay slot.
+ *
+ * @param b: Block slot to fill
+ * @param ic: Instruction cache
+ * @param mem: Instruction memory device
+ * @param pc: Block first instruction address
+ *
+ * @return: 0 on success, negative number if no block can start at pc
+ */
+static int block_build(struct block *b, struct icache *ic, struct dev *mem,
+		addr_t pc)
+{
+	enum block_isn kind;
+	addr_t addr = pc;
+	uint8_t nr;
+
+	b->pc = BLOCK_INVAL;
+	b->end = BE_NONE;
+	b->succ[0] = NULL;
+	b->succ[1] = NULL;
+#ifdef SPARC_JIT
+	b->hot = 0;
+	b->jit = NULL;
+#endif
+
+	for(nr = 0; nr < BLOCK_MAXISN; ++nr, addr += sizeof(opcode)) {
+		if(block_fetch(ic, mem, pc, addr, &b->isn[nr]) != 0)
+			break;
+
+		kind = block_isn_kind(&b->isn[nr].isn);
+		if(kind == BI_TICC) {
+			b->end = BE_TICC;
+			++nr;
+			break;
+		} else if(kind == BI_END) {
+			++nr;
+			break;
+		} else if(kind != BI_DCTI) {
+			continue;
+		}
+
+		/* Delay slot must fit in the block and cannot be a CTI */
+		if((nr + 1 >= BLOCK_MAXISN) ||
+				(block_fetch(ic, mem, pc, addr + sizeof(opcode),
+					&b->isn[nr + 1]) != 0) ||
+				(block_isn_kind(&b->isn[nr + 1].isn) == BI_DCTI) ||
+				(block_isn_kind(&b->isn[nr + 1].isn) == BI_TICC))
+			break;
+
+		b->end = BE_DCTI;
+		nr += 2;
+		break;
+	}
+
+	if(nr == 0)
+		return -1;
+
+	b->page = icache_page(ic, mem, pc);
+	if(b->page == NULL)
+		return -1;
+
+	b->gen = b->page->gen;
+	b->mem = mem;
+	b->nr = nr;
+	b->pc = pc;
+	block_fuse(b);
+	return 0;
+}
+
+/**
+ * Initialize an empty block cache
+ *
+ * @param bc: Block cache to initialize
+ * @return: 0 on success, negative number otherwise
+ */
+int bcache_init(struct block_cache *bc)
+{
+	bc->blk = NULL;
+	return 0;
+}
+
+/**
+ * Release block cache
+ *
+ * @param bc: Block cache to cleanup
+ */
+void bcache_cleanup(struct block_cache *bc)
+{
+	free(bc->blk);
+	bc->blk = NULL;
+}
+
+/**
+ * Get the block starting at a specific address, building it if needed. Block
+ * slots are never released, so that chained successors pointers are always
+ * safe to dereference (but have to be checked with block_valid()).
+ *
+ * @param bc: Block cache
+ * @param ic: Instruction cache to build block from
+ * @param mem: Instruction memory device
+ * @param pc: Block first instruction address
+ *
+ * @return: The block, NULL pointer if no block can start at this address
+ */
+struct block *bcache_get(struct block_cache *bc, struct icache *ic,
+		struct dev *mem, addr_t pc)
+{
+	struct block *b;
+	size_t i;
+
+	if(bc->blk == NULL) {
+		bc->blk = malloc(BLOCK_NR * sizeof(*bc->blk));
+		if(bc->blk == NULL)
+			return NULL;
+
+		for(i = 0; i < BLOCK_NR; ++i)
+			bc->blk[i].pc = BLOCK_INVAL;
+	}
+
+	b = &bc->blk[BLOCK_SLOT(pc)];
+	if(block_valid(b, mem, pc))
+		return b;
+
+	if(block_build(b, ic, mem, pc) != 0)
+		return NULL;
+
+	return b;
+}
@@ -0,0 +1,92 @@
+#ifndef _BLOCK_H_
+#define _BLOCK_H_
+
+#include "dev/device.h"
+
+#include "isn.h"
+#include "icache.h"
+#ifdef SPARC_JIT
+#include "jit.h"
+#endif
+
+/* Maximum number of instructions in a block, delay slot included */
+#define BLOCK_MAXISN 32
+/* Number of cached blocks */
+#define BLOCK_NR 1024
+#define BLOCK_SLOT(a) (((a) >> 2) % BLOCK_NR)
+/* Instructions are aligned, thus this cannot match any block */
+#define BLOCK_INVAL ((addr_t)1)
+
+/**
+ * How a block ends
+ */
+enum block_end {
+	/* Block falls through to next instruction */
+	BE_NONE,
+	/* Block ends with a delayed control transfer and its delay slot */
+	BE_DCTI,
+	/* Block ends with a Ticc (which has no delay slot) */
+	BE_TICC,
+};
+
+/**
+ * Straight-line run of predecoded instructions
+ */
+struct block {
+	/* Block first instruction address, BLOCK_INVAL if slot is not used */
+	addr_t pc;
+	/* Instruction memory device the block has been fetched from */
+	struct dev *mem;
+	/* Predecoded instruction page the block has been built from */
+	struct icache_page *page;
+	/* Page generation the block is valid for */
+	uint32_t gen;
+	/* Number of instructions in the block */
+	uint8_t nr;
+	/* How the block ends */
+	enum block_end end;
+	/* Chained successor blocks, direct jump target and fall through */
+	struct block *succ[2];
+#ifdef SPARC_JIT
+	/* Number of executions since last compilation attempt */
+	uint32_t hot;
+	/* Code arena generation the block has been compiled in */
+	uint32_t jitgen;
+	/* Native code, NULL if block is not compiled */
+	jit_fn jit;
+#endif
+	/* Predecoded instructions */
+	union sparc_isn_fill isn[BLOCK_MAXISN];
+};
+
+/**
+ * Direct mapped basic block cache, indexed by guest PC
+ */
+struct block_cache {
+	/* Lazily allocated block slots */
+	struct block *blk;
+};
+
+int bcache_init(struct block_cache *bc);
+void bcache_cleanup(struct block_cache *bc);
+struct block *bcache_get(struct block_cache *bc, struct icache *ic,
+		struct dev *mem, addr_t pc);
+
+/**
+ * Check a block is still valid for an address
+ *
+ * @param b: Block to check
+ * @param mem: Instruction memory device
+ * @param pc: Instruction virtual address
+ *
+ * @return: 1 if block can be executed, 0 otherwise
+ */
+static inline int block_valid(struct block const *b, struct dev *mem,
+		addr_t pc)
+{
+	return (b->pc == pc) && (b->mem == mem) &&
+		(b->page->addr == ICACHE_PAGE_ADDR(pc)) &&
+		(b->page->mem == mem) && (b->page->gen == b->gen);
+}
+
+#endif
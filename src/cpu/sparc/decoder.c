@@ -39,7 +39,7 @@ static int isn_decode_op1(struct sparc_isn *isn)
 #define ISN_OP2_COND(o) (((o) >> 25) & 0xf)
 #define ISN_OP2_A(o) (((o) >> 29) & 0x1)
 #define ISN_OP2_IMM(o) ((o) & 0x3fffff)
-#define ISN_OP2_DISP(o) (sign_ext((o) & 0x3fffff, 22))
+#define ISN_OP2_DISP(o) (sign_ext((o) & 0x3fffff, 21))
 
 /**
  * Decode a sethi type instruction
@@ -373,11 +373,18 @@ int isn_decode(struct sparc_isn *isn)
 		[3] = isn_decode_op3_3,
 	};
 	uint8_t flag;
+	int ret = 0;
 
 	flag = op_decode_flag0(isn->op);
 	if((flag < ARRAY_SIZE(_decode_op0)) && _decode_op0[flag])
-		return _decode_op0[flag](isn);
+		ret = _decode_op0[flag](isn);
 
-	return 0;
+	if(ret == 0) {
+		isn->hdl = isn_get_handler(isn->id);
+		isn->xop = isn_get_xop(isn);
+		isn->fuse = SF_NONE;
+	}
+
+	return ret;
 }
 
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+
+#include "hmem.h"
+
+/**
+ * Drop all cached host memory pages. This has to be called when virtual to
+ * host memory mapping may have changed.
+ *
+ * @param hc: Host memory cache to flush
+ */
+void hmem_flush(struct hmem_cache *hc)
+{
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(hc->page); ++i)
+		hc->page[i].mem = NULL;
+}
+
+/**
+ * Look a virtual page up in memory device and cache its host memory.
+ * Device without host memory are remembered so that they are not looked up
+ * on each access.
+ *
+ * @param hc: Host memory cache
+ * @param mem: Memory device the address belongs to
+ * @param addr: Virtual address
+ * @param perm: Needed direct access permission
+ *
+ * @return: Host address, NULL if memory has to be accessed through device
+ */
+uint8_t *hmem_fill(struct hmem_cache *hc, struct dev *mem, addr_t addr,
+		perm_t perm)
+{
+	struct hmem_page *p = &hc->page[HMEM_PAGE_SLOT(addr)];
+	struct dev_hostmem hm;
+	addr_t pg = HMEM_PAGE_ADDR(addr);
+	int ret;
+
+	hm.pending = 0;
+	ret = dev_hostmem(mem, pg, &hm);
+	if(ret == -ENOSYS) {
+		p->mem = mem;
+		p->addr = pg;
+		p->perm = 0;
+		p->pending = 0;
+		p->host = NULL;
+		return NULL;
+	}
+
+	/* Only cache pages that are entirely backed by host memory */
+	if((ret != 0) || (hm.addr > pg) ||
+			(hm.addr + hm.sz < (phyaddr_t)pg + HMEM_PAGE_SZ))
+		return NULL;
+
+	p->mem = mem;
+	p->addr = pg;
+	p->perm = hm.perm;
+	p->pending = hm.pending;
+	p->host = hm.host + (pg - hm.addr);
+
+	if(!(p->perm & perm))
+		return NULL;
+
+	return p->host + (addr & HMEM_PAGE_MASK);
+}
@@ -0,0 +1,188 @@
+#ifndef _HMEM_H_
+#define _HMEM_H_
+
+#include <string.h>
+
+#include "types.h"
+#include "dev/device.h"
+
+#define HMEM_PAGE_SHIFT 12
+#define HMEM_PAGE_SZ (1 << HMEM_PAGE_SHIFT)
+#define HMEM_PAGE_MASK (HMEM_PAGE_SZ - 1)
+#define HMEM_PAGE_ADDR(a) ((a) & ~HMEM_PAGE_MASK)
+#define HMEM_NRPAGE 64
+#define HMEM_PAGE_SLOT(a) (((a) >> HMEM_PAGE_SHIFT) % HMEM_NRPAGE)
+
+/**
+ * Virtual memory page that can be accessed through host memory
+ */
+struct hmem_page {
+	/* Memory device the page belongs to, NULL if slot is not used */
+	struct dev *mem;
+	/* Page virtual address */
+	addr_t addr;
+	/* Allowed direct accesses, 0 if page has no host memory */
+	perm_t perm;
+	/* Direct accesses a later look up could allow */
+	perm_t pending;
+	/* Host address of page first byte */
+	uint8_t *host;
+};
+
+/**
+ * Direct mapped cache of host memory pointers, indexed by virtual address
+ */
+struct hmem_cache {
+	struct hmem_page page[HMEM_NRPAGE];
+};
+
+void hmem_flush(struct hmem_cache *hc);
+uint8_t *hmem_fill(struct hmem_cache *hc, struct dev *mem, addr_t addr,
+		perm_t perm);
+
+/**
+ * Get host address of a virtual address
+ *
+ * @param hc: Host memory cache
+ * @param mem: Memory device the address belongs to
+ * @param addr: Virtual address
+ * @param perm: Needed direct access permission
+ *
+ * @return: Host address, NULL if memory has to be accessed through device
+ */
+static inline uint8_t *hmem_get(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, perm_t perm)
+{
+	struct hmem_page *p = &hc->page[HMEM_PAGE_SLOT(addr)];
+
+	if((p->mem != mem) || (p->addr != HMEM_PAGE_ADDR(addr)))
+		return hmem_fill(hc, mem, addr, perm);
+
+	if(p->perm & perm)
+		return p->host + (addr & HMEM_PAGE_MASK);
+
+	/* Permission can be granted later (e.g. PTE R/M bits), look up again */
+	if(p->pending & perm)
+		p->mem = NULL;
+
+	return NULL;
+}
+
+static inline int hmem_read8(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint8_t *val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_R);
+
+	if(h == NULL)
+		return dev_read8(mem, addr, val);
+	*val = *h;
+	return 0;
+}
+
+static inline int hmem_read16(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint16_t *val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_R);
+
+	if(h == NULL)
+		return dev_read16(mem, addr, val);
+	*val = *(uint16_t *)h;
+	return 0;
+}
+
+static inline int hmem_read32(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint32_t *val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_R);
+
+	if(h == NULL)
+		return dev_read32(mem, addr, val);
+	*val = *(uint32_t *)h;
+	return 0;
+}
+
+static inline int hmem_read64(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint64_t *val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_R);
+	uint32_t w[2];
+	int ret;
+
+	if(h != NULL) {
+		*val = *(uint64_t *)h;
+		return 0;
+	}
+
+	ret = dev_read64(mem, addr, val);
+	if(ret != -ENOSYS)
+		return ret;
+
+	/* Device without 64 bit accesses, split them */
+	ret = dev_read32(mem, addr, &w[0]);
+	if(ret != 0)
+		return ret;
+	ret = dev_read32(mem, addr + 4, &w[1]);
+	if(ret != 0)
+		return ret;
+	memcpy(val, w, sizeof(w));
+	return 0;
+}
+
+static inline int hmem_write8(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint8_t val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_W);
+
+	if(h == NULL)
+		return dev_write8(mem, addr, val);
+	*h = val;
+	return 0;
+}
+
+static inline int hmem_write16(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint16_t val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_W);
+
+	if(h == NULL)
+		return dev_write16(mem, addr, val);
+	*(uint16_t *)h = val;
+	return 0;
+}
+
+static inline int hmem_write32(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint32_t val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_W);
+
+	if(h == NULL)
+		return dev_write32(mem, addr, val);
+	*(uint32_t *)h = val;
+	return 0;
+}
+
+static inline int hmem_write64(struct hmem_cache *hc, struct dev *mem,
+		addr_t addr, uint64_t val)
+{
+	uint8_t *h = hmem_get(hc, mem, addr, MP_W);
+	uint32_t w[2];
+	int ret;
+
+	if(h != NULL) {
+		*(uint64_t *)h = val;
+		return 0;
+	}
+
+	ret = dev_write64(mem, addr, val);
+	if(ret != -ENOSYS)
+		return ret;
+
+	/* Device without 64 bit accesses, split them */
+	memcpy(w, &val, sizeof(w));
+	ret = dev_write32(mem, addr, w[0]);
+	if(ret != 0)
+		return ret;
+	return dev_write32(mem, addr + 4, w[1]);
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+
+#include "isn.h"
+#include "icache.h"
+
+/**
+ * Initialize an empty instruction cache
+ *
+ * @param ic: Instruction cache to initialize
+ */
+void icache_init(struct icache *ic)
+{
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(ic->page); ++i)
+		ic->page[i] = NULL;
+}
+
+/**
+ * Release all instruction cache pages
+ *
+ * @param ic: Instruction cache to cleanup
+ */
+void icache_cleanup(struct icache *ic)
+{
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(ic->page); ++i) {
+		free(ic->page[i]);
+		ic->page[i] = NULL;
+	}
+}
+
+/**
+ * Invalidate the whole instruction cache
+ *
+ * @param ic: Instruction cache to flush
+ */
+void icache_flush(struct icache *ic)
+{
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(ic->page); ++i)
+		if(ic->page[i] != NULL) {
+			ic->page[i]->addr = ICACHE_INVAL;
+			++ic->page[i]->gen;
+		}
+}
+
+/**
+ * Get the predecoded page that caches a virtual address, (re)allocating its
+ * slot if needed.
+ *
+ * @param ic: Instruction cache
+ * @param mem: Instruction memory device
+ * @param addr: Instruction virtual address
+ *
+ * @return: Cache page, NULL pointer if page cannot be allocated
+ */
+static struct icache_page *icache_get_page(struct icache *ic, struct dev *mem,
+		addr_t addr)
+{
+	struct icache_page **p = &ic->page[ICACHE_PAGE_SLOT(addr)];
+	size_t i;
+
+	if(*p == NULL) {
+		*p = malloc(sizeof(**p));
+		if(*p == NULL)
+			return NULL;
+		(*p)->gen = 0;
+	} else if(((*p)->addr == ICACHE_PAGE_ADDR(addr)) && ((*p)->mem == mem)) {
+		return *p;
+	}
+
+	(*p)->addr = ICACHE_PAGE_ADDR(addr);
+	(*p)->mem = mem;
+	++(*p)->gen;
+	for(i = 0; i < ARRAY_SIZE((*p)->isn); ++i)
+		(*p)->isn[i].isn.fmt = SIF_UNKNOW;
+
+	return *p;
+}
+
+/**
+ * Fetch a predecoded instruction, the instruction is read and decoded on cache
+ * miss. If the instruction cannot be decoded it is returned undecoded (with a
+ * SIF_UNKNOW fmt) and is not cached.
+ *
+ * @param ic: Instruction cache
+ * @param mem: Instruction memory device
+ * @param addr: Instruction virtual address
+ * @param isn: Filled with fetched instruction
+ *
+ * @return: 0 on success, negative number if instruction cannot be fetched
+ */
+int icache_fetch(struct icache *ic, struct dev *mem, addr_t addr,
+		union sparc_isn_fill *isn)
+{
+	struct icache_page *p = ic->page[ICACHE_PAGE_SLOT(addr)];
+	union sparc_isn_fill *e;
+	uint32_t rd;
+	int ret;
+
+	/* Fast path, instruction already decoded */
+	if((p != NULL) && (p->addr == ICACHE_PAGE_ADDR(addr)) &&
+			(p->mem == mem)) {
+		e = &p->isn[ICACHE_ISN_IDX(addr)];
+		if(e->isn.fmt != SIF_UNKNOW) {
+			*isn = *e;
+			return 0;
+		}
+	}
+
+	ret = dev_read32(mem, addr, &rd);
+	if(ret != 0)
+		return ret;
+
+	isn->isn.op = (opcode)be32toh(rd);
+	isn->isn.fmt = SIF_UNKNOW;
+	if(isn_decode(&isn->isn) != 0) {
+		isn->isn.fmt = SIF_UNKNOW;
+		return 0;
+	}
+
+	p = icache_get_page(ic, mem, addr);
+	if(p != NULL)
+		p->isn[ICACHE_ISN_IDX(addr)] = *isn;
+
+	return 0;
+}
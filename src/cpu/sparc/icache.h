@@ -0,0 +1,92 @@
+#ifndef _ICACHE_H_
+#define _ICACHE_H_
+
+#include "dev/device.h"
+
+#include "isn.h"
+
+#define ICACHE_PAGE_SHIFT 12
+#define ICACHE_PAGE_SZ (1 << ICACHE_PAGE_SHIFT)
+#define ICACHE_PAGE_MASK (ICACHE_PAGE_SZ - 1)
+#define ICACHE_PAGE_ADDR(a) ((a) & ~ICACHE_PAGE_MASK)
+#define ICACHE_PAGE_NRISN (ICACHE_PAGE_SZ / sizeof(opcode))
+#define ICACHE_ISN_IDX(a) (((a) & ICACHE_PAGE_MASK) / sizeof(opcode))
+#define ICACHE_NRPAGE 64
+#define ICACHE_PAGE_SLOT(a) (((a) >> ICACHE_PAGE_SHIFT) % ICACHE_NRPAGE)
+/* Page addresses are aligned, thus this cannot match any page */
+#define ICACHE_INVAL ((addr_t)1)
+
+/**
+ * Page of predecoded instructions
+ */
+struct icache_page {
+	/* Page virtual address, ICACHE_INVAL if page is not used */
+	addr_t addr;
+	/* Instruction memory device the page has been fetched from */
+	struct dev *mem;
+	/* Generation, changes each time a predecoded instruction is dropped */
+	uint32_t gen;
+	/* Predecoded instructions, not decoded yet if fmt is SIF_UNKNOW */
+	union sparc_isn_fill isn[ICACHE_PAGE_NRISN];
+};
+
+/**
+ * Direct mapped predecoded instruction cache, indexed by guest PC
+ */
+struct icache {
+	/* Lazily allocated predecoded pages */
+	struct icache_page *page[ICACHE_NRPAGE];
+};
+
+void icache_init(struct icache *ic);
+void icache_cleanup(struct icache *ic);
+int icache_fetch(struct icache *ic, struct dev *mem, addr_t addr,
+		union sparc_isn_fill *isn);
+void icache_flush(struct icache *ic);
+
+/**
+ * Invalidate predecoded instructions overlapping a memory range
+ *
+ * @param ic: Instruction cache
+ * @param addr: Start of modified memory range
+ * @param sz: Size of modified memory range in bytes
+ */
+static inline void icache_inval(struct icache *ic, addr_t addr, size_t sz)
+{
+	struct icache_page *p = ic->page[ICACHE_PAGE_SLOT(addr)];
+	size_t i;
+
+	if((p == NULL) || (p->addr != ICACHE_PAGE_ADDR(addr)))
+		return;
+
+	/* Accesses are naturally aligned, and cannot cross a page boundary */
+	for(i = ICACHE_ISN_IDX(addr); i <= ICACHE_ISN_IDX(addr + sz - 1); ++i) {
+		if(p->isn[i].isn.fmt != SIF_UNKNOW) {
+			p->isn[i].isn.fmt = SIF_UNKNOW;
+			++p->gen;
+		}
+	}
+}
+
+/**
+ * Get the cache page holding a virtual address, if any
+ *
+ * @param ic: Instruction cache
+ * @param mem: Instruction memory device
+ * @param addr: Instruction virtual address
+ *
+ * @return: Cache page, NULL pointer if address is not cached
+ */
+static inline struct icache_page *icache_page(struct icache *ic,
+		struct dev *mem, addr_t addr)
+{
+	struct icache_page *p = ic->page[ICACHE_PAGE_SLOT(addr)];
+
+	if((p == NULL) || (p->addr != ICACHE_PAGE_ADDR(addr)) ||
+			(p->mem != mem))
+		return NULL;
+
+	return p;
+}
+
+#endif
@@ -133,10 +133,74 @@ enum sid_isn {
 	SI_UNIMP,
 };
 
+/* Define both immediate and register specialized operations */
+#define SX_FMT3(n) SX_ ## n ## _IMM, SX_ ## n ## _REG
+
+/**
+ * Specialized execution operations, selected at decode time from instruction
+ * id and format. Instructions without specialized operation are executed
+ * through their generic handler (SX_GENERIC).
+ */
+enum sxop_isn {
+	SX_GENERIC = 0,
+	SX_FMT3(FMT3),
+	SX_SETHI,
+	SX_CALL,
+	SX_BA,
+	SX_BICC,
+	SX_BNE,
+	SX_BE,
+	/* Following operations cannot trap and do not use PC */
+	SX_FMT3(ADD),
+	SX_FMT3(ADDCC),
+	SX_FMT3(SUB),
+	SX_FMT3(SUBCC),
+	SX_FMT3(AND),
+	SX_FMT3(ANDCC),
+	SX_FMT3(ANDN),
+	SX_FMT3(OR),
+	SX_FMT3(ORCC),
+	SX_FMT3(XOR),
+	SX_FMT3(XORCC),
+	SX_FMT3(SLL),
+	SX_FMT3(SRL),
+	SX_FMT3(SRA),
+	SX_NR,
+};
+
+/* Is specialized operation unable to trap and independent from PC */
+#define SX_IS_PURE(x) (((x) == SX_SETHI) || ((x) >= SX_ADD_IMM))
+
+/**
+ * Fused instruction pairs, selected when a block is built. A fused
+ * instruction is executed along with the following one with a single
+ * dispatch.
+ */
+enum sfuse_isn {
+	SF_NONE = 0,
+	/* sethi %hi(x), rd; or rd, %lo(x), rd */
+	SF_SETHI_OR,
+	/* sethi %hi(x), rd; ld/st [rd + %lo(x)] */
+	SF_SETHI_MEM,
+	/* subcc (or cmp) followed by a conditional Bicc */
+	SF_SUBCC_BICC,
+};
+
+/* Is fused pair unable to trap and independent from PC */
+#define SF_IS_PURE(f) ((f) == SF_SETHI_OR)
+
+struct isn_handler;
+
 struct sparc_isn {
 	opcode op;
 	enum sid_isn id;
 	enum sisn_fmt fmt;
+	/* Execution handler, resolved at decode time */
+	struct isn_handler const *hdl;
+	/* Specialized execution operation, resolved at decode time */
+	enum sxop_isn xop;
+	/* Fusion with next instruction, only set in translated blocks */
+	enum sfuse_isn fuse;
 };
 
 struct sparc_ifmt_op1 {
@@ -203,6 +267,12 @@ union sparc_isn_fill {
 #define to_ifmt(n, i) (container_of(i, struct sparc_ifmt_ ## n, isn))
 
 int isn_decode(struct sparc_isn *isn);
+struct isn_handler const *isn_get_handler(enum sid_isn id);
+enum sxop_isn isn_get_xop(struct sparc_isn const *isn);
+enum sfuse_isn isn_get_fuse(struct sparc_isn const *isn,
+		struct sparc_isn const *next);
 int isn_exec(struct cpu *cpu, struct sparc_isn const *isn);
+int isn_exec_fused(struct cpu *cpu, struct sparc_isn const *isn,
+		struct sparc_isn const *next);
 
 #endif
@@ -7,6 +7,7 @@
 #include "sparc.h"
 #include "isn.h"
 #include "trap.h"
+#include "scpu.h"
 
 struct isn_handler {
 	int (*handler)(struct isn_handler const *hdl, struct cpu *cpu,
@@ -251,10 +252,7 @@ static int isn_alu_icc_nz(struct isn_handler const *hdl, struct cpu *cpu,
 		uint32_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-	(void)v1;
-	(void)v2;
-	scpu_set_cc_n(cpu, (res >> 31) & 0x1);
-	scpu_set_cc_z(cpu, ((res == 0) ? 1 : 0));
+	scpu_set_cc_lazy(cpu, CC_OP_LOGIC, res, v1, v2);
 	return 0;
 }
 
@@ -519,22 +517,7 @@ static int isn_alu_icc_add(struct isn_handler const *hdl, struct cpu *cpu,
 		uint32_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-
-	isn_alu_icc_nz(hdl, cpu, res, v1, v2);
-
-	if((!(((v1 >> 31) & 0x1) ^ ((v2 >> 31) & 0x1))) &&
-		(((v1 >> 31) & 0x1) ^ ((res >> 31) & 0x1)))
-		scpu_set_cc_v(cpu, 1);
-	else
-		scpu_set_cc_v(cpu, 0);
-
-	if((((v1 >> 31) & 0x1) && (((v2 >> 31) & 0x1))) ||
-		((!((res >> 31) & 0x1)) && (((v1 >> 31) & 0x1) ||
-			((v2 >> 31) & 0x1))))
-		scpu_set_cc_c(cpu, 1);
-	else
-		scpu_set_cc_c(cpu, 0);
-
+	scpu_set_cc_lazy(cpu, CC_OP_ADD, res, v1, v2);
 	return 0;
 }
 
@@ -552,21 +535,7 @@ static int isn_alu_icc_sub(struct isn_handler const *hdl, struct cpu *cpu,
 		uint32_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-
-	isn_alu_icc_nz(hdl, cpu, res, v1, v2);
-	if((((v1 >> 31) & 0x1) ^ ((v2 >> 31) & 0x1)) &&
-		(!(((v2 >> 31) & 0x1) ^ ((res >> 31) & 0x1))))
-		scpu_set_cc_v(cpu, 1);
-	else
-		scpu_set_cc_v(cpu, 0);
-
-	if(((!((v1 >> 31) & 0x1)) && ((v2 >> 31) & 0x1)) ||
-		(((v2 >> 31) & 0x1) && ((!((v1 >> 31) & 0x1)) ||
-			((v2 >> 31) & 0x1))))
-		scpu_set_cc_c(cpu, 1);
-	else
-		scpu_set_cc_c(cpu, 0);
-
+	scpu_set_cc_lazy(cpu, CC_OP_SUB, res, v1, v2);
 	return 0;
 }
 
@@ -609,10 +578,7 @@ static int isn_alu_icc64_mul(struct isn_handler const *hdl, struct cpu *cpu,
 		uint64_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-
-	isn_alu_icc_nz(hdl, cpu, (uint32_t)res, v1, v2);
-	scpu_set_cc_v(cpu, 0);
-	scpu_set_cc_c(cpu, 0);
+	scpu_set_cc_lazy(cpu, CC_OP_MUL, (uint32_t)res, v1, v2);
 	return 0;
 }
 
@@ -620,10 +586,9 @@ static int isn_alu_icc64_udiv(struct isn_handler const *hdl, struct cpu *cpu,
 		uint64_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-
-	isn_alu_icc_nz(hdl, cpu, (uint32_t)res, v1, v2);
-	scpu_set_cc_v(cpu, ((res >> 32) == 0) ? 0 : 1);
-	scpu_set_cc_c(cpu, 0);
+	(void)v1;
+	scpu_set_cc_lazy(cpu, CC_OP_DIV, (uint32_t)res,
+			((res >> 32) == 0) ? 0 : 1, v2);
 	return 0;
 }
 
@@ -631,11 +596,10 @@ static int isn_alu_icc64_sdiv(struct isn_handler const *hdl, struct cpu *cpu,
 		uint64_t res, uint32_t v1, uint32_t v2)
 {
 	(void)hdl;
-
-	isn_alu_icc_nz(hdl, cpu, (uint32_t)res, v1, v2);
-	scpu_set_cc_v(cpu, (((res >> 32) == 0) &&
-				((res >> 32) != 0xffffffff)) ? 0 : 1);
-	scpu_set_cc_c(cpu, 0);
+	(void)v1;
+	scpu_set_cc_lazy(cpu, CC_OP_DIV, (uint32_t)res,
+			(((res >> 32) == 0) &&
+			 ((res >> 32) != 0xffffffff)) ? 0 : 1, v2);
 	return 0;
 }
 
@@ -723,6 +687,8 @@ struct isn_handler_mem {
 	int (*op)(struct cpu *cpu, struct dev *mem, sridx rd,
 			uint32_t v1, uint32_t v2);
 	size_t sz;
+	/* Instruction writes into memory */
+	uint8_t wr;
 };
 
 #define to_handler_mem(h)						\
@@ -733,29 +699,39 @@ struct isn_handler_altmem {
 	int (*op)(struct cpu *cpu, struct dev *mem, sridx rd,
 			uint32_t v1, uint32_t v2);
 	size_t sz;
+	/* Instruction writes into memory */
+	uint8_t wr;
 };
 
 #define to_handler_altmem(h)						\
 	(container_of(to_handler_fmt3_asi(h), struct isn_handler_altmem, fmt3))
 
 /* Define a Memory instruction handler */
-#define INIT_ISN_HDL_MEM(o, s) {					\
+#define INIT_ISN_HDL_MEM(o, s, w) {					\
 	.fmt3 = INIT_ISN_HDL_FMT3(isn_exec_mem),			\
 	.op = o,							\
 	.sz = s,							\
+	.wr = w,							\
 }
 
-#define INIT_ISN_HDL_ALTMEM(o, s) {					\
+#define INIT_ISN_HDL_ALTMEM(o, s, w) {					\
 	.fmt3 = INIT_ISN_HDL_FMT3_ASI(isn_exec_altmem),			\
 	.op = o,							\
 	.sz = s,							\
+	.wr = w,							\
 }
 
-#define DEFINE_ISN_HDL_MEM(n, o, s)					\
+#define _DEFINE_ISN_HDL_MEM(n, o, s, w)					\
 	static struct isn_handler_mem const				\
-		isn_handler_ ## n = INIT_ISN_HDL_MEM(o, s);		\
+		isn_handler_ ## n = INIT_ISN_HDL_MEM(o, s, w);		\
 	static struct isn_handler_altmem const				\
-		isn_handler_ ## n ## A = INIT_ISN_HDL_ALTMEM(o, s)
+		isn_handler_ ## n ## A = INIT_ISN_HDL_ALTMEM(o, s, w)
+
+/* Define a Memory load instruction handler */
+#define DEFINE_ISN_HDL_MEM(n, o, s) _DEFINE_ISN_HDL_MEM(n, o, s, 0)
+
+/* Define a Memory store instruction handler */
+#define DEFINE_ISN_HDL_STMEM(n, o, s) _DEFINE_ISN_HDL_MEM(n, o, s, 1)
 
 #define ISN_HDL_MEM_ENTRY(i)						\
 	[SI_ ## i] = &isn_handler_ ## i.fmt3.hdl,			\
@@ -784,6 +760,10 @@ static int isn_exec_mem(struct isn_handler const *hdl, struct cpu *cpu,
 	ret = mh->op(cpu, mem, rd, v1, v2);
 	if(ret != 0)
 		scpu_trap(cpu, ST_DACCESS_EXCEP);
+
+	/* Even partial stores may have modified predecoded instructions */
+	if(mh->wr)
+		scpu_store_notify(cpu, v1 + v2, mh->sz >> 3);
 out:
 	return 0;
 }
@@ -808,6 +788,10 @@ static int isn_exec_altmem(struct isn_handler const *hdl, struct cpu *cpu,
 	ret = mh->op(cpu, mem, rd, v1, v2);
 	if(ret != 0)
 		scpu_trap(cpu, ST_DACCESS_EXCEP);
+
+	/* Even partial stores may have modified predecoded instructions */
+	if(mh->wr)
+		scpu_store_notify(cpu, v1 + v2, mh->sz >> 3);
 out:
 	return 0;
 }
@@ -818,7 +802,7 @@ static int isn_exec_ldsb(struct cpu *cpu, struct dev *mem, sridx rd,
 	int ret = 0;
 	uint8_t d;
 
-	ret = dev_read8(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read8(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
@@ -834,7 +818,7 @@ static int isn_exec_ldsh(struct cpu *cpu, struct dev *mem, sridx rd,
 	int ret;
 	uint16_t d;
 
-	ret = dev_read16(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read16(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
@@ -850,7 +834,7 @@ static int isn_exec_ldub(struct cpu *cpu, struct dev *mem, sridx rd,
 	int ret;
 	uint8_t d;
 
-	ret = dev_read8(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read8(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
@@ -866,7 +850,7 @@ static int isn_exec_lduh(struct cpu *cpu, struct dev *mem, sridx rd,
 	int ret;
 	uint16_t d;
 
-	ret = dev_read16(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read16(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
@@ -882,7 +866,7 @@ static int isn_exec_ld(struct cpu *cpu, struct dev *mem, sridx rd,
 	int ret;
 	uint32_t d;
 
-	ret = dev_read32(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read32(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
@@ -896,22 +880,20 @@ static int isn_exec_ldd(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
 {
 	int ret = 0;
-	uint32_t d;
+	uint64_t d;
 
 	if(rd & 0x1) {
 		scpu_trap(cpu, ST_ILL_ISN);
 		goto out;
 	}
 
-	ret = dev_read32(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read64(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
-	scpu_set_reg(cpu, rd, be32toh(d));
 
-	ret = dev_read32(mem, ((addr_t)v1) + v2 + 4, &d);
-	if(ret)
-		goto out;
-	scpu_set_reg(cpu, rd + 1, be32toh(d));
+	d = be64toh(d);
+	scpu_set_reg(cpu, rd, d >> 32);
+	scpu_set_reg(cpu, rd + 1, d & 0xffffffff);
 out:
 	return ret;
 }
@@ -920,25 +902,26 @@ DEFINE_ISN_HDL_MEM(LDD, isn_exec_ldd, 64);
 static int isn_exec_stb(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
 {
-	return dev_write8(mem, ((addr_t)v1) + v2, scpu_get_reg(cpu, rd));
+	return scpu_mem_write8(cpu, mem, ((addr_t)v1) + v2,
+			scpu_get_reg(cpu, rd));
 }
-DEFINE_ISN_HDL_MEM(STB, isn_exec_stb, 8);
+DEFINE_ISN_HDL_STMEM(STB, isn_exec_stb, 8);
 
 static int isn_exec_sth(struct cpu *cpu, struct dev *mem,  sridx rd,
 		uint32_t v1, uint32_t v2)
 {
-	return dev_write16(mem, ((addr_t)v1) + v2,
+	return scpu_mem_write16(cpu, mem, ((addr_t)v1) + v2,
 			htobe16(scpu_get_reg(cpu, rd)));
 }
-DEFINE_ISN_HDL_MEM(STH, isn_exec_sth, 16);
+DEFINE_ISN_HDL_STMEM(STH, isn_exec_sth, 16);
 
 static int isn_exec_st(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
 {
-	return dev_write32(mem, ((addr_t)v1) + v2,
+	return scpu_mem_write32(cpu, mem, ((addr_t)v1) + v2,
 			htobe32(scpu_get_reg(cpu, rd)));
 }
-DEFINE_ISN_HDL_MEM(ST, isn_exec_st, 32);
+DEFINE_ISN_HDL_STMEM(ST, isn_exec_st, 32);
 
 static int isn_exec_std(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
@@ -949,17 +932,13 @@ static int isn_exec_std(struct cpu *cpu, struct dev *mem, sridx rd,
 		scpu_trap(cpu, ST_ILL_ISN);
 		goto out;
 	}
-	ret = dev_write32(mem, ((addr_t)v1) + v2,
-			htobe32(scpu_get_reg(cpu, rd)));
-	if(ret != 0)
-		goto out;
-
-	ret = dev_write32(mem, ((addr_t)v1) + v2 + 4,
-			htobe32(scpu_get_reg(cpu, rd + 1)));
+	ret = scpu_mem_write64(cpu, mem, ((addr_t)v1) + v2,
+			htobe64((((uint64_t)scpu_get_reg(cpu, rd)) << 32) |
+				scpu_get_reg(cpu, rd + 1)));
 out:
 	return ret;
 }
-DEFINE_ISN_HDL_MEM(STD, isn_exec_std, 64);
+DEFINE_ISN_HDL_STMEM(STD, isn_exec_std, 64);
 
 static int isn_exec_ldstub(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
@@ -972,16 +951,16 @@ static int isn_exec_ldstub(struct cpu *cpu, struct dev *mem, sridx rd,
 	 * TODO find a way to lock the address access for multicpu systems
 	 */
 
-	ret = dev_read8(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read8(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 	scpu_set_reg(cpu, rd, d);
 
-	ret = dev_write8(mem, ((addr_t)v1) + v2, 0xff);
+	ret = scpu_mem_write8(cpu, mem, ((addr_t)v1) + v2, 0xff);
 out:
 	return ret;
 }
-DEFINE_ISN_HDL_MEM(LDSTUB, isn_exec_ldstub, 8);
+DEFINE_ISN_HDL_STMEM(LDSTUB, isn_exec_ldstub, 8);
 
 static int isn_exec_swap(struct cpu *cpu, struct dev *mem, sridx rd,
 		uint32_t v1, uint32_t v2)
@@ -994,11 +973,11 @@ static int isn_exec_swap(struct cpu *cpu, struct dev *mem, sridx rd,
 	 * TODO find a way to lock the address access for multicpu systems
 	 */
 
-	ret = dev_read32(mem, ((addr_t)v1) + v2, &d);
+	ret = scpu_mem_read32(cpu, mem, ((addr_t)v1) + v2, &d);
 	if(ret)
 		goto out;
 
-	ret = dev_write32(mem, ((addr_t)v1) + v2,
+	ret = scpu_mem_write32(cpu, mem, ((addr_t)v1) + v2,
 			htobe32(scpu_get_reg(cpu, rd)));
 	if(ret)
 		goto out;
@@ -1007,7 +986,7 @@ static int isn_exec_swap(struct cpu *cpu, struct dev *mem, sridx rd,
 out:
 	return ret;
 }
-DEFINE_ISN_HDL_MEM(SWAP, isn_exec_swap, 32);
+DEFINE_ISN_HDL_STMEM(SWAP, isn_exec_swap, 32);
 
 /* ---------------------- Icc test -------------------------- */
 
@@ -1112,74 +1091,108 @@ static inline int isn_icc_op_n(struct cpu *c)
 	return 0;
 }
 
+/* Condition codes are fetched once, they may have to be computed */
+#define ICC_N(icc) (((icc) & SCPU_ICC_N) ? 1 : 0)
+#define ICC_Z(icc) (((icc) & SCPU_ICC_Z) ? 1 : 0)
+#define ICC_V(icc) (((icc) & SCPU_ICC_V) ? 1 : 0)
+#define ICC_C(icc) (((icc) & SCPU_ICC_C) ? 1 : 0)
+
 static inline int isn_icc_op_ne(struct cpu *c)
 {
-	return !scpu_get_cc_z(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return !ICC_Z(icc);
 }
 
 static inline int isn_icc_op_e(struct cpu *c)
 {
-	return scpu_get_cc_z(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_Z(icc);
 }
 
 static inline int isn_icc_op_g(struct cpu *c)
 {
-	return !(scpu_get_cc_z(c) || (scpu_get_cc_n(c) ^ scpu_get_cc_v(c)));
+	uint8_t icc = scpu_get_icc(c);
+
+	return !(ICC_Z(icc) || (ICC_N(icc) ^ ICC_V(icc)));
 }
 
 static inline int isn_icc_op_le(struct cpu *c)
 {
-	return scpu_get_cc_z(c) || (scpu_get_cc_n(c) ^ scpu_get_cc_v(c));
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_Z(icc) || (ICC_N(icc) ^ ICC_V(icc));
 }
 
 static inline int isn_icc_op_ge(struct cpu *c)
 {
-	return !(scpu_get_cc_n(c) ^ scpu_get_cc_v(c));
+	uint8_t icc = scpu_get_icc(c);
+
+	return !(ICC_N(icc) ^ ICC_V(icc));
 }
 
 static inline int isn_icc_op_l(struct cpu *c)
 {
-	return scpu_get_cc_n(c) ^ scpu_get_cc_v(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_N(icc) ^ ICC_V(icc);
 }
 
 static inline int isn_icc_op_gu(struct cpu *c)
 {
-	return !(scpu_get_cc_c(c) || scpu_get_cc_z(c));
+	uint8_t icc = scpu_get_icc(c);
+
+	return !(ICC_C(icc) || ICC_Z(icc));
 }
 
 static inline int isn_icc_op_leu(struct cpu *c)
 {
-	return scpu_get_cc_c(c) || scpu_get_cc_z(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_C(icc) || ICC_Z(icc);
 }
 
 static inline int isn_icc_op_cc(struct cpu *c)
 {
-	return !scpu_get_cc_c(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return !ICC_C(icc);
 }
 
 static inline int isn_icc_op_cs(struct cpu *c)
 {
-	return scpu_get_cc_c(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_C(icc);
 }
 
 static inline int isn_icc_op_pos(struct cpu *c)
 {
-	return !scpu_get_cc_n(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return !ICC_N(icc);
 }
 
 static inline int isn_icc_op_neg(struct cpu *c)
 {
-	return scpu_get_cc_n(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_N(icc);
 }
 
 static inline int isn_icc_op_vc(struct cpu *c)
 {
-	return !scpu_get_cc_v(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return !ICC_V(icc);
 }
 
 static inline int isn_icc_op_vs(struct cpu *c)
 {
-	return scpu_get_cc_v(c);
+	uint8_t icc = scpu_get_icc(c);
+
+	return ICC_V(icc);
 }
 
 /* ------------------- Bicc Instructions -------------------- */
@@ -1204,26 +1217,29 @@ static int isn_exec_ba(struct isn_handler const *hdl, struct cpu *cpu,
 }
 DEFINE_ISN_HDL(BA, isn_exec_ba);
 
+/* Jump if condition is true, annul delay slot if needed otherwise */
+static inline void isn_bicc_jmp(struct cpu *cpu,
+		struct sparc_ifmt_op2_bicc const *i, int cond)
+{
+	if(!cond) {
+		if(i->a)
+			scpu_annul_delay_slot(cpu);
+		return;
+	}
+
+	scpu_delay_jmp(cpu, scpu_get_pc(cpu) + (i->disp << 2));
+}
+
 /* Common handler for other Bicc */
 static int isn_exec_bicc(struct isn_handler const *hdl, struct cpu *cpu,
 		struct sparc_isn const *isn)
 {
-	struct sparc_ifmt_op2_bicc const *i = to_ifmt(op2_bicc, isn);
 	struct isn_handler_icc const *ih = to_handler_icc(hdl);
-	sreg pc;
 
 	if(isn->fmt != SIF_OP2_BICC)
 		return -1;
 
-	if(!ih->test(cpu)) {
-		if(i->a)
-			scpu_annul_delay_slot(cpu);
-		goto out;
-	}
-	pc = scpu_get_pc(cpu);
-	scpu_delay_jmp(cpu, pc + (i->disp << 2));
-
-out:
+	isn_bicc_jmp(cpu, to_ifmt(op2_bicc, isn), ih->test(cpu));
 	return 0;
 }
 
@@ -1511,12 +1527,334 @@ static struct isn_handler const *_exec_isn[] = {
 	ISN_HDL_FMT3_ENTRY(FLUSH),
 };
 
+/* Resolve instruction handler, NULL pointer if instruction is not handled */
+struct isn_handler const *isn_get_handler(enum sid_isn id)
+{
+	if(id < ARRAY_SIZE(_exec_isn))
+		return _exec_isn[id];
+
+	return NULL;
+}
+
+/* ------------- Specialized instruction execution -------------- */
+
+/*
+ * With GNU C, specialized operations are dispatched with computed goto
+ * (labels as values), one indirect jump per instruction. Otherwise, or if
+ * SPARC_TABLE_DISPATCH is defined, handler table is used.
+ */
+#if defined(__GNUC__) && !defined(SPARC_TABLE_DISPATCH)
+#define ISN_THREADED
+#endif
+
+/* Specialized operations for instructions, for immediate and register format */
+struct isn_xop {
+	enum sxop_isn imm;
+	enum sxop_isn reg;
+};
+
+#define ISN_XOP_ENTRY(i) [SI_ ## i] = {					\
+	.imm = SX_ ## i,						\
+	.reg = SX_ ## i,						\
+}
+
+#define ISN_XOP_FMT3_ENTRY(i) [SI_ ## i] = {				\
+	.imm = SX_ ## i ## _IMM,					\
+	.reg = SX_ ## i ## _REG,					\
+}
+
+/* Specialized operations array, indexed by instruction id */
+static struct isn_xop const _xop_isn[] = {
+	ISN_XOP_ENTRY(SETHI),
+	ISN_XOP_ENTRY(CALL),
+	ISN_XOP_ENTRY(BA),
+	ISN_XOP_ENTRY(BNE),
+	ISN_XOP_ENTRY(BE),
+	ISN_XOP_FMT3_ENTRY(ADD),
+	ISN_XOP_FMT3_ENTRY(ADDCC),
+	ISN_XOP_FMT3_ENTRY(SUB),
+	ISN_XOP_FMT3_ENTRY(SUBCC),
+	ISN_XOP_FMT3_ENTRY(AND),
+	ISN_XOP_FMT3_ENTRY(ANDCC),
+	ISN_XOP_FMT3_ENTRY(ANDN),
+	ISN_XOP_FMT3_ENTRY(OR),
+	ISN_XOP_FMT3_ENTRY(ORCC),
+	ISN_XOP_FMT3_ENTRY(XOR),
+	ISN_XOP_FMT3_ENTRY(XORCC),
+	ISN_XOP_FMT3_ENTRY(SLL),
+	ISN_XOP_FMT3_ENTRY(SRL),
+	ISN_XOP_FMT3_ENTRY(SRA),
+};
+
+/* Specialized operations for other format3 instructions */
+static struct isn_xop const _xop_fmt3 = {
+	.imm = SX_FMT3_IMM,
+	.reg = SX_FMT3_REG,
+};
+
+/**
+ * Select the specialized operation for a decoded instruction
+ *
+ * @param isn: Decoded instruction, with its handler already resolved
+ * @return: Specialized operation, SX_GENERIC if there is none
+ */
+enum sxop_isn isn_get_xop(struct sparc_isn const *isn)
+{
+	struct isn_xop const *x = NULL;
+
+	if(isn->hdl == NULL)
+		return SX_GENERIC;
+
+	if(isn->id < ARRAY_SIZE(_xop_isn))
+		x = &_xop_isn[isn->id];
+
+	/* Bicc without specialized operation still skip the handler table */
+	if((x == NULL || x->imm == SX_GENERIC) &&
+			(isn->hdl->handler == isn_exec_bicc))
+		return SX_BICC;
+
+	/* Format3 instructions can at least skip operand format dispatch */
+	if((x == NULL || x->imm == SX_GENERIC) &&
+			(isn->hdl->handler == isn_exec_fmt3))
+		x = &_xop_fmt3;
+
+	if(x == NULL)
+		return SX_GENERIC;
+
+	switch(isn->fmt) {
+	case SIF_OP3_REG:
+		return x->reg;
+	case SIF_OP3_IMM:
+		return x->imm;
+	default:
+		/* Non format3 specialized operations are the same for both */
+		return (x->imm == x->reg) ? x->imm : SX_GENERIC;
+	}
+}
+
+/* Is instruction a memory load/store with an immediate offset */
+static inline int isn_is_mem_imm(struct sparc_isn const *isn)
+{
+	return (isn->xop == SX_FMT3_IMM) &&
+		(to_handler_fmt3(isn->hdl)->op == isn_exec_mem);
+}
+
+/**
+ * Select how an instruction can be fused with the following one
+ *
+ * @param isn: Decoded instruction
+ * @param next: Following decoded instruction
+ * @return: Fused pair, SF_NONE if these instructions cannot be fused
+ */
+enum sfuse_isn isn_get_fuse(struct sparc_isn const *isn,
+		struct sparc_isn const *next)
+{
+	struct sparc_ifmt_op2_imm const *hi;
+
+	if((isn->xop == SX_SUBCC_IMM) || (isn->xop == SX_SUBCC_REG)) {
+		/* ba and bn do not depend on condition codes */
+		if((next->xop == SX_BNE) || (next->xop == SX_BE) ||
+				((next->xop == SX_BICC) && (next->id != SI_BN)))
+			return SF_SUBCC_BICC;
+		return SF_NONE;
+	}
+
+	if(isn->xop != SX_SETHI)
+		return SF_NONE;
+
+	hi = to_ifmt(op2_imm, isn);
+	if(hi->rd == 0)
+		return SF_NONE;
+
+	if((next->xop == SX_OR_IMM) &&
+			(to_ifmt(op3_imm, next)->rs1 == hi->rd) &&
+			(to_ifmt(op3_imm, next)->rd == hi->rd))
+		return SF_SETHI_OR;
+
+	if(isn_is_mem_imm(next) && (to_ifmt(op3_imm, next)->rs1 == hi->rd))
+		return SF_SETHI_MEM;
+
+	return SF_NONE;
+}
+
+/**
+ * Execute a fused instruction pair with a single dispatch. PC registers must
+ * be set for the second instruction, as the first one cannot trap.
+ *
+ * @param cpu: cpu to execute instructions on
+ * @param isn: First instruction of the pair
+ * @param next: Second instruction of the pair
+ * @return: 0 on success, negative number on error
+ */
+int isn_exec_fused(struct cpu *cpu, struct sparc_isn const *isn,
+		struct sparc_isn const *next)
+{
+	struct sparc_ifmt_op3_imm const *lo = to_ifmt(op3_imm, next);
+	sreg hi = to_ifmt(op2_imm, isn)->imm << 10;
+	sridx rd;
+	uint32_t v1, v2, res;
+
+	switch(isn->fuse) {
+	case SF_SETHI_OR:
+		/* Both instructions write the same register */
+		scpu_set_reg(cpu, lo->rd, hi | lo->imm);
+		return 0;
+	case SF_SETHI_MEM:
+		scpu_set_reg(cpu, to_ifmt(op2_imm, isn)->rd, hi);
+		return isn_exec_mem(next->hdl, cpu, lo->rd, hi, lo->imm);
+	case SF_SUBCC_BICC:
+		if(isn->xop == SX_SUBCC_IMM)
+			isn_fmt3_get_param_imm(cpu, isn, &rd, &v1, &v2);
+		else
+			isn_fmt3_get_param_reg(cpu, isn, &rd, &v1, &v2);
+		res = isn_exec_sub(v1, v2);
+		isn_alu_icc_sub(isn->hdl, cpu, res, v1, v2);
+		scpu_set_reg(cpu, rd, res);
+		if(next->xop == SX_BE)
+			isn_bicc_jmp(cpu, to_ifmt(op2_bicc, next), res == 0);
+		else if(next->xop == SX_BNE)
+			isn_bicc_jmp(cpu, to_ifmt(op2_bicc, next), res != 0);
+		else
+			return isn_exec_bicc(next->hdl, cpu, next);
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+#ifdef ISN_THREADED
+
+/* Fetch format3 operands then jump to operation body */
+#define XOP_FMT3(n)							\
+xop_ ## n ## _IMM:							\
+	isn_fmt3_get_param_imm(cpu, i, &rd, &v1, &v2);			\
+	goto xop_ ## n;							\
+xop_ ## n ## _REG:							\
+	isn_fmt3_get_param_reg(cpu, i, &rd, &v1, &v2);			\
+xop_ ## n
+
+/* Simple ALU operation body */
+#define XOP_ALU(n, o)							\
+XOP_FMT3(n):								\
+	scpu_set_reg(cpu, rd, o(v1, v2));				\
+	return 0
+
+/* Simple ALU operation body that sets condition codes */
+#define XOP_ALUcc(n, o, cc)						\
+XOP_FMT3(n):								\
+	res = o(v1, v2);						\
+	cc(i->hdl, cpu, res, v1, v2);					\
+	scpu_set_reg(cpu, rd, res);					\
+	return 0
+
+#define XOP_LABEL_ENTRY(n) [SX_ ## n] = &&xop_ ## n
+#define XOP_LABEL_FMT3_ENTRY(n)						\
+[SX_ ## n ## _IMM] = &&xop_ ## n ## _IMM,				\
+[SX_ ## n ## _REG] = &&xop_ ## n ## _REG
+
+static inline uint32_t isn_exec_sll32(uint32_t v1, uint32_t v2)
+{
+	return v1 << (v2 & 0x1f);
+}
+
+static inline uint32_t isn_exec_srl32(uint32_t v1, uint32_t v2)
+{
+	return v1 >> (v2 & 0x1f);
+}
+
+static inline uint32_t isn_exec_sra32(uint32_t v1, uint32_t v2)
+{
+	return ((int32_t)v1) >> (v2 & 0x1f);
+}
+
 /* Dispatch instruction */
 int isn_exec(struct cpu *cpu, struct sparc_isn const *i)
 {
-	if((i->id < ARRAY_SIZE(_exec_isn)) && _exec_isn[i->id])
-		return _exec_isn[i->id]->handler(_exec_isn[i->id], cpu, i);
+	static void * const _xop_label[SX_NR] = {
+		XOP_LABEL_ENTRY(GENERIC),
+		XOP_LABEL_FMT3_ENTRY(FMT3),
+		XOP_LABEL_ENTRY(SETHI),
+		XOP_LABEL_ENTRY(CALL),
+		XOP_LABEL_ENTRY(BA),
+		XOP_LABEL_ENTRY(BICC),
+		XOP_LABEL_ENTRY(BNE),
+		XOP_LABEL_ENTRY(BE),
+		XOP_LABEL_FMT3_ENTRY(ADD),
+		XOP_LABEL_FMT3_ENTRY(ADDCC),
+		XOP_LABEL_FMT3_ENTRY(SUB),
+		XOP_LABEL_FMT3_ENTRY(SUBCC),
+		XOP_LABEL_FMT3_ENTRY(AND),
+		XOP_LABEL_FMT3_ENTRY(ANDCC),
+		XOP_LABEL_FMT3_ENTRY(ANDN),
+		XOP_LABEL_FMT3_ENTRY(OR),
+		XOP_LABEL_FMT3_ENTRY(ORCC),
+		XOP_LABEL_FMT3_ENTRY(XOR),
+		XOP_LABEL_FMT3_ENTRY(XORCC),
+		XOP_LABEL_FMT3_ENTRY(SLL),
+		XOP_LABEL_FMT3_ENTRY(SRL),
+		XOP_LABEL_FMT3_ENTRY(SRA),
+	};
+	sridx rd;
+	uint32_t v1, v2, res;
+
+	goto *_xop_label[i->xop];
+
+XOP_FMT3(FMT3):
+	return to_handler_fmt3(i->hdl)->op(i->hdl, cpu, rd, v1, v2);
+
+xop_SETHI:
+	return isn_exec_sethi(i->hdl, cpu, i);
+
+xop_CALL:
+	return isn_exec_call(i->hdl, cpu, i);
+
+xop_BA:
+	return isn_exec_ba(i->hdl, cpu, i);
+
+xop_BICC:
+	return isn_exec_bicc(i->hdl, cpu, i);
+
+xop_BNE:
+	isn_bicc_jmp(cpu, to_ifmt(op2_bicc, i), isn_icc_op_ne(cpu));
+	return 0;
+
+xop_BE:
+	isn_bicc_jmp(cpu, to_ifmt(op2_bicc, i), isn_icc_op_e(cpu));
+	return 0;
+
+XOP_ALU(ADD, isn_exec_add);
+XOP_ALUcc(ADDCC, isn_exec_add, isn_alu_icc_add);
+XOP_ALU(SUB, isn_exec_sub);
+XOP_ALUcc(SUBCC, isn_exec_sub, isn_alu_icc_sub);
+XOP_ALU(AND, isn_exec_and);
+XOP_ALUcc(ANDCC, isn_exec_and, isn_alu_icc_nz);
+XOP_ALU(ANDN, isn_exec_andn);
+XOP_ALU(OR, isn_exec_or);
+XOP_ALUcc(ORCC, isn_exec_or, isn_alu_icc_nz);
+XOP_ALU(XOR, isn_exec_xor);
+XOP_ALUcc(XORCC, isn_exec_xor, isn_alu_icc_nz);
+XOP_ALU(SLL, isn_exec_sll32);
+XOP_ALU(SRL, isn_exec_srl32);
+XOP_ALU(SRA, isn_exec_sra32);
+
+xop_GENERIC:
+	if(i->hdl)
+		return i->hdl->handler(i->hdl, cpu, i);
 
 	scpu_trap(cpu, ST_ILL_ISN);
 	return 0;
 }
+
+#else /* ISN_THREADED */
+
+/* Dispatch instruction */
+int isn_exec(struct cpu *cpu, struct sparc_isn const *i)
+{
+	if(i->hdl)
+		return i->hdl->handler(i->hdl, cpu, i);
+
+	scpu_trap(cpu, ST_ILL_ISN);
+	return 0;
+}
+
+#endif /* ISN_THREADED */
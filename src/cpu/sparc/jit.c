@@ -0,0 +1,1118 @@
+#ifdef SPARC_JIT
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "Sparc JIT is only available on x86-64 Linux hosts"
+#endif
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "types.h"
+
+#include "sparc.h"
+#include "isn.h"
+#include "block.h"
+#include "jit.h"
+
+/* Executable code arena size */
+#define JIT_ARENA_SZ (4 << 20)
+/* Upper bound of a compiled block native code size */
+#define JIT_BLOCK_MAXSZ (256 + BLOCK_MAXISN * 768)
+/* Number of guest registers that can be held in host registers */
+#define JIT_NRHREG 8
+/* Guest register that receives CALL return address (%o7) */
+#define JIT_O7 15
+
+/* PSR condition codes position and masks */
+#define JIT_ICC_SHIFT 20
+#define JIT_ICC_MASK (0xf << JIT_ICC_SHIFT)
+#define JIT_ICC_NZ_MASK (0xc << JIT_ICC_SHIFT)
+#define JIT_ICC_NZV_MASK (0xe << JIT_ICC_SHIFT)
+#define JIT_ICC_C (0x1 << JIT_ICC_SHIFT)
+
+/* Native stack frame slots, holding native function arguments */
+#define JIT_FRAME_CPU 0
+#define JIT_FRAME_NRISN 8
+#define JIT_FRAME_NEXT 16
+#define JIT_FRAME_SZ 24
+
+/* x86-64 registers */
+enum x86_reg {
+	XR_RAX,
+	XR_RCX,
+	XR_RDX,
+	XR_RBX,
+	XR_RSP,
+	XR_RBP,
+	XR_RSI,
+	XR_RDI,
+	XR_R8,
+	XR_R9,
+	XR_R10,
+	XR_R11,
+	XR_R12,
+	XR_R13,
+	XR_R14,
+	XR_R15,
+};
+
+/*
+ * Fixed host register usage, others are scratch registers:
+ * - R12 points to the guest register file (%g1 is at offset 0)
+ * - R13 points to the current window (%o0 is at offset 7 * 4)
+ * - R9 holds branch condition computed by previous instruction
+ */
+#define XR_REGS XR_R12
+#define XR_WIN XR_R13
+#define XR_COND XR_R9
+
+/* x86 condition codes */
+enum x86_cc {
+	XC_O,
+	XC_NO,
+	XC_B,
+	XC_AE,
+	XC_E,
+	XC_NE,
+	XC_BE,
+	XC_A,
+	XC_S,
+	XC_NS,
+	XC_P,
+	XC_NP,
+	XC_L,
+	XC_GE,
+	XC_LE,
+	XC_G,
+};
+
+/* x86 arithmetic operations, as /digit opcode extension of 0x81 */
+enum x86_alu {
+	XA_ADD = 0,
+	XA_OR = 1,
+	XA_AND = 4,
+	XA_SUB = 5,
+	XA_XOR = 6,
+	XA_CMP = 7,
+};
+
+/* x86 shift operations, as /digit opcode extension of 0xc1 and 0xd3 */
+enum x86_shift {
+	XS_SHL = 4,
+	XS_SHR = 5,
+	XS_SAR = 7,
+};
+
+/* Host registers that can hold guest registers */
+static uint8_t const _jit_hreg[JIT_NRHREG] = {
+	XR_RBX, XR_RBP, XR_R14, XR_R15, XR_RSI, XR_RDI, XR_R10, XR_R11,
+};
+
+/* Callee saved host registers, in push order */
+static uint8_t const _jit_saved[] = {
+	XR_RBX, XR_RBP, XR_R12, XR_R13, XR_R14, XR_R15,
+};
+
+/**
+ * Register or memory operand
+ */
+struct jit_loc {
+	/* Host register, negative if operand is in memory */
+	int8_t reg;
+	/* Memory operand base register and displacement */
+	uint8_t base;
+	int32_t disp;
+};
+
+#define LOC_REG(r) ((struct jit_loc){ .reg = (r) })
+#define LOC_MEM(b, d) ((struct jit_loc){ .reg = -1, .base = (b), .disp = (d) })
+
+/**
+ * Native ALU operation of a specialized instruction
+ */
+struct jit_alu {
+	/* How operation is emitted */
+	enum {
+		JK_ALU,
+		JK_ANDN,
+		JK_SHIFT,
+	} kind;
+	/* x86 "op r32, r/m32" opcode */
+	uint8_t op;
+	/* x86 /digit opcode extension of immediate or shift form */
+	uint8_t ext;
+	/* Condition codes mask set by operation, 0 if none */
+	uint32_t icc;
+	/* Condition codes that match x86 flags, carry is otherwise the sign of
+	 * second operand (as the interpreter computes it for subcc) */
+	uint32_t xicc;
+};
+
+#define JIT_ALU_IDX(x) (((x) - SX_ADD_IMM) / 2)
+#define JIT_ALU_IS_IMM(x) ((((x) - SX_ADD_IMM) % 2) == 0)
+#define JIT_ALU_ENTRY(n, k, o, e, cc, xcc)				\
+	[JIT_ALU_IDX(SX_ ## n ## _IMM)] = {				\
+		.kind = k,						\
+		.op = o,						\
+		.ext = e,						\
+		.icc = cc,						\
+		.xicc = xcc,						\
+	}
+
+/*
+ * Native ALU operations, indexed by specialized operation. Logical operations
+ * only set N and Z, as the interpreter does.
+ */
+static struct jit_alu const _jit_alu[] = {
+	JIT_ALU_ENTRY(ADD, JK_ALU, 0x03, XA_ADD, 0, 0),
+	JIT_ALU_ENTRY(ADDCC, JK_ALU, 0x03, XA_ADD, JIT_ICC_MASK, JIT_ICC_MASK),
+	JIT_ALU_ENTRY(SUB, JK_ALU, 0x2b, XA_SUB, 0, 0),
+	JIT_ALU_ENTRY(SUBCC, JK_ALU, 0x2b, XA_SUB, JIT_ICC_MASK,
+			JIT_ICC_NZV_MASK),
+	JIT_ALU_ENTRY(AND, JK_ALU, 0x23, XA_AND, 0, 0),
+	JIT_ALU_ENTRY(ANDCC, JK_ALU, 0x23, XA_AND, JIT_ICC_NZ_MASK,
+			JIT_ICC_NZ_MASK),
+	JIT_ALU_ENTRY(ANDN, JK_ANDN, 0x23, XA_AND, 0, 0),
+	JIT_ALU_ENTRY(OR, JK_ALU, 0x0b, XA_OR, 0, 0),
+	JIT_ALU_ENTRY(ORCC, JK_ALU, 0x0b, XA_OR, JIT_ICC_NZ_MASK,
+			JIT_ICC_NZ_MASK),
+	JIT_ALU_ENTRY(XOR, JK_ALU, 0x33, XA_XOR, 0, 0),
+	JIT_ALU_ENTRY(XORCC, JK_ALU, 0x33, XA_XOR, JIT_ICC_NZ_MASK,
+			JIT_ICC_NZ_MASK),
+	JIT_ALU_ENTRY(SLL, JK_SHIFT, 0, XS_SHL, 0, 0),
+	JIT_ALU_ENTRY(SRL, JK_SHIFT, 0, XS_SHR, 0, 0),
+	JIT_ALU_ENTRY(SRA, JK_SHIFT, 0, XS_SAR, 0, 0),
+};
+
+/**
+ * Bicc condition mapping on x86 flags
+ */
+struct jit_bicc {
+	/* x86 condition code */
+	enum x86_cc cc;
+	/* Condition codes the branch depends on */
+	uint32_t icc;
+};
+
+#define JIT_BICC_ENTRY(n, c, i) [SI_ ## n - SI_BN] = { .cc = c, .icc = i }
+
+/* Bicc conditions indexed by instruction id, BN and BA are handled apart */
+static struct jit_bicc const _jit_bicc[] = {
+	JIT_BICC_ENTRY(BNE, XC_NE, JIT_ICC_NZ_MASK),
+	JIT_BICC_ENTRY(BE, XC_E, JIT_ICC_NZ_MASK),
+	JIT_BICC_ENTRY(BG, XC_G, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BLE, XC_LE, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BGE, XC_GE, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BL, XC_L, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BGU, XC_A, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BLEU, XC_BE, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BCC, XC_AE, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BCS, XC_B, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BPOS, XC_NS, JIT_ICC_NZ_MASK),
+	JIT_BICC_ENTRY(BNEG, XC_S, JIT_ICC_NZ_MASK),
+	JIT_BICC_ENTRY(BVC, XC_NO, JIT_ICC_MASK),
+	JIT_BICC_ENTRY(BVS, XC_O, JIT_ICC_MASK),
+};
+
+/**
+ * Block compilation context
+ */
+struct jit_ctx {
+	struct jit *jit;
+	struct block *b;
+	/* Native code emission pointer and limit */
+	uint8_t *p;
+	uint8_t *end;
+	/* Shared epilogue address */
+	uint8_t *epi;
+	/* Host register holding each guest register, negative if none */
+	int8_t hreg[32];
+	/* Guest registers held in host registers */
+	uint32_t cached;
+	/* Cached guest registers not written back yet */
+	uint32_t dirty;
+	/* Set when code does not fit */
+	int err;
+};
+
+/* ------------------------ x86-64 emitter -------------------------- */
+
+static inline void x_byte(struct jit_ctx *c, uint8_t v)
+{
+	if(c->p >= c->end) {
+		c->err = 1;
+		return;
+	}
+	*(c->p++) = v;
+}
+
+static inline void x_u32(struct jit_ctx *c, uint32_t v)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(v); ++i)
+		x_byte(c, (v >> (i * 8)) & 0xff);
+}
+
+static inline void x_u64(struct jit_ctx *c, uint64_t v)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(v); ++i)
+		x_byte(c, (v >> (i * 8)) & 0xff);
+}
+
+/**
+ * Emit an instruction with a ModRM encoded register and register or memory
+ * operand
+ *
+ * @param c: Compilation context
+ * @param w: 1 for 64bit operand size
+ * @param op: One byte opcode, or two bytes opcode (0x0fXX)
+ * @param reg: ModRM reg field (register or opcode extension)
+ * @param rm: ModRM r/m operand
+ */
+static void x_modrm(struct jit_ctx *c, int w, uint16_t op, uint8_t reg,
+		struct jit_loc rm)
+{
+	uint8_t rex = 0x40, b;
+
+	b = (rm.reg >= 0) ? rm.reg : rm.base;
+	rex |= (w << 3) | ((reg & 0x8) >> 1) | ((b & 0x8) >> 3);
+	if(rex != 0x40)
+		x_byte(c, rex);
+
+	if(op > 0xff)
+		x_byte(c, op >> 8);
+	x_byte(c, op & 0xff);
+
+	if(rm.reg >= 0) {
+		x_byte(c, 0xc0 | ((reg & 0x7) << 3) | (b & 0x7));
+		return;
+	}
+
+	/* Always use a displacement, as rbp/r13 base requires one */
+	if((rm.disp >= -128) && (rm.disp <= 127))
+		x_byte(c, 0x40 | ((reg & 0x7) << 3) | (b & 0x7));
+	else
+		x_byte(c, 0x80 | ((reg & 0x7) << 3) | (b & 0x7));
+
+	/* rsp/r12 base requires a SIB byte */
+	if((b & 0x7) == XR_RSP)
+		x_byte(c, 0x24);
+
+	if((rm.disp >= -128) && (rm.disp <= 127))
+		x_byte(c, rm.disp & 0xff);
+	else
+		x_u32(c, rm.disp);
+}
+
+/* mov r32, r/m32 */
+static inline void x_mov_rm(struct jit_ctx *c, uint8_t dst, struct jit_loc rm)
+{
+	x_modrm(c, 0, 0x8b, dst, rm);
+}
+
+/* mov r/m32, r32 */
+static inline void x_mov_mr(struct jit_ctx *c, struct jit_loc rm, uint8_t src)
+{
+	x_modrm(c, 0, 0x89, src, rm);
+}
+
+/* mov r/m32, imm32 */
+static inline void x_mov_mi(struct jit_ctx *c, struct jit_loc rm, uint32_t imm)
+{
+	x_modrm(c, 0, 0xc7, 0, rm);
+	x_u32(c, imm);
+}
+
+/* mov r64, r/m64 */
+static inline void x_mov64_rm(struct jit_ctx *c, uint8_t dst,
+		struct jit_loc rm)
+{
+	x_modrm(c, 1, 0x8b, dst, rm);
+}
+
+/* mov r/m64, r64 */
+static inline void x_mov64_mr(struct jit_ctx *c, struct jit_loc rm,
+		uint8_t src)
+{
+	x_modrm(c, 1, 0x89, src, rm);
+}
+
+/* mov r64, imm64 */
+static inline void x_mov64_ri(struct jit_ctx *c, uint8_t dst, uint64_t imm)
+{
+	x_byte(c, 0x48 | ((dst & 0x8) >> 3));
+	x_byte(c, 0xb8 | (dst & 0x7));
+	x_u64(c, imm);
+}
+
+/* <op> r32, r/m32 */
+static inline void x_alu_rm(struct jit_ctx *c, uint8_t op, uint8_t dst,
+		struct jit_loc rm)
+{
+	x_modrm(c, 0, op, dst, rm);
+}
+
+/* <op> r/m32, imm32 */
+static inline void x_alu_mi(struct jit_ctx *c, enum x86_alu op,
+		struct jit_loc rm, uint32_t imm)
+{
+	x_modrm(c, 0, 0x81, op, rm);
+	x_u32(c, imm);
+}
+
+/* <shift> r/m32, imm8 */
+static inline void x_shift_i(struct jit_ctx *c, enum x86_shift op,
+		struct jit_loc rm, uint8_t imm)
+{
+	x_modrm(c, 0, 0xc1, op, rm);
+	x_byte(c, imm);
+}
+
+/* <shift> r/m32, cl */
+static inline void x_shift_cl(struct jit_ctx *c, enum x86_shift op,
+		struct jit_loc rm)
+{
+	x_modrm(c, 0, 0xd3, op, rm);
+}
+
+/* not r/m32 */
+static inline void x_not(struct jit_ctx *c, struct jit_loc rm)
+{
+	x_modrm(c, 0, 0xf7, 2, rm);
+}
+
+/* set<cc> r8 (only for registers that do not need REX to be encoded) */
+static inline void x_setcc(struct jit_ctx *c, enum x86_cc cc, uint8_t dst)
+{
+	x_modrm(c, 0, 0x0f90 | cc, 0, LOC_REG(dst));
+}
+
+/* movzx r32, r8 */
+static inline void x_movzx8(struct jit_ctx *c, uint8_t dst, uint8_t src)
+{
+	x_modrm(c, 0, 0x0fb6, dst, LOC_REG(src));
+}
+
+/* test r/m32, r32 */
+static inline void x_test(struct jit_ctx *c, struct jit_loc rm, uint8_t src)
+{
+	x_modrm(c, 0, 0x85, src, rm);
+}
+
+/* call r64 */
+static inline void x_call(struct jit_ctx *c, uint8_t reg)
+{
+	x_modrm(c, 0, 0xff, 2, LOC_REG(reg));
+}
+
+/* j<cc> rel32, returns displacement address to patch */
+static inline uint8_t *x_jcc(struct jit_ctx *c, enum x86_cc cc)
+{
+	uint8_t *rel;
+
+	x_byte(c, 0x0f);
+	x_byte(c, 0x80 | cc);
+	rel = c->p;
+	x_u32(c, 0);
+	return rel;
+}
+
+/* jmp rel32 to a known address */
+static inline void x_jmp_to(struct jit_ctx *c, uint8_t *dst)
+{
+	x_byte(c, 0xe9);
+	x_u32(c, (uint32_t)(dst - (c->p + 4)));
+}
+
+/* Make a forward jump land on current emission address */
+static inline void x_patch(struct jit_ctx *c, uint8_t *rel)
+{
+	int32_t d = c->p - (rel + 4);
+
+	if(c->err)
+		return;
+
+	rel[0] = d & 0xff;
+	rel[1] = (d >> 8) & 0xff;
+	rel[2] = (d >> 16) & 0xff;
+	rel[3] = (d >> 24) & 0xff;
+}
+
+/* ---------------------- Guest state access ------------------------ */
+
+/* Guest register memory location */
+static inline struct jit_loc jit_mem(sridx r)
+{
+	if(r < 8)
+		return LOC_MEM(XR_REGS, (r - 1) * sizeof(sreg));
+
+	return LOC_MEM(XR_WIN, (r - 1) * sizeof(sreg));
+}
+
+/* Guest register current location */
+static inline struct jit_loc jit_loc(struct jit_ctx *c, sridx r)
+{
+	if(c->hreg[r] >= 0)
+		return LOC_REG(c->hreg[r]);
+
+	return jit_mem(r);
+}
+
+/* PSR memory location */
+static inline struct jit_loc jit_psr(struct jit_ctx *c)
+{
+	return LOC_MEM(XR_REGS, (uint8_t *)c->jit->psr - (uint8_t *)c->jit->r);
+}
+
+/* Load guest register into host register */
+static void jit_load_reg(struct jit_ctx *c, uint8_t dst, sridx r)
+{
+	if(r == 0)
+		x_alu_rm(c, 0x33, dst, LOC_REG(dst));
+	else
+		x_mov_rm(c, dst, jit_loc(c, r));
+}
+
+/* Store host register into guest register */
+static void jit_store_reg(struct jit_ctx *c, sridx r, uint8_t src)
+{
+	if(r == 0)
+		return;
+
+	x_mov_mr(c, jit_loc(c, r), src);
+	if(c->hreg[r] >= 0)
+		c->dirty |= (1 << r);
+}
+
+/* Write back modified cached guest registers */
+static void jit_sync(struct jit_ctx *c)
+{
+	sridx r;
+
+	for(r = 1; r < 32; ++r)
+		if(c->dirty & (1 << r))
+			x_mov_mr(c, jit_mem(r), c->hreg[r]);
+
+	c->dirty = 0;
+}
+
+/* Point window base to current window (CWP * 16 registers) */
+static void jit_window(struct jit_ctx *c)
+{
+	x_mov_rm(c, XR_RAX, jit_psr(c));
+	x_alu_mi(c, XA_AND, LOC_REG(XR_RAX), 0x1f);
+	x_shift_i(c, XS_SHL, LOC_REG(XR_RAX), 6);
+	/* lea r13, [r12 + rax] */
+	x_byte(c, 0x4d);
+	x_byte(c, 0x8d);
+	x_byte(c, 0x2c);
+	x_byte(c, 0x04);
+}
+
+/* Reload window base and cached guest registers */
+static void jit_reload(struct jit_ctx *c)
+{
+	sridx r;
+
+	jit_window(c);
+	for(r = 1; r < 32; ++r)
+		if(c->cached & (1 << r))
+			x_mov_rm(c, c->hreg[r], jit_mem(r));
+}
+
+/* ----------------------- Native code exits ------------------------ */
+
+/*
+ * Add executed instruction number and leave, eax holding returned value. Exit
+ * can be conditional, thus code following it still sees registers as dirty.
+ */
+static void jit_exit_ret(struct jit_ctx *c, uint8_t nr)
+{
+	uint32_t dirty = c->dirty;
+
+	jit_sync(c);
+	c->dirty = dirty;
+	x_mov64_rm(c, XR_RCX, LOC_MEM(XR_RSP, JIT_FRAME_NRISN));
+	x_modrm(c, 1, 0x81, XA_ADD, LOC_MEM(XR_RCX, 0));
+	x_u32(c, nr);
+	x_jmp_to(c, c->epi);
+}
+
+/* Leave without trap, next instruction address already being set */
+static void jit_exit_done(struct jit_ctx *c, uint8_t nr)
+{
+	x_alu_rm(c, 0x33, XR_RAX, LOC_REG(XR_RAX));
+	jit_exit_ret(c, nr);
+}
+
+/* Leave without trap, setting next instruction address */
+static void jit_exit_next(struct jit_ctx *c, uint8_t nr, addr_t next)
+{
+	x_mov64_rm(c, XR_RCX, LOC_MEM(XR_RSP, JIT_FRAME_NEXT));
+	x_mov_mi(c, LOC_MEM(XR_RCX, 0), next);
+	jit_exit_done(c, nr);
+}
+
+/* Set next instruction address */
+static void jit_set_next(struct jit_ctx *c, addr_t next)
+{
+	x_mov64_rm(c, XR_RCX, LOC_MEM(XR_RSP, JIT_FRAME_NEXT));
+	x_mov_mi(c, LOC_MEM(XR_RCX, 0), next);
+}
+
+/* -------------------- Instruction translation --------------------- */
+
+/* Is instruction a specialized ALU operation that can be emitted natively */
+static inline int jit_is_alu(struct sparc_isn const *isn)
+{
+	return (isn->xop >= SX_ADD_IMM) && (isn->xop < SX_NR);
+}
+
+/* Is instruction emitted natively, outside of block end */
+static inline int jit_is_native(struct sparc_isn const *isn)
+{
+	return (isn->xop == SX_SETHI) || jit_is_alu(isn);
+}
+
+/* Condition codes set by a native instruction */
+static inline uint32_t jit_isn_icc(struct sparc_isn const *isn)
+{
+	if(!jit_is_alu(isn))
+		return 0;
+
+	return _jit_alu[JIT_ALU_IDX(isn->xop)].icc;
+}
+
+/* Condition codes set by a native instruction that match x86 flags */
+static inline uint32_t jit_isn_xicc(struct sparc_isn const *isn)
+{
+	if(!jit_is_alu(isn))
+		return 0;
+
+	return _jit_alu[JIT_ALU_IDX(isn->xop)].xicc;
+}
+
+/* Can a Bicc be emitted natively, with flags set by previous instruction */
+static int jit_bicc_inline(struct jit_ctx *c, uint8_t i)
+{
+	struct sparc_isn const *isn = &c->b->isn[i].isn;
+	uint32_t icc;
+
+	if((isn->id == SI_BA) || (isn->id == SI_BN))
+		return 1;
+
+	if((isn->id < SI_BN) || (isn->id > SI_BVS) || (i == 0))
+		return 0;
+
+	icc = jit_isn_xicc(&c->b->isn[i - 1].isn);
+	return (icc != 0) &&
+		((_jit_bicc[isn->id - SI_BN].icc & ~icc) == 0);
+}
+
+/*
+ * Are condition codes set by instruction overwritten before being read,
+ * delay slot is not considered as it can be annulled
+ */
+static int jit_icc_dead(struct jit_ctx *c, uint8_t i, uint8_t last)
+{
+	struct sparc_isn const *isn;
+	uint8_t j;
+
+	for(j = i + 1; j <= last; ++j) {
+		isn = &c->b->isn[j].isn;
+		if(!jit_is_native(isn))
+			return 0;
+
+		if((jit_isn_icc(&c->b->isn[i].isn) & ~jit_isn_icc(isn)) == 0)
+			return 1;
+
+		if(jit_isn_icc(isn) != 0)
+			return 0;
+	}
+
+	return 0;
+}
+
+/**
+ * Emit condition codes update from x86 flags
+ *
+ * @param c: Compilation context
+ * @param a: ALU operation that set x86 flags
+ * @param isn: Instruction being emitted
+ */
+static void jit_emit_icc(struct jit_ctx *c, struct jit_alu const *a,
+		struct sparc_isn const *isn)
+{
+	struct sparc_ifmt_op3_imm const *ii = to_ifmt(op3_imm, isn);
+
+	/* Grab flags first, eax = N << 3 | Z << 2 | V << 1 | C */
+	x_setcc(c, XC_S, XR_RAX);
+	x_setcc(c, XC_E, XR_RCX);
+	if(a->icc == JIT_ICC_MASK)
+		x_setcc(c, XC_O, XR_RDX);
+	if(a->xicc & JIT_ICC_C)
+		x_setcc(c, XC_B, XR_R8);
+
+	x_movzx8(c, XR_RAX, XR_RAX);
+	x_movzx8(c, XR_RCX, XR_RCX);
+	x_shift_i(c, XS_SHL, LOC_REG(XR_RAX), 3);
+	x_shift_i(c, XS_SHL, LOC_REG(XR_RCX), 2);
+	x_alu_rm(c, 0x0b, XR_RAX, LOC_REG(XR_RCX));
+	if(a->icc == JIT_ICC_MASK) {
+		x_movzx8(c, XR_RDX, XR_RDX);
+		x_alu_rm(c, 0x03, XR_RDX, LOC_REG(XR_RDX));
+		x_alu_rm(c, 0x0b, XR_RAX, LOC_REG(XR_RDX));
+	}
+
+	if(a->xicc & JIT_ICC_C) {
+		x_movzx8(c, XR_R8, XR_R8);
+		x_alu_rm(c, 0x0b, XR_RAX, LOC_REG(XR_R8));
+	} else if((a->icc & JIT_ICC_C) && JIT_ALU_IS_IMM(isn->xop)) {
+		x_alu_mi(c, XA_OR, LOC_REG(XR_RAX), ii->imm >> 31);
+	} else if(a->icc & JIT_ICC_C) {
+		/* Second operand has been saved before rd got written */
+		x_shift_i(c, XS_SHR, LOC_REG(XR_R8), 31);
+		x_alu_rm(c, 0x0b, XR_RAX, LOC_REG(XR_R8));
+	}
+
+	x_shift_i(c, XS_SHL, LOC_REG(XR_RAX), JIT_ICC_SHIFT);
+	x_mov_rm(c, XR_RCX, jit_psr(c));
+	x_alu_mi(c, XA_AND, LOC_REG(XR_RCX), ~a->icc);
+	x_alu_rm(c, 0x0b, XR_RCX, LOC_REG(XR_RAX));
+	x_mov_mr(c, jit_psr(c), XR_RCX);
+}
+
+/**
+ * Emit a native ALU instruction
+ *
+ * @param c: Compilation context
+ * @param i: Instruction index in block
+ * @param brcc: x86 condition to save for next Bicc, negative if none
+ * @param icc: 1 if condition codes have to be updated
+ */
+static void jit_emit_alu(struct jit_ctx *c, uint8_t i, int brcc, int icc)
+{
+	struct sparc_isn const *isn = &c->b->isn[i].isn;
+	struct jit_alu const *a = &_jit_alu[JIT_ALU_IDX(isn->xop)];
+	struct sparc_ifmt_op3_imm const *ii = to_ifmt(op3_imm, isn);
+	struct sparc_ifmt_op3_reg const *ir = to_ifmt(op3_reg, isn);
+	int imm = JIT_ALU_IS_IMM(isn->xop);
+	sridx rd = imm ? ii->rd : ir->rd;
+
+	/* Carry computed from second operand, which rd can overwrite */
+	if(icc && (a->icc & ~a->xicc & JIT_ICC_C) && !imm)
+		jit_load_reg(c, XR_R8, ir->rs2);
+
+	jit_load_reg(c, XR_RAX, imm ? ii->rs1 : ir->rs1);
+
+	switch(a->kind) {
+	case JK_ALU:
+		if(imm)
+			x_alu_mi(c, a->ext, LOC_REG(XR_RAX), ii->imm);
+		else if(ir->rs2 == 0)
+			x_alu_mi(c, a->ext, LOC_REG(XR_RAX), 0);
+		else
+			x_alu_rm(c, a->op, XR_RAX, jit_loc(c, ir->rs2));
+		break;
+	case JK_ANDN:
+		if(imm) {
+			x_alu_mi(c, XA_AND, LOC_REG(XR_RAX), ~ii->imm);
+		} else {
+			jit_load_reg(c, XR_RCX, ir->rs2);
+			x_not(c, LOC_REG(XR_RCX));
+			x_alu_rm(c, a->op, XR_RAX, LOC_REG(XR_RCX));
+		}
+		break;
+	case JK_SHIFT:
+		if(imm) {
+			x_shift_i(c, a->ext, LOC_REG(XR_RAX), ii->imm & 0x1f);
+		} else {
+			jit_load_reg(c, XR_RCX, ir->rs2);
+			x_shift_cl(c, a->ext, LOC_REG(XR_RAX));
+		}
+		break;
+	}
+
+	/* Neither setcc nor mov change flags */
+	if(brcc >= 0)
+		x_setcc(c, brcc, XR_COND);
+	jit_store_reg(c, rd, XR_RAX);
+	if(icc && a->icc)
+		jit_emit_icc(c, a, isn);
+}
+
+/* Emit SETHI */
+static void jit_emit_sethi(struct jit_ctx *c, uint8_t i)
+{
+	struct sparc_ifmt_op2_imm const *isn = to_ifmt(op2_imm,
+			&c->b->isn[i].isn);
+
+	if(isn->rd == 0)
+		return;
+
+	x_mov_mi(c, LOC_REG(XR_RAX), isn->imm << 10);
+	jit_store_reg(c, isn->rd, XR_RAX);
+}
+
+/* Emit first arguments of a cpu callback (cpu, isn, pc) */
+static void jit_emit_args(struct jit_ctx *c, uint8_t i, addr_t pc)
+{
+	jit_sync(c);
+	x_mov64_rm(c, XR_RDI, LOC_MEM(XR_RSP, JIT_FRAME_CPU));
+	x_mov64_ri(c, XR_RSI, (uintptr_t)&c->b->isn[i].isn);
+	x_mov_mi(c, LOC_REG(XR_RDX), pc);
+}
+
+/* Emit cpu callback call, leaving if it raised a trap */
+static void jit_emit_call(struct jit_ctx *c, uintptr_t fn, uint8_t i)
+{
+	uint8_t *rel;
+
+	x_mov64_ri(c, XR_RAX, fn);
+	x_call(c, XR_RAX);
+	x_test(c, LOC_REG(XR_RAX), XR_RAX);
+	rel = x_jcc(c, XC_E);
+	jit_exit_ret(c, i + 1);
+	x_patch(c, rel);
+	jit_reload(c);
+}
+
+/**
+ * Emit an instruction executed by the interpreter
+ *
+ * @param c: Compilation context
+ * @param i: Instruction index in block
+ * @param pc: Instruction address
+ * @param npc: Next instruction address, if known
+ * @param dyn: 1 if next instruction address is not known (set by a DCTI)
+ */
+static void jit_emit_isn_call(struct jit_ctx *c, uint8_t i, addr_t pc,
+		addr_t npc, int dyn)
+{
+	jit_emit_args(c, i, pc);
+	if(dyn) {
+		x_mov64_rm(c, XR_RCX, LOC_MEM(XR_RSP, JIT_FRAME_NEXT));
+		x_mov_rm(c, XR_RCX, LOC_MEM(XR_RCX, 0));
+	} else {
+		x_mov_mi(c, LOC_REG(XR_RCX), npc);
+	}
+	jit_emit_call(c, (uintptr_t)scpu_jit_isn, i);
+}
+
+/* Leave if a store modified block instructions */
+static void jit_emit_gen_check(struct jit_ctx *c, uint8_t i, addr_t pc)
+{
+	uint8_t *rel;
+
+	x_mov64_ri(c, XR_RAX, (uintptr_t)&c->b->page->gen);
+	x_modrm(c, 0, 0x81, XA_CMP, LOC_MEM(XR_RAX, 0));
+	x_u32(c, c->b->gen);
+	rel = x_jcc(c, XC_E);
+	jit_exit_next(c, i + 1, pc + sizeof(opcode));
+	x_patch(c, rel);
+}
+
+/* Emit a straight-line (non DCTI) instruction */
+static void jit_emit_isn(struct jit_ctx *c, uint8_t i, uint8_t last,
+		addr_t pc, int brcc)
+{
+	struct sparc_isn const *isn = &c->b->isn[i].isn;
+
+	if(isn->xop == SX_SETHI) {
+		jit_emit_sethi(c, i);
+	} else if(jit_is_alu(isn)) {
+		jit_emit_alu(c, i, brcc, !jit_icc_dead(c, i, last));
+	} else {
+		jit_emit_isn_call(c, i, pc, pc + sizeof(opcode), 0);
+		if(i + 1 < c->b->nr)
+			jit_emit_gen_check(c, i, pc);
+	}
+}
+
+/* Emit delay slot, then leave */
+static void jit_emit_delay(struct jit_ctx *c, uint8_t i, addr_t pc,
+		addr_t npc, int dyn)
+{
+	struct sparc_isn const *isn = &c->b->isn[i].isn;
+	uint32_t dirty = c->dirty;
+
+	if(jit_is_native(isn))
+		jit_emit_isn(c, i, i, pc, -1);
+	else
+		jit_emit_isn_call(c, i, pc, npc, dyn);
+
+	jit_exit_done(c, i + 1);
+	/* Other paths resume from state before delay slot */
+	c->dirty = dirty;
+}
+
+/* Emit block ending delayed control transfer and its delay slot */
+static void jit_emit_dcti(struct jit_ctx *c, uint8_t i, addr_t pc)
+{
+	struct sparc_isn const *isn = &c->b->isn[i].isn;
+	struct sparc_ifmt_op2_bicc const *bi = to_ifmt(op2_bicc, isn);
+	addr_t target, npc = pc + 2 * sizeof(opcode);
+	uint8_t *rel;
+
+	if(isn->id == SI_CALL) {
+		target = pc + (to_ifmt(op1, isn)->disp30 << 2);
+		x_mov_mi(c, LOC_REG(XR_RAX), pc);
+		jit_store_reg(c, JIT_O7, XR_RAX);
+		jit_set_next(c, target);
+		jit_emit_delay(c, i + 1, pc + sizeof(opcode), target, 0);
+		return;
+	}
+
+	if(!jit_bicc_inline(c, i)) {
+		/* Let the interpreter compute the jump, then run delay slot */
+		jit_emit_args(c, i, pc);
+		x_mov64_rm(c, XR_RCX, LOC_MEM(XR_RSP, JIT_FRAME_NEXT));
+		x_mov64_ri(c, XR_RAX, (uintptr_t)scpu_jit_dcti);
+		x_call(c, XR_RAX);
+		/* 2 means delay slot is annulled */
+		x_alu_mi(c, XA_CMP, LOC_REG(XR_RAX), 2);
+		rel = x_jcc(c, XC_NE);
+		jit_exit_done(c, i + 1);
+		x_patch(c, rel);
+		x_test(c, LOC_REG(XR_RAX), XR_RAX);
+		rel = x_jcc(c, XC_E);
+		jit_exit_ret(c, i + 1);
+		x_patch(c, rel);
+		jit_reload(c);
+		jit_emit_delay(c, i + 1, pc + sizeof(opcode), 0, 1);
+		return;
+	}
+
+	target = pc + (bi->disp << 2);
+	pc += sizeof(opcode);
+	if(isn->id == SI_BA) {
+		jit_set_next(c, target);
+		if(bi->a)
+			jit_exit_done(c, i + 1);
+		else
+			jit_emit_delay(c, i + 1, pc, target, 0);
+		return;
+	}
+
+	if(isn->id != SI_BN) {
+		/* Taken branch always runs delay slot (test r9b, r9b) */
+		x_modrm(c, 0, 0x84, XR_COND, LOC_REG(XR_COND));
+		rel = x_jcc(c, XC_E);
+		jit_set_next(c, target);
+		jit_emit_delay(c, i + 1, pc, target, 0);
+		x_patch(c, rel);
+	}
+
+	jit_set_next(c, npc);
+	if(bi->a)
+		jit_exit_done(c, i + 1);
+	else
+		jit_emit_delay(c, i + 1, pc, npc, 0);
+}
+
+/* Count guest register uses of a native instruction */
+static void jit_count_regs(struct sparc_isn const *isn, uint32_t *cnt)
+{
+	struct sparc_ifmt_op3_imm const *ii = to_ifmt(op3_imm, isn);
+	struct sparc_ifmt_op3_reg const *ir = to_ifmt(op3_reg, isn);
+
+	if(isn->xop == SX_SETHI) {
+		++cnt[to_ifmt(op2_imm, isn)->rd];
+	} else if(jit_is_alu(isn) && JIT_ALU_IS_IMM(isn->xop)) {
+		++cnt[ii->rd];
+		++cnt[ii->rs1];
+	} else if(jit_is_alu(isn)) {
+		++cnt[ir->rd];
+		++cnt[ir->rs1];
+		++cnt[ir->rs2];
+	}
+}
+
+/* Select guest registers held in host registers, the most used ones */
+static void jit_alloc_regs(struct jit_ctx *c)
+{
+	uint32_t cnt[32] = {0};
+	uint8_t i, n, r, best;
+
+	for(r = 0; r < 32; ++r)
+		c->hreg[r] = -1;
+	c->cached = 0;
+	c->dirty = 0;
+
+	for(i = 0; i < c->b->nr; ++i)
+		jit_count_regs(&c->b->isn[i].isn, cnt);
+	if(c->b->end == BE_DCTI && c->b->isn[c->b->nr - 2].isn.id == SI_CALL)
+		++cnt[JIT_O7];
+	/* %g0 is never stored */
+	cnt[0] = 0;
+
+	for(n = 0; n < JIT_NRHREG; ++n) {
+		best = 0;
+		for(r = 1; r < 32; ++r)
+			if(cnt[r] > cnt[best])
+				best = r;
+
+		/* Register used once is not worth being loaded */
+		if(cnt[best] < 2)
+			break;
+
+		c->hreg[best] = _jit_hreg[n];
+		c->cached |= (1 << best);
+		cnt[best] = 0;
+	}
+}
+
+/* Emit prologue, shared epilogue is emitted right after */
+static void jit_emit_prologue(struct jit_ctx *c)
+{
+	uint8_t *rel;
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(_jit_saved); ++i) {
+		if(_jit_saved[i] & 0x8)
+			x_byte(c, 0x41);
+		x_byte(c, 0x50 | (_jit_saved[i] & 0x7));
+	}
+
+	/* sub rsp, frame size (keeps stack 16 bytes aligned for calls) */
+	x_modrm(c, 1, 0x81, XA_SUB, LOC_REG(XR_RSP));
+	x_u32(c, JIT_FRAME_SZ);
+	x_mov64_mr(c, LOC_MEM(XR_RSP, JIT_FRAME_CPU), XR_RDI);
+	x_mov64_mr(c, LOC_MEM(XR_RSP, JIT_FRAME_NRISN), XR_RSI);
+	x_mov64_mr(c, LOC_MEM(XR_RSP, JIT_FRAME_NEXT), XR_RDX);
+	x_mov64_ri(c, XR_REGS, (uintptr_t)c->jit->r);
+
+	x_byte(c, 0xe9);
+	rel = c->p;
+	x_u32(c, 0);
+
+	/* Epilogue */
+	c->epi = c->p;
+	x_modrm(c, 1, 0x81, XA_ADD, LOC_REG(XR_RSP));
+	x_u32(c, JIT_FRAME_SZ);
+	for(i = ARRAY_SIZE(_jit_saved); i > 0; --i) {
+		if(_jit_saved[i - 1] & 0x8)
+			x_byte(c, 0x41);
+		x_byte(c, 0x58 | (_jit_saved[i - 1] & 0x7));
+	}
+	x_byte(c, 0xc3);
+
+	x_patch(c, rel);
+	jit_reload(c);
+}
+
+/**
+ * Emit whole block
+ */
+static void jit_emit_block(struct jit_ctx *c)
+{
+	struct block *b = c->b;
+	addr_t pc = b->pc;
+	uint8_t i, last = b->nr - 1;
+	int brcc;
+
+	if(b->end == BE_DCTI)
+		last = b->nr - 2;
+
+	jit_alloc_regs(c);
+	jit_emit_prologue(c);
+
+	for(i = 0; i < b->nr; ++i, pc += sizeof(opcode)) {
+		if((b->end == BE_DCTI) && (i == last)) {
+			jit_emit_dcti(c, i, pc);
+			return;
+		}
+
+		/* Keep x86 flags for an inlined Bicc */
+		brcc = -1;
+		if((b->end == BE_DCTI) && (i + 1 == last) &&
+				jit_bicc_inline(c, last) &&
+				(b->isn[last].isn.id != SI_BA) &&
+				(b->isn[last].isn.id != SI_BN))
+			brcc = _jit_bicc[b->isn[last].isn.id - SI_BN].cc;
+
+		jit_emit_isn(c, i, last, pc, brcc);
+	}
+
+	jit_exit_next(c, b->nr, pc);
+}
+
+/**
+ * Initialize native code generator
+ *
+ * @param jit: Code generator to initialize
+ * @param psr: Guest PSR register
+ * @param r: Guest register file (%g1 first, then windows)
+ */
+void jit_init(struct jit *jit, sreg *psr, sreg *r)
+{
+	jit->code = NULL;
+	jit->off = 0;
+	jit->gen = 0;
+	jit->psr = psr;
+	jit->r = r;
+}
+
+/**
+ * Release native code arena
+ *
+ * @param jit: Code generator to cleanup
+ */
+void jit_cleanup(struct jit *jit)
+{
+	if(jit->code != NULL)
+		munmap(jit->code, JIT_ARENA_SZ);
+	jit->code = NULL;
+}
+
+/**
+ * Compile a block to native code. When code arena is full, it is recycled and
+ * all previously compiled blocks become stale.
+ *
+ * @param jit: Code generator
+ * @param b: Block to compile
+ * @return: 0 on success, negative number otherwise
+ */
+int jit_compile(struct jit *jit, struct block *b)
+{
+	struct jit_ctx c = {
+		.jit = jit,
+		.b = b,
+	};
+
+	if(jit->code == NULL) {
+		jit->code = mmap(NULL, JIT_ARENA_SZ,
+				PROT_READ | PROT_WRITE | PROT_EXEC,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(jit->code == MAP_FAILED) {
+			jit->code = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	if(jit->off + JIT_BLOCK_MAXSZ > JIT_ARENA_SZ) {
+		jit->off = 0;
+		++jit->gen;
+	}
+
+	c.p = jit->code + jit->off;
+	c.end = c.p + JIT_BLOCK_MAXSZ;
+	jit_emit_block(&c);
+	if(c.err)
+		return -ENOSPC;
+
+	b->jit = (jit_fn)(jit->code + jit->off);
+	b->jitgen = jit->gen;
+	/* Keep entry points 16 bytes aligned */
+	jit->off = (c.p - jit->code + 15) & ~((size_t)15);
+
+	return 0;
+}
+
+#endif /* SPARC_JIT */
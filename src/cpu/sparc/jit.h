@@ -0,0 +1,49 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "cpu/cpu.h"
+
+#include "sparc.h"
+#include "isn.h"
+
+/* Number of block executions before it gets compiled */
+#ifndef JIT_THRESHOLD
+#define JIT_THRESHOLD 64
+#endif
+
+struct block;
+
+/**
+ * Compiled block entry point, same contract as the block interpreter: returns
+ * 1 if an instruction raised a trap (PC registers are then set for it), 0
+ * otherwise, negative number on error. nrisn is incremented by the number of
+ * executed instructions and next is filled with next instruction address.
+ */
+typedef int (*jit_fn)(struct cpu *cpu, size_t *nrisn, addr_t *next);
+
+/**
+ * Native code generator state
+ */
+struct jit {
+	/* Lazily mapped executable code arena */
+	uint8_t *code;
+	/* Arena used size */
+	size_t off;
+	/* Arena generation, code compiled for an older one is stale */
+	uint32_t gen;
+	/* Guest register file */
+	sreg *psr;
+	sreg *r;
+};
+
+void jit_init(struct jit *jit, sreg *psr, sreg *r);
+void jit_cleanup(struct jit *jit);
+int jit_compile(struct jit *jit, struct block *b);
+
+/* Called from native code, implemented by the cpu */
+int scpu_jit_isn(struct cpu *cpu, struct sparc_isn const *isn, addr_t pc,
+		addr_t npc);
+int scpu_jit_dcti(struct cpu *cpu, struct sparc_isn const *isn, addr_t pc,
+		addr_t *npc);
+
+#endif
@@ -1,3 +1,3 @@
 BUNDLE = b-sporc
 
-b-sporc-CSRC = sparc.c decoder.c iu.c trap.c
+b-sporc-CSRC = sparc.c decoder.c iu.c trap.c icache.c block.c jit.c hmem.c
@@ -0,0 +1,455 @@
+#ifndef _SCPU_H_
+#define _SCPU_H_
+
+#include "utils.h"
+#include "types.h"
+
+#include "cpu/cpu.h"
+#include "sparc.h"
+#include "isn.h"
+#include "icache.h"
+#include "block.h"
+#include "jit.h"
+#include "trap.h"
+#include "hmem.h"
+
+#define SPARC_NRWIN 32
+/* General purpose registers (%g[1-7] then 16 registers per window) */
+#define SPARC_NRREG (7 + (16 * SPARC_NRWIN + 16))
+#define SPARC_CACHELINE 64
+
+struct sparc_registers {
+	/* pc[0] is pc, pc[1] is npc and pc[2] is filled by branche isn */
+	sreg pc[3];
+	/* Special registers */
+	sreg psr;
+	sreg y;
+	sreg tbr;
+	sreg wim;
+};
+
+#define PSR_ICC_OFF_N (23)
+#define PSR_ICC_OFF_Z (22)
+#define PSR_ICC_OFF_V (21)
+#define PSR_ICC_OFF_C (20)
+#define PSR_ICC_OFF (20)
+#define PSR_ICC_MASK (0xf << PSR_ICC_OFF)
+#define PSR_ICC_GET(sr, n) (((sr)->psr >> PSR_ICC_OFF_ ## n) & 0x1)
+#define PSR_ICC_SET(sr, n, v)						\
+	(((sr)->psr = ((sr)->psr & ~(1 << ((PSR_ICC_OFF_ ## n)))) |	\
+		(((v) & 0x1)  << (PSR_ICC_OFF_ ## n))))
+#define PSR_CWP(sr) ((sr)->psr & 0x1f)
+#define PSR_SET_CWP(sr, v) ((sr)->psr = ((sr)->psr & ~(0x1f)) | ((v) & 0x1f))
+#define PSR_ET(sr) (((sr)->psr >> 5) & 0x1)
+#define PSR_SET_ET(sr, v)						\
+	((sr)->psr = ((sr)->psr & ~(1 << 5)) | (((v) & 0x1) << 5))
+#define PSR_PS(sr) (((sr)->psr >> 6) & 0x1)
+#define PSR_SET_PS(sr, v)						\
+	((sr)->psr = ((sr)->psr & ~(1 << 6)) | (((v) & 0x1) << 6))
+#define PSR_S(sr) (((sr)->psr >> 7) & 0x1)
+#define PSR_SET_S(sr, v)						\
+	((sr)->psr = ((sr)->psr & ~(1 << 7)) | (((v) & 0x1) << 7))
+
+#define TBR_TT(sr) (((sr)->tbr >> 4) & 0xff)
+#define TBR_SET_TT(sr, v)						\
+	((sr)->tbr = ((sr)->tbr & ~(0xff0)) | (((v) & 0xff) << 4))
+
+#define _SREG_IDX(sr, idx) (((idx) < 8) ? (idx) :			\
+		(8 + (idx) + PSR_CWP(sr) * 16))
+#define SREG(sr) ((sr)->r[_SREG_IDX(sr, idx)])
+
+enum scpu_mode {
+	SM_ERR,
+	SM_EXC,
+};
+
+#define SPARC_ASSZ 256
+#define SPARC_PIPESZ 2
+#define SPARC_NRBREAK 8
+#define SPARC_NRTRAP 256
+
+/*
+ * Fields are grouped by access frequency, execution state that is touched by
+ * every instruction comes first and is cache line aligned, tables only used
+ * by slow paths come last.
+ */
+struct sparc_cpu {
+	struct cpu cpu;
+	/* PCs and special registers */
+	struct sparc_registers reg __attribute__((aligned(SPARC_CACHELINE)));
+	/* %g0 slot, reads as zero as it is cleared after each register write */
+	sreg g0;
+	/* Lazy condition codes, PSR icc field is stale unless op is CC_OP_FLAGS */
+	struct {
+		enum scpu_ccop op;
+		uint32_t res;
+		uint32_t v1;
+		uint32_t v2;
+	} cc;
+	/* Annul next instruction flag */
+	uint8_t annul;
+	/* Number of PC breakpoints set */
+	uint8_t nrbrk;
+	enum scpu_mode mode;
+	/* Number of instruction dispatches saved by fused pairs */
+	uint64_t nrfused;
+	/* Pending traps */
+	struct trap_queue tq __attribute__((aligned(SPARC_CACHELINE)));
+	/* Cpu instruction pipeline */
+	union sparc_isn_fill pipeline[SPARC_PIPESZ];
+	/* Current window registers, indexed by opcode register index */
+	sreg *win[32] __attribute__((aligned(SPARC_CACHELINE)));
+	/*
+	 * general purpose registers (%g[1-7], %i[0-7], %o[0-7], %l[0-7])
+	 * (%g0 is a special always null register, thus do not need to be stored
+	 * in this array)
+	 */
+	sreg r[SPARC_NRREG] __attribute__((aligned(SPARC_CACHELINE)));
+	/* Data memory pages directly accessed through host memory */
+	struct hmem_cache hmem;
+	/* Predecoded instruction cache */
+	struct icache icache;
+	/* Translated basic blocks cache */
+	struct block_cache bcache;
+#ifdef SPARC_JIT
+	/* Hot blocks native code generator */
+	struct jit jit;
+#endif
+	/* PC breakpoints */
+	addr_t brk[SPARC_NRBREAK];
+	/* Trap types that stop cpu run when taken */
+	uint32_t tcatch[SPARC_NRTRAP / 32];
+	/* Sparc alternate spaces mapping */
+	struct dev *altspace[SPARC_ASSZ];
+};
+
+#define to_sparc_cpu(c) (container_of(c, struct sparc_cpu, cpu))
+
+/**
+ * Get a generic register from its opcode index
+ *
+ * @param cpu: cpu to fetch register from
+ * @param ridx: register index
+ * @return: Register value
+ */
+static inline sreg scpu_get_reg(struct cpu *cpu, sridx ridx)
+{
+	return *to_sparc_cpu(cpu)->win[ridx & 0x1f];
+}
+
+/**
+ * Set a generic register from its opcode index
+ *
+ * @param cpu: cpu to set register to
+ * @param ridx: register index
+ * @param val: Register value
+ */
+static inline void scpu_set_reg(struct cpu *cpu, sridx ridx, sreg val)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	*scpu->win[ridx & 0x1f] = val;
+	scpu->g0 = 0;
+}
+
+/**
+ * Compute condition codes from last condition codes setting operation
+ *
+ * @param scpu: cpu to compute condition codes for
+ * @return: Condition codes (SCPU_ICC_* bits)
+ */
+static inline uint8_t scpu_cc_eval(struct sparc_cpu const *scpu)
+{
+	uint32_t res = scpu->cc.res;
+	uint8_t s1 = (scpu->cc.v1 >> 31) & 0x1;
+	uint8_t s2 = (scpu->cc.v2 >> 31) & 0x1;
+	uint8_t sr = (res >> 31) & 0x1;
+	uint8_t icc;
+
+	if(scpu->cc.op == CC_OP_FLAGS)
+		return (scpu->reg.psr & PSR_ICC_MASK) >> PSR_ICC_OFF;
+
+	icc = (sr ? SCPU_ICC_N : 0) | ((res == 0) ? SCPU_ICC_Z : 0);
+	switch(scpu->cc.op) {
+	case CC_OP_LOGIC:
+		icc |= ((scpu->reg.psr & PSR_ICC_MASK) >> PSR_ICC_OFF) &
+			(SCPU_ICC_V | SCPU_ICC_C);
+		break;
+	case CC_OP_ADD:
+		if(!(s1 ^ s2) && (s1 ^ sr))
+			icc |= SCPU_ICC_V;
+		if((s1 && s2) || (!sr && (s1 || s2)))
+			icc |= SCPU_ICC_C;
+		break;
+	case CC_OP_SUB:
+		if((s1 ^ s2) && !(s2 ^ sr))
+			icc |= SCPU_ICC_V;
+		if((!s1 && s2) || (s2 && (!s1 || s2)))
+			icc |= SCPU_ICC_C;
+		break;
+	case CC_OP_DIV:
+		if(scpu->cc.v1)
+			icc |= SCPU_ICC_V;
+		break;
+	default:
+		break;
+	}
+
+	return icc;
+}
+
+/**
+ * Write back pending lazy condition codes into PSR
+ *
+ * @param scpu: cpu to update PSR of
+ */
+static inline void scpu_cc_sync(struct sparc_cpu *scpu)
+{
+	if(scpu->cc.op == CC_OP_FLAGS)
+		return;
+
+	scpu->reg.psr = (scpu->reg.psr & ~PSR_ICC_MASK) |
+		(scpu_cc_eval(scpu) << PSR_ICC_OFF);
+	scpu->cc.op = CC_OP_FLAGS;
+}
+
+/**
+ * Record a condition codes setting operation, flags will be computed from it
+ * only if something reads them
+ *
+ * @param cpu: cpu to set conditional codes to
+ * @param op: Operation kind
+ * @param res: Operation result
+ * @param v1: First operand
+ * @param v2: Second operand
+ */
+static inline void scpu_set_cc_lazy(struct cpu *cpu, enum scpu_ccop op, uint32_t res,
+		uint32_t v1, uint32_t v2)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	/* Logical operations keep V and C from the previous operation */
+	if((op == CC_OP_LOGIC) && (scpu->cc.op != CC_OP_LOGIC))
+		scpu_cc_sync(scpu);
+
+	scpu->cc.op = op;
+	scpu->cc.res = res;
+	scpu->cc.v1 = v1;
+	scpu->cc.v2 = v2;
+}
+
+/**
+ * Get all conditional code flags at once
+ *
+ * @param cpu: cpu to get conditional codes from
+ * @return: Conditional codes (SCPU_ICC_* bits)
+ */
+static inline uint8_t scpu_get_icc(struct cpu *cpu)
+{
+	return scpu_cc_eval(to_sparc_cpu(cpu));
+}
+
+/**
+ * Get negative conditional code flag value
+ *
+ * @param cpu: cpu to get conditional code from
+ * @return: Value of conditional code flag
+ */
+static inline uint8_t scpu_get_cc_n(struct cpu *cpu)
+{
+	return !!(scpu_get_icc(cpu) & SCPU_ICC_N);
+}
+
+/**
+ * Set negative conditional code flag value
+ *
+ * @param cpu: cpu to set conditional code to
+ * @param val: Value of conditional code flag
+ */
+static inline void scpu_set_cc_n(struct cpu *cpu, uint8_t val)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu_cc_sync(scpu);
+	PSR_ICC_SET(&scpu->reg, N, val);
+}
+
+/**
+ * Get zero conditional code flag value
+ *
+ * @param cpu: cpu to get conditional code from
+ * @return: Value of conditional code flag
+ */
+static inline uint8_t scpu_get_cc_z(struct cpu *cpu)
+{
+	return !!(scpu_get_icc(cpu) & SCPU_ICC_Z);
+}
+
+/**
+ * Set zero conditional code flag value
+ *
+ * @param cpu: cpu to set conditional code to
+ * @param val: Value of conditional code flag
+ */
+static inline void scpu_set_cc_z(struct cpu *cpu, uint8_t val)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu_cc_sync(scpu);
+	PSR_ICC_SET(&scpu->reg, Z, val);
+}
+
+/**
+ * Get overflow conditional code flag value
+ *
+ * @param cpu: cpu to get conditional code from
+ * @return: Value of conditional code flag
+ */
+static inline uint8_t scpu_get_cc_v(struct cpu *cpu)
+{
+	return !!(scpu_get_icc(cpu) & SCPU_ICC_V);
+}
+
+/**
+ * Set overflow conditional code flag value
+ *
+ * @param cpu: cpu to set conditional code to
+ * @param val: Value of conditional code flag
+ */
+static inline void scpu_set_cc_v(struct cpu *cpu, uint8_t val)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu_cc_sync(scpu);
+	PSR_ICC_SET(&scpu->reg, V, val);
+}
+
+/**
+ * Get carry conditional code flag value
+ *
+ * @param cpu: cpu to get conditional code from
+ * @return: Value of conditional code flag
+ */
+static inline uint8_t scpu_get_cc_c(struct cpu *cpu)
+{
+	return !!(scpu_get_icc(cpu) & SCPU_ICC_C);
+}
+
+/**
+ * Set carry conditional code flag value
+ *
+ * @param cpu: cpu to set conditional code to
+ * @param val: Value of conditional code flag
+ */
+static inline void scpu_set_cc_c(struct cpu *cpu, uint8_t val)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu_cc_sync(scpu);
+	PSR_ICC_SET(&scpu->reg, C, val);
+}
+
+/**
+ * Get PC register value
+ *
+ * @param cpu: cpu to get PC register from
+ * @return: PC reg value
+ */
+static inline sreg scpu_get_pc(struct cpu *cpu)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	return scpu->reg.pc[0];
+}
+
+/**
+ * Get nPC register value
+ *
+ * @param cpu: cpu to get nPC register from
+ * @return: nPC reg value
+ */
+static inline sreg scpu_get_npc(struct cpu *cpu)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	return scpu->reg.pc[0];
+}
+
+/**
+ * Prepare a delay jump
+ *
+ * @param cpu: cpu that need to jump
+ * @return: delay jump address
+ */
+static inline void scpu_delay_jmp(struct cpu *cpu, uint32_t addr)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu->reg.pc[2] = addr;
+}
+
+/**
+ * Set the annul delay slot flag
+ *
+ * @param cpu: cpu that need to cancel its delay slot
+ */
+static inline void scpu_annul_delay_slot(struct cpu *cpu)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	scpu->annul = 1;
+}
+
+/*
+ * Data memory accesses, done directly through host memory when memory device
+ * allows it
+ */
+static inline int scpu_mem_read8(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint8_t *val)
+{
+	return hmem_read8(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_read16(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint16_t *val)
+{
+	return hmem_read16(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_read32(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint32_t *val)
+{
+	return hmem_read32(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_read64(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint64_t *val)
+{
+	return hmem_read64(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_write8(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint8_t val)
+{
+	return hmem_write8(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_write16(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint16_t val)
+{
+	return hmem_write16(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_write32(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint32_t val)
+{
+	return hmem_write32(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+static inline int scpu_mem_write64(struct cpu *cpu, struct dev *mem,
+		addr_t addr, uint64_t val)
+{
+	return hmem_write64(&to_sparc_cpu(cpu)->hmem, mem, addr, val);
+}
+
+#endif
@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <endian.h>
 
 #include "utils.h"
@@ -7,76 +9,12 @@
 #include "cpu/cpu.h"
 #include "sparc.h"
 #include "isn.h"
+#include "icache.h"
+#include "block.h"
+#include "jit.h"
 #include "trap.h"
-
-#define SPARC_NRWIN 32
-
-struct sparc_registers {
-	/* Special registers */
-	sreg psr;
-	sreg tbr;
-	sreg wim;
-	sreg y;
-	/* pc[0] is pc, pc[1] is npc and pc[2] is filled by branche isn */
-	sreg pc[3];
-
-	/*
-	 * general purpose registers (%g[1-7], %i[0-7], %o[0-7], %l[0-7])
-	 * (%g0 is a special always null register, thus do not need to be stored
-	 * in this array)
-	 */
-	sreg r[7 + (16 * SPARC_NRWIN + 16)];
-};
-
-#define PSR_ICC_OFF_N (23)
-#define PSR_ICC_OFF_Z (22)
-#define PSR_ICC_OFF_V (21)
-#define PSR_ICC_OFF_C (20)
-#define PSR_ICC_GET(sr, n) (((sr)->psr >> PSR_ICC_OFF_ ## n) & 0x1)
-#define PSR_ICC_SET(sr, n, v)						\
-	(((sr)->psr = ((sr)->psr & ~(1 << ((PSR_ICC_OFF_ ## n)))) |	\
-		(((v) & 0x1)  << (PSR_ICC_OFF_ ## n))))
-#define PSR_CWP(sr) ((sr)->psr & 0x1f)
-#define PSR_SET_CWP(sr, v) ((sr)->psr = ((sr)->psr & ~(0x1f)) | ((v) & 0x1f))
-#define PSR_ET(sr) (((sr)->psr >> 5) & 0x1)
-#define PSR_SET_ET(sr, v)						\
-	((sr)->psr = ((sr)->psr & ~(1 << 5)) | (((v) & 0x1) << 5))
-#define PSR_PS(sr) (((sr)->psr >> 6) & 0x1)
-#define PSR_SET_PS(sr, v)						\
-	((sr)->psr = ((sr)->psr & ~(1 << 6)) | (((v) & 0x1) << 6))
-#define PSR_S(sr) (((sr)->psr >> 7) & 0x1)
-#define PSR_SET_S(sr, v)						\
-	((sr)->psr = ((sr)->psr & ~(1 << 7)) | (((v) & 0x1) << 7))
-
-#define TBR_TT(sr) (((sr)->tbr >> 4) & 0xff)
-#define TBR_SET_TT(sr, v)						\
-	((sr)->tbr = ((sr)->tbr & ~(0xff0)) | (((v) & 0xff) << 4))
-
-#define _SREG_IDX(sr, idx) (((idx) < 8) ? (idx) :			\
-		(8 + (idx) + PSR_CWP(sr) * 16))
-#define SREG(sr) ((sr)->r[_SREG_IDX(sr, idx)])
-
-enum scpu_mode {
-	SM_ERR,
-	SM_EXC,
-};
-
-#define SPARC_ASSZ 256
-#define SPARC_PIPESZ 2
-struct sparc_cpu {
-	struct cpu cpu;
-	/* Sparc alternate spaces mapping */
-	struct dev *altspace[SPARC_ASSZ];
-	/* Cpu instruction pipeline */
-	union sparc_isn_fill pipeline[SPARC_PIPESZ];
-	struct sparc_registers reg;
-	struct trap_queue tq;
-	enum scpu_mode mode;
-	/* Annul next instruction flag */
-	uint8_t annul;
-};
-
-#define to_sparc_cpu(c) (container_of(c, struct sparc_cpu, cpu))
+#include "hmem.h"
+#include "scpu.h"
 
 /**
  * Change sparc cpu mode
@@ -105,43 +43,46 @@ static inline int scpu_is_error_mode(struct cpu *cpu)
 }
 
 /**
- * Get a generic register from its opcode index
+ * Point current window registers table to a new window
  *
- * @param cpu: cpu to fetch register from
- * @param ridx: register index
- * @return: Register value
+ * @param scpu: cpu to update window registers table of
  */
-sreg scpu_get_reg(struct cpu *cpu, sridx ridx)
+static inline void scpu_win_update(struct sparc_cpu *scpu)
 {
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	if(ridx == 0 || ridx >= 32)
-		return 0;
-
-	if(ridx < 8)
-		return scpu->reg.r[ridx - 1];
+	sreg *w = &scpu->r[PSR_CWP(&scpu->reg) * 16];
+	sridx i;
 
-	return scpu->reg.r[PSR_CWP(&scpu->reg) * 16 + ridx - 1];
+	for(i = 8; i < 32; ++i)
+		scpu->win[i] = &w[i - 1];
 }
 
 /**
- * Set a generic register from its opcode index
+ * Initialize current window registers table, %g0 is backed by a slot that is
+ * cleared after every register write
  *
- * @param cpu: cpu to fetch register from
- * @param ridx: register index
- * @param val: Value to set the register to
+ * @param scpu: cpu to initialize window registers table of
  */
-void scpu_set_reg(struct cpu *cpu, sridx ridx, sreg val)
+static inline void scpu_win_init(struct sparc_cpu *scpu)
 {
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	sridx i;
 
-	if(ridx == 0 || ridx >= 32)
-		return;
+	scpu->g0 = 0;
+	scpu->win[0] = &scpu->g0;
+	for(i = 1; i < 8; ++i)
+		scpu->win[i] = &scpu->r[i - 1];
+	scpu_win_update(scpu);
+}
 
-	if(ridx < 8)
-		scpu->reg.r[ridx - 1] = val;
-	else
-		scpu->reg.r[PSR_CWP(&scpu->reg) * 16 + ridx - 1] = val;
+/**
+ * Change current window
+ *
+ * @param scpu: cpu to change current window of
+ * @param cwp: New current window pointer
+ */
+static inline void scpu_set_cwp(struct sparc_cpu *scpu, uint8_t cwp)
+{
+	PSR_SET_CWP(&scpu->reg, cwp);
+	scpu_win_update(scpu);
 }
 
 /**
@@ -174,6 +115,7 @@ int scpu_register_mem(struct cpu * cpu, asi_t id, struct dev *dev)
 		return -EEXIST;
 
 	scpu->altspace[id] = dev;
+	hmem_flush(&scpu->hmem);
 	return 0;
 }
 
@@ -193,6 +135,7 @@ int scpu_remove_mem(struct cpu * cpu, asi_t id)
 		return -EINVAL;
 
 	scpu->altspace[id] = NULL;
+	hmem_flush(&scpu->hmem);
 	return 0;
 }
 
@@ -293,6 +236,7 @@ int scpu_get_psr(struct cpu *cpu, sreg *val)
 		return -1;
 	}
 
+	scpu_cc_sync(scpu);
 	/* EC and EF should be masked out */
 	*val = (scpu->reg.psr & ~(0x3 << 12));
 	return 0;
@@ -332,6 +276,8 @@ int scpu_set_psr(struct cpu *cpu, sreg val)
 	/* TODO hardwire version field ? */
 	val &= ~((0xf << 28) | (0x3 << 12));
 	scpu->reg.psr = val;
+	scpu->cc.op = CC_OP_FLAGS;
+	scpu_win_update(scpu);
 	return 0;
 }
 
@@ -480,166 +426,53 @@ int scpu_set_asr(struct cpu *cpu, uint8_t asr, sreg v1, sreg v2)
  * @return: 0 on success, -1 otherwise
  */
 int scpu_flush(struct cpu *cpu, addr_t addr)
-{
-	(void)cpu;
-	(void)addr;
-	/* With no CPU and a pipiline 1 instruction wide, flush is nop */
-	return 0;
-}
-
-/**
- * Get negative conditional code flag value
- *
- * @param cpu: cpu to get conditional code from
- * @return: Value of conditional code flag
- */
-uint8_t scpu_get_cc_n(struct cpu *cpu)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	return PSR_ICC_GET(&scpu->reg, N);
-}
-
-/**
- * Set negative conditional code flag value
- *
- * @param cpu: cpu to set conditional code to
- * @param val: Value of conditional code flag
- */
-void scpu_set_cc_n(struct cpu *cpu, uint8_t val)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	PSR_ICC_SET(&scpu->reg, N, val);
-}
-
-/**
- * Get zero conditional code flag value
- *
- * @param cpu: cpu to get conditional code from
- * @return: Value of conditional code flag
- */
-uint8_t scpu_get_cc_z(struct cpu *cpu)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	return PSR_ICC_GET(&scpu->reg, Z);
-}
-
-/**
- * Set zero conditional code flag value
- *
- * @param cpu: cpu to set conditional code to
- * @param val: Value of conditional code flag
- */
-void scpu_set_cc_z(struct cpu *cpu, uint8_t val)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	PSR_ICC_SET(&scpu->reg, Z, val);
-}
-
-/**
- * Get overflow conditional code flag value
- *
- * @param cpu: cpu to get conditional code from
- * @return: Value of conditional code flag
- */
-uint8_t scpu_get_cc_v(struct cpu *cpu)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	return PSR_ICC_GET(&scpu->reg, V);
-}
-
-/**
- * Set overflow conditional code flag value
- *
- * @param cpu: cpu to set conditional code to
- * @param val: Value of conditional code flag
- */
-void scpu_set_cc_v(struct cpu *cpu, uint8_t val)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	PSR_ICC_SET(&scpu->reg, V, val);
-}
-
-/**
- * Get carry conditional code flag value
- *
- * @param cpu: cpu to get conditional code from
- * @return: Value of conditional code flag
- */
-uint8_t scpu_get_cc_c(struct cpu *cpu)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 
-	return PSR_ICC_GET(&scpu->reg, C);
-}
-
-/**
- * Set carry conditional code flag value
- *
- * @param cpu: cpu to set conditional code to
- * @param val: Value of conditional code flag
- */
-void scpu_set_cc_c(struct cpu *cpu, uint8_t val)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	PSR_ICC_SET(&scpu->reg, C, val);
-}
-
-/**
- * Get PC register value
- *
- * @param cpu: cpu to get PC register from
- * @return: PC reg value
- */
-sreg scpu_get_pc(struct cpu *cpu)
-{
-	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-
-	return scpu->reg.pc[0];
+	/* Flush operates on the doubleword containing addr */
+	icache_inval(&scpu->icache, addr & ~0x7, 8);
+	return 0;
 }
 
 /**
- * Get nPC register value
+ * Invalidate all predecoded instructions. This has to be called when
+ * instruction virtual to physical mapping changes.
  *
- * @param cpu: cpu to get nPC register from
- * @return: nPC reg value
+ * @param cpu: cpu to flush instruction cache from
  */
-sreg scpu_get_npc(struct cpu *cpu)
+void scpu_flush_isn_cache(struct cpu *cpu)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 
-	return scpu->reg.pc[0];
+	icache_flush(&scpu->icache);
 }
 
 /**
- * Prepare a delay jump
+ * Drop all cached host memory pointers. This has to be called when data
+ * virtual to physical mapping changes.
  *
- * @param cpu: cpu that need to jump
- * @return: delay jump address
+ * @param cpu: cpu to flush host memory cache from
  */
-void scpu_delay_jmp(struct cpu *cpu, uint32_t addr)
+void scpu_flush_hostmem(struct cpu *cpu)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 
-	scpu->reg.pc[2] = addr;
+	hmem_flush(&scpu->hmem);
 }
 
 /**
- * Set the annul delay slot flag
+ * Notify cpu that memory has been written, so that any predecoded
+ * instruction from this range can be dropped.
  *
- * @param cpu: cpu that need to cancel its delay slot
+ * @param cpu: cpu that wrote memory
+ * @param addr: Virtual address written
+ * @param sz: Size of write in bytes
  */
-void scpu_annul_delay_slot(struct cpu *cpu)
+void scpu_store_notify(struct cpu *cpu, addr_t addr, size_t sz)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 
-	scpu->annul = 1;
+	icache_inval(&scpu->icache, addr, sz);
 }
 
 /**
@@ -661,7 +494,7 @@ static inline int _scpu_window_save(struct cpu *cpu, int check)
 		return -1;
 	}
 
-	PSR_SET_CWP(&scpu->reg, cwp);
+	scpu_set_cwp(scpu, cwp);
 	return 0;
 }
 
@@ -696,7 +529,7 @@ static inline int _scpu_window_restore(struct cpu *cpu, int check)
 		return -1;
 	}
 
-	PSR_SET_CWP(&scpu->reg, cwp);
+	scpu_set_cwp(scpu, cwp);
 	return 0;
 }
 
@@ -764,13 +597,12 @@ void scpu_exit_trap(struct cpu *cpu, uint32_t jmp)
 }
 
 /**
- * Fetch next pipelined instruction
+ * Fetch next pipelined instruction, through predecoded instruction cache
  */
 static int scpu_fetch(struct cpu *cpu)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 	struct dev *mem;
-	uint32_t rd;
 	int ret = 0;
 
 	if(scpu_is_error_mode(cpu))
@@ -780,19 +612,14 @@ static int scpu_fetch(struct cpu *cpu)
 	if(mem == NULL)
 		goto exit;
 
-	sreg npc = scpu->reg.pc[1];
-	ret = dev_read32(mem, npc, &rd);
-	if(ret != 0)
-		goto exit;
-
-	scpu->pipeline[1].isn.op = (opcode)be32toh(rd);
-
+	ret = icache_fetch(&scpu->icache, mem, scpu->reg.pc[1],
+			&scpu->pipeline[1]);
 exit:
 	return ret;
 }
 
 /**
- * Decode current pipelined instruction
+ * Decode current pipelined instruction, if it has not been predecoded
  */
 static int scpu_decode(struct cpu *cpu)
 {
@@ -801,6 +628,9 @@ static int scpu_decode(struct cpu *cpu)
 	if(scpu_is_error_mode(cpu))
 		return -1;
 
+	if(scpu->pipeline[0].isn.fmt != SIF_UNKNOW)
+		return 0;
+
 	return isn_decode(&scpu->pipeline[0].isn);
 }
 
@@ -811,7 +641,6 @@ static int scpu_boot(struct cpu *cpu, addr_t addr)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 	struct dev *mem;
-	uint32_t rd;
 	int ret = 0;
 
 	/* Initialize PC registers */
@@ -829,12 +658,11 @@ static int scpu_boot(struct cpu *cpu, addr_t addr)
 		goto exit;
 
 	/* Prefetch the first instruction */
-	ret = dev_read32(mem, scpu->reg.pc[0], &rd);
+	ret = icache_fetch(&scpu->icache, mem, scpu->reg.pc[0],
+			&scpu->pipeline[0]);
 	if(ret != 0)
 		goto exit;
 
-	scpu->pipeline[0].isn.op = (opcode)be32toh(rd);
-
 	scpu_set_mode(cpu, SM_EXC);
 exit:
 	return ret;
@@ -842,15 +670,19 @@ exit:
 
 /**
  * Actually handle a trap
+ *
+ * @return: 1 if trap has been taken, 0 if it has been ignored, negative number
+ * on error
  */
 static inline int _scpu_enter_trap(struct cpu *cpu, uint8_t tn)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	int ret;
 
 	/* Reset CPU on reset trap */
 	if(tn == 0) {
 		scpu_boot(cpu, 0);
-		return 0;
+		return 1;
 	}
 
 	if(!PSR_ET(&scpu->reg) && !TRAP_IS_INT(tn)) {
@@ -874,20 +706,54 @@ static inline int _scpu_enter_trap(struct cpu *cpu, uint8_t tn)
 	/* Finally, prepare to jump into trap vector */
 	scpu->reg.pc[1] = scpu->reg.tbr;
 	scpu->reg.pc[2] = scpu->reg.tbr + 4;
-	return scpu_fetch(cpu);
+	ret = scpu_fetch(cpu);
+	if(ret < 0)
+		return ret;
+
+	return 1;
 }
 
 /**
- * Execute current pipelined instruction
+ * Handle any pending trap then move the pipeline to the next instruction
+ *
+ * @param cpu: cpu to move forward
+ * @param tn: Filled with the taken trap number if any
+ * @return: 1 if a trap has been taken, 0 if not, negative number on error
  */
-static int scpu_exec(struct cpu *cpu)
+static inline int _scpu_next(struct cpu *cpu, uint8_t *tn)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
-	int ret;
-	uint8_t tn;
+	int trap = 0;
 
-	if(scpu_is_error_mode(cpu))
-		return -1;
+	/* Handle any pending trap */
+	if(tq_pending(&scpu->tq, tn)) {
+		trap = _scpu_enter_trap(cpu, *tn);
+		if(trap < 0)
+			return trap;
+		tq_ack(&scpu->tq, *tn);
+	}
+
+	/* Move the pipeline to the next instruction */
+	scpu->pipeline[0] = scpu->pipeline[1];
+	/* Set next instruction PC registers values */
+	scpu->reg.pc[0] = scpu->reg.pc[1];
+	scpu->reg.pc[1] = scpu->reg.pc[2];
+	scpu->reg.pc[2] += 4;
+
+	return trap;
+}
+
+/**
+ * Execute current pipelined instruction and move the pipeline forward
+ *
+ * @param cpu: cpu to execute instruction on
+ * @param tn: Filled with the taken trap number if any
+ * @return: 1 if a trap has been taken, 0 if not, negative number on error
+ */
+static inline int _scpu_exec(struct cpu *cpu, uint8_t *tn)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	int ret;
 
 	ret = isn_exec(cpu, &scpu->pipeline[0].isn);
 	if(ret < 0)
@@ -903,24 +769,579 @@ static int scpu_exec(struct cpu *cpu)
 		scpu->annul = 0;
 	}
 
-	/* Handle any pending trap */
-	if(tq_pending(&scpu->tq, &tn)) {
-		ret = _scpu_enter_trap(cpu, tn);
+	return _scpu_next(cpu, tn);
+}
+
+/**
+ * Execute current pipelined instruction
+ */
+static int scpu_exec(struct cpu *cpu)
+{
+	int ret;
+	uint8_t tn;
+
+	if(scpu_is_error_mode(cpu))
+		return -1;
+
+	ret = _scpu_exec(cpu, &tn);
+	if(ret < 0)
+		return ret;
+
+	return 0;
+}
+
+/**
+ * Check if a PC breakpoint is set on an address
+ */
+static inline int scpu_is_break(struct sparc_cpu *scpu, addr_t addr)
+{
+	uint8_t i;
+
+	for(i = 0; i < scpu->nrbrk; ++i)
+		if(scpu->brk[i] == addr)
+			return 1;
+
+	return 0;
+}
+
+/**
+ * Check if cpu run has to stop when a trap is taken
+ */
+static inline int scpu_is_catch(struct sparc_cpu *scpu, uint8_t tn)
+{
+	return (scpu->tcatch[tn / 32] >> (tn % 32)) & 0x1;
+}
+
+/**
+ * Set PC registers for executing instruction at pc followed by npc
+ */
+static inline void scpu_set_pcs(struct sparc_cpu *scpu, addr_t pc, addr_t npc)
+{
+	scpu->reg.pc[0] = pc;
+	scpu->reg.pc[1] = npc;
+	scpu->reg.pc[2] = npc + 4;
+}
+
+/**
+ * Get instruction memory device without raising trap if there is none
+ */
+static inline struct dev *scpu_block_imem(struct sparc_cpu *scpu)
+{
+	if(PSR_S(&scpu->reg))
+		return scpu->altspace[SPARC_AS_SISN];
+
+	return scpu->altspace[SPARC_AS_UISN];
+}
+
+/**
+ * Execute a block instruction at pc followed by npc. PC registers are only
+ * set for instructions that use them or that can trap.
+ *
+ * @return: 1 if instruction raised a trap, 0 otherwise, negative number on
+ * error
+ */
+static inline int scpu_exec_block_isn(struct cpu *cpu,
+		struct sparc_isn const *isn, addr_t pc, addr_t npc)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	int ret;
+	uint8_t tn;
+
+	if(SX_IS_PURE(isn->xop))
+		return isn_exec(cpu, isn);
+
+	scpu_set_pcs(scpu, pc, npc);
+	ret = isn_exec(cpu, isn);
+	if(ret < 0)
+		return ret;
+
+	return tq_pending(&scpu->tq, &tn);
+}
+
+/**
+ * Execute a fused block instruction pair
+ *
+ * @param pc: First instruction address
+ * @return: 1 if second instruction raised a trap (PC registers are then set
+ * for it), 0 otherwise, negative number on error
+ */
+static inline int scpu_exec_block_pair(struct cpu *cpu,
+		struct sparc_isn const *isn, addr_t pc)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	union sparc_isn_fill const *f;
+	int ret;
+	uint8_t tn;
+
+	f = container_of(isn, union sparc_isn_fill const, isn);
+	++scpu->nrfused;
+	if(SF_IS_PURE(isn->fuse))
+		return isn_exec_fused(cpu, isn, &f[1].isn);
+
+	/* First instruction of a pair cannot trap */
+	scpu_set_pcs(scpu, pc + 4, pc + 8);
+	ret = isn_exec_fused(cpu, isn, &f[1].isn);
+	if(ret < 0)
+		return ret;
+
+	return tq_pending(&scpu->tq, &tn);
+}
+
+/**
+ * Execute a translated block
+ *
+ * @param cpu: cpu to execute block on
+ * @param b: Block to execute
+ * @param nrisn: Incremented by the number of executed instructions
+ * @param next: Filled with next instruction address
+ * @return: 1 if an instruction raised a trap (PC registers are then set for
+ * this instruction), 0 otherwise, negative number on error
+ */
+static inline int scpu_exec_block(struct cpu *cpu, struct block *b,
+		size_t *nrisn, addr_t *next)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	struct sparc_isn const *isn;
+	addr_t pc = b->pc, npc;
+	uint8_t i, nr = b->nr;
+	int ret;
+
+	if(b->end == BE_DCTI)
+		nr -= 2;
+
+	for(i = 0; i < nr; ++i, pc += sizeof(opcode)) {
+		isn = &b->isn[i].isn;
+		if(isn->fuse == SF_NONE) {
+			ret = scpu_exec_block_isn(cpu, isn, pc, pc + 4);
+			++(*nrisn);
+		} else if(i + 1 < nr) {
+			ret = scpu_exec_block_pair(cpu, isn, pc);
+			*nrisn += 2;
+			++i;
+			pc += sizeof(opcode);
+		} else {
+			/* Fused with the ending delayed control transfer */
+			break;
+		}
+
 		if(ret != 0)
 			return ret;
-		tq_ack(&scpu->tq, tn);
+
+		/* A store could have modified following block instructions */
+		if(b->page->gen != b->gen) {
+			*next = pc + 4;
+			return 0;
+		}
 	}
 
-	/* Move the pipeline to the next instruction */
-	scpu->pipeline[0].isn.op = scpu->pipeline[1].isn.op;
-	/* Set next instruction PC registers values */
-	scpu->reg.pc[0] = scpu->reg.pc[1];
-	scpu->reg.pc[1] = scpu->reg.pc[2];
-	scpu->reg.pc[2] += 4;
+	*next = pc;
+	if(b->end != BE_DCTI)
+		return 0;
+
+	/* Delayed control transfer instruction, not taken jumps to pc + 8 */
+	if(i < nr) {
+		ret = scpu_exec_block_pair(cpu, isn, pc);
+		*nrisn += 2;
+		pc += sizeof(opcode);
+		*next = pc;
+	} else {
+		ret = scpu_exec_block_isn(cpu, &b->isn[nr].isn, pc, pc + 4);
+		++(*nrisn);
+	}
+	if(ret != 0)
+		return ret;
+
+	npc = scpu->reg.pc[2];
+	*next = npc;
+	if(scpu->annul) {
+		scpu->annul = 0;
+		return 0;
+	}
+
+	/* Delay slot */
+	ret = scpu_exec_block_isn(cpu, &b->isn[nr + 1].isn, pc + 4, npc);
+	++(*nrisn);
+	return ret;
+}
+
+#ifdef SPARC_JIT
+
+/**
+ * Execute a block instruction on behalf of native code
+ *
+ * @return: 1 if instruction raised a trap, 0 otherwise, negative number on
+ * error
+ */
+int scpu_jit_isn(struct cpu *cpu, struct sparc_isn const *isn, addr_t pc,
+		addr_t npc)
+{
+	int ret;
+
+	ret = scpu_exec_block_isn(cpu, isn, pc, npc);
+	/* Native code updates condition codes in PSR directly */
+	scpu_cc_sync(to_sparc_cpu(cpu));
+	return ret;
+}
+
+/**
+ * Execute a block delayed control transfer instruction on behalf of native
+ * code
+ *
+ * @param npc: Filled with delay slot next instruction address
+ * @return: 2 if delay slot is annulled, 1 if instruction raised a trap, 0
+ * otherwise, negative number on error
+ */
+int scpu_jit_dcti(struct cpu *cpu, struct sparc_isn const *isn, addr_t pc,
+		addr_t *npc)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	int ret;
+
+	ret = scpu_exec_block_isn(cpu, isn, pc, pc + sizeof(opcode));
+	scpu_cc_sync(scpu);
+	if(ret != 0)
+		return ret;
+
+	*npc = scpu->reg.pc[2];
+	if(scpu->annul) {
+		scpu->annul = 0;
+		return 2;
+	}
+
+	return 0;
+}
+
+/**
+ * Get block native code, compiling it if block is hot enough
+ *
+ * @return: Native code, NULL if block has to be interpreted
+ */
+static inline jit_fn scpu_jit_get(struct sparc_cpu *scpu, struct block *b)
+{
+	if((b->jit != NULL) && (b->jitgen == scpu->jit.gen))
+		return b->jit;
+
+	if(++b->hot < JIT_THRESHOLD)
+		return NULL;
+
+	b->hot = 0;
+	if(jit_compile(&scpu->jit, b) != 0)
+		return NULL;
+
+	return b->jit;
+}
+
+#endif /* SPARC_JIT */
+
+/**
+ * Execute a translated block, natively if it has been compiled
+ */
+static inline int scpu_run_block(struct cpu *cpu, struct block *b,
+		size_t *nrisn, addr_t *next)
+{
+#ifdef SPARC_JIT
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	jit_fn fn = scpu_jit_get(scpu, b);
+
+	if(fn != NULL) {
+		scpu_cc_sync(scpu);
+		return fn(cpu, nrisn, next);
+	}
+#endif
+	return scpu_exec_block(cpu, b, nrisn, next);
+}
+
+/**
+ * Execute translated blocks, jumping from one block to its chained
+ * successor, as long as budget allows it and nothing requires single
+ * stepping. PC registers are set when leaving.
+ *
+ * @param cpu: cpu to run
+ * @param budget: Maximum number of instructions to execute
+ * @param nrisn: Incremented by the number of executed instructions
+ * @param tn: Filled with the taken trap number if any
+ * @return: 1 if a trap has been taken, 0 if not, negative number on error
+ */
+static int scpu_run_blocks(struct cpu *cpu, size_t budget, size_t *nrisn,
+		uint8_t *tn)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	struct block *b, *s;
+	struct dev *mem;
+	addr_t pc = scpu->reg.pc[0];
+	int ret;
+	uint8_t idx;
+
+	mem = scpu_block_imem(scpu);
+	if(mem == NULL)
+		return 0;
+
+	b = bcache_get(&scpu->bcache, &scpu->icache, mem, pc);
+	while((b != NULL) && (b->nr <= budget - *nrisn) && !cpu->stopreq &&
+			!tq_pending(&scpu->tq, tn)) {
+		ret = scpu_run_block(cpu, b, nrisn, &pc);
+		if(ret < 0)
+			return ret;
+
+		/* Trapping instruction PC registers are set, enter trap */
+		if(ret != 0)
+			return _scpu_next(cpu, tn);
+
+		/* Follow chained successor, linking it if needed */
+		mem = scpu_block_imem(scpu);
+		if(mem == NULL)
+			break;
+
+		idx = (pc == b->pc + b->nr * sizeof(opcode)) ? 1 : 0;
+		s = b->succ[idx];
+		if((s == NULL) || !block_valid(s, mem, pc)) {
+			s = bcache_get(&scpu->bcache, &scpu->icache, mem, pc);
+			b->succ[idx] = s;
+		}
+		b = s;
+	}
+
+	scpu_set_pcs(scpu, pc, pc + 4);
+	return 0;
+}
+
+/**
+ * Can cpu execute translated blocks, i.e. cpu is not in a delay slot and no
+ * breakpoint has to be checked
+ */
+static inline int scpu_can_run_blocks(struct sparc_cpu *scpu)
+{
+	return (scpu->nrbrk == 0) && !scpu->annul &&
+		(scpu->reg.pc[1] == scpu->reg.pc[0] + 4);
+}
+
+/**
+ * Refill the pipeline with instruction at PC after blocks execution
+ */
+static int scpu_refill(struct cpu *cpu)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	struct dev *mem;
+
+	mem = scpu_get_imem(cpu);
+	if(mem == NULL) {
+		/* Execute a nop so that the raised trap gets handled */
+		scpu->pipeline[0].isn.op = 0x01000000;
+		scpu->pipeline[0].isn.fmt = SIF_UNKNOW;
+		return 0;
+	}
+
+	return icache_fetch(&scpu->icache, mem, scpu->reg.pc[0],
+			&scpu->pipeline[0]);
+}
 
+/**
+ * Run cpu for at most budget instructions. A breakpoint set on the
+ * instruction the run starts from is ignored so that a stopped run can be
+ * resumed. Translated blocks are used when possible, otherwise instructions
+ * go through the pipeline one at a time.
+ */
+static int scpu_run(struct cpu *cpu, size_t budget, struct cpu_run *res)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	size_t n = 0, k;
+	int ret = 0, stale = 0;
+	uint8_t tn;
+
+	res->stop = CS_BUDGET;
+	while(n < budget) {
+		if(scpu_is_error_mode(cpu)) {
+			res->stop = CS_ERROR;
+			break;
+		}
+
+		if(cpu->stopreq) {
+			cpu->stopreq = 0;
+			res->stop = CS_DEVREQ;
+			break;
+		}
+
+		if((n != 0) && (scpu->nrbrk != 0) &&
+				scpu_is_break(scpu, scpu->reg.pc[0])) {
+			res->stop = CS_BREAK;
+			break;
+		}
+
+		if(scpu_can_run_blocks(scpu)) {
+			k = n;
+			ret = scpu_run_blocks(cpu, budget, &n, &tn);
+			if(ret < 0)
+				break;
+
+			if(n != k) {
+				stale = 1;
+				if((ret != 0) && scpu_is_catch(scpu, tn)) {
+					res->stop = CS_TRAP;
+					break;
+				}
+				continue;
+			}
+		}
+
+		if(stale) {
+			ret = scpu_refill(cpu);
+			if(ret < 0)
+				break;
+			stale = 0;
+		}
+
+		ret = scpu_fetch(cpu);
+		if(ret < 0)
+			break;
+
+		ret = scpu_decode(cpu);
+		if(ret < 0)
+			break;
+
+		ret = _scpu_exec(cpu, &tn);
+		if(ret < 0)
+			break;
+
+		++n;
+		if((ret != 0) && scpu_is_catch(scpu, tn)) {
+			res->stop = CS_TRAP;
+			break;
+		}
+	}
+
+	if((ret >= 0) && stale)
+		ret = scpu_refill(cpu);
+
+	res->nrisn = n;
+	return (ret < 0) ? ret : 0;
+}
+
+/**
+ * Set a PC breakpoint, cpu run stops before executing the instruction at
+ * this address
+ *
+ * @param cpu: cpu to set breakpoint on
+ * @param addr: Breakpoint address
+ * @return: 0 on success, negative number otherwise
+ */
+int scpu_set_break(struct cpu *cpu, addr_t addr)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	if(scpu_is_break(scpu, addr))
+		return -EEXIST;
+
+	if(scpu->nrbrk == ARRAY_SIZE(scpu->brk))
+		return -ENOSPC;
+
+	scpu->brk[scpu->nrbrk++] = addr;
 	return 0;
 }
 
+/**
+ * Remove a PC breakpoint
+ *
+ * @param cpu: cpu to remove breakpoint from
+ * @param addr: Breakpoint address
+ * @return: 0 on success, negative number otherwise
+ */
+int scpu_clear_break(struct cpu *cpu, addr_t addr)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	uint8_t i;
+
+	for(i = 0; i < scpu->nrbrk; ++i) {
+		if(scpu->brk[i] == addr) {
+			scpu->brk[i] = scpu->brk[--scpu->nrbrk];
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * Select if cpu run has to stop right after a specific trap has been taken
+ *
+ * @param cpu: cpu to configure
+ * @param tn: Trap number
+ * @param catch: 1 to stop on this trap, 0 otherwise
+ */
+void scpu_catch_trap(struct cpu *cpu, uint8_t tn, int catch)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	if(catch)
+		scpu->tcatch[tn / 32] |= (1U << (tn % 32));
+	else
+		scpu->tcatch[tn / 32] &= ~(1U << (tn % 32));
+}
+
+/**
+ * Get the number of instruction dispatches saved by fused instruction pairs
+ *
+ * @param cpu: cpu to get statistic from
+ * @return: Number of fused pairs executed since cpu creation
+ */
+uint64_t scpu_get_fused(struct cpu *cpu)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	return scpu->nrfused;
+}
+
+/* Cpu state saved in snapshots, from registers up to the caches */
+#define SCPU_SNAP_OFF offsetof(struct sparc_cpu, reg)
+#define SCPU_SNAP_SZ (offsetof(struct sparc_cpu, hmem) - SCPU_SNAP_OFF)
+
+/**
+ * Save sparc cpu execution state (registers, pending traps, pipeline and
+ * mode). Caches are not saved, they are flushed on restore.
+ */
+static int scpu_snapshot(struct cpu *cpu, void **snap)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+
+	*snap = malloc(SCPU_SNAP_SZ);
+	if(*snap == NULL)
+		return -ENOMEM;
+
+	memcpy(*snap, (uint8_t *)scpu + SCPU_SNAP_OFF, SCPU_SNAP_SZ);
+
+	return 0;
+}
+
+/**
+ * Restore sparc cpu execution state. Memory may have been restored too, so
+ * every predecoded instruction and host memory pointer is dropped.
+ * Breakpoints and statistics are left untouched.
+ */
+static int scpu_restore(struct cpu *cpu, void const *snap)
+{
+	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
+	uint64_t nrfused = scpu->nrfused;
+	uint8_t nrbrk = scpu->nrbrk;
+
+	memcpy((uint8_t *)scpu + SCPU_SNAP_OFF, snap, SCPU_SNAP_SZ);
+	scpu->nrfused = nrfused;
+	scpu->nrbrk = nrbrk;
+
+	hmem_flush(&scpu->hmem);
+	icache_flush(&scpu->icache);
+
+	return 0;
+}
+
+/**
+ * Free a sparc cpu snapshot
+ */
+static void scpu_snapshot_free(struct cpu *cpu, void *snap)
+{
+	(void)cpu;
+
+	free(snap);
+}
+
 /**
  * Create a sparc cpu instance
  */
@@ -929,9 +1350,22 @@ static struct cpu *scpu_create(struct cpucfg const *cfg)
 	struct sparc_cpu *scpu;
 	(void)cfg; /* TODO manage sparc families */
 
-	scpu = calloc(1, sizeof(*scpu));
+	/* Hot execution state layout relies on cache line alignment */
+	scpu = aligned_alloc(SPARC_CACHELINE, sizeof(*scpu));
 	if(scpu == NULL)
 		return NULL;
+	memset(scpu, 0, sizeof(*scpu));
+
+	scpu_win_init(scpu);
+	hmem_flush(&scpu->hmem);
+	icache_init(&scpu->icache);
+	if(bcache_init(&scpu->bcache) != 0) {
+		free(scpu);
+		return NULL;
+	}
+#ifdef SPARC_JIT
+	jit_init(&scpu->jit, &scpu->reg.psr, scpu->r);
+#endif
 
 	return &scpu->cpu;
 }
@@ -943,6 +1377,11 @@ static void scpu_destroy(struct cpu *cpu)
 {
 	struct sparc_cpu *scpu = to_sparc_cpu(cpu);
 
+#ifdef SPARC_JIT
+	jit_cleanup(&scpu->jit);
+#endif
+	bcache_cleanup(&scpu->bcache);
+	icache_cleanup(&scpu->icache);
 	free(scpu);
 }
 
@@ -953,6 +1392,10 @@ static struct cpu_ops const spops = {
 	.fetch = scpu_fetch,
 	.decode = scpu_decode,
 	.exec = scpu_exec,
+	.run = scpu_run,
+	.snapshot = scpu_snapshot,
+	.restore = scpu_restore,
+	.snapshot_free = scpu_snapshot_free,
 };
 
 static struct cpu_desc const scpu = {
@@ -8,20 +8,31 @@
 typedef uint32_t sreg;
 typedef uint8_t sridx;
 
-sreg scpu_get_reg(struct cpu *cpu, sridx ridx);
-void scpu_set_reg(struct cpu *cpu, sridx ridx, sreg val);
+/**
+ * Last condition codes setting operation, flags are only computed from it
+ * when they are actually needed
+ */
+enum scpu_ccop {
+	/* Condition codes are up to date in PSR */
+	CC_OP_FLAGS,
+	/* N and Z from result, V and C unchanged */
+	CC_OP_LOGIC,
+	/* Flags of v1 + v2 */
+	CC_OP_ADD,
+	/* Flags of v1 - v2 */
+	CC_OP_SUB,
+	/* N and Z from result, V and C cleared */
+	CC_OP_MUL,
+	/* N and Z from result, V is v1, C cleared */
+	CC_OP_DIV,
+};
 
-uint8_t scpu_get_cc_n(struct cpu *cpu);
-void scpu_set_cc_n(struct cpu *cpu, uint8_t val);
-uint8_t scpu_get_cc_z(struct cpu *cpu);
-void scpu_set_cc_z(struct cpu *cpu, uint8_t val);
-uint8_t scpu_get_cc_v(struct cpu *cpu);
-void scpu_set_cc_v(struct cpu *cpu, uint8_t val);
-uint8_t scpu_get_cc_c(struct cpu *cpu);
-void scpu_set_cc_c(struct cpu *cpu, uint8_t val);
+/* Condition codes bits as returned by scpu_get_icc() */
+#define SCPU_ICC_N (1 << 3)
+#define SCPU_ICC_Z (1 << 2)
+#define SCPU_ICC_V (1 << 1)
+#define SCPU_ICC_C (1 << 0)
 
-sreg scpu_get_pc(struct cpu *cpu);
-sreg scpu_get_npc(struct cpu *cpu);
 struct dev *scpu_get_mem(struct cpu *cpu, asi_t id);
 struct dev *scpu_get_dmem(struct cpu *cpu);
 struct dev *scpu_get_imem(struct cpu *cpu);
@@ -34,9 +45,8 @@ int scpu_set_tbr(struct cpu *cpu, sreg val);
 int scpu_get_asr(struct cpu *cpu, uint8_t asr, sreg *val);
 int scpu_set_asr(struct cpu *cpu, uint8_t asr, sreg v1, sreg v2);
 int scpu_flush(struct cpu *cpu, addr_t addr);
+void scpu_store_notify(struct cpu *cpu, addr_t addr, size_t sz);
 
-void scpu_delay_jmp(struct cpu *cpu, uint32_t addr);
-void scpu_annul_delay_slot(struct cpu *cpu);
 void scpu_window_save(struct cpu *cpu);
 void scpu_window_restore(struct cpu *cpu);
 void scpu_trap(struct cpu *cpu, uint8_t tn);
@@ -45,7 +45,7 @@ static inline uint8_t _prio_to_tn(uint8_t prio)
 	else if(prio <= SP_TISN(0x7f))
 		ret = ST_TISN(prio - SP_TISN(0));
 	else if(prio <= SP_TINT(0))
-		ret = ST_TINT(prio - SP_TINT(15));
+		ret = ST_TINT(SP_TINT(0) - prio);
 
 	return ret;
 }
@@ -93,7 +93,8 @@ static inline uint8_t _tn_to_prio(uint8_t tn)
 }
 
 /**
- * Add outstanding trap in trap queue
+ * Add outstanding trap in trap queue, this is safe to be called from any
+ * thread
  *
  * @param tq: The trap queue
  * @param tn: The trap number
@@ -102,7 +103,9 @@ void tq_raise(struct trap_queue *tq, uint8_t tn)
 {
 	uint8_t idx = _tn_to_prio(tn);
 
-	tq->tflag[idx >> 3] |= 1 << (idx % 8);
+	__atomic_fetch_or(&tq->tflag[idx / 64], 1ULL << (idx % 64),
+			__ATOMIC_RELEASE);
+	__atomic_fetch_or(&tq->summary, 1ULL << (idx / 64), __ATOMIC_RELEASE);
 }
 
 /**
@@ -114,31 +117,43 @@ void tq_raise(struct trap_queue *tq, uint8_t tn)
 void tq_ack(struct trap_queue *tq, uint8_t tn)
 {
 	uint8_t idx = _tn_to_prio(tn);
+	uint64_t w = 1ULL << (idx / 64);
 
-	tq->tflag[idx >> 3] &= ~(1 << (idx % 8));
+	if(__atomic_and_fetch(&tq->tflag[idx / 64], ~(1ULL << (idx % 64)),
+				__ATOMIC_ACQ_REL) != 0)
+		return;
+
+	/* A trap could have been raised in the word before summary update */
+	__atomic_fetch_and(&tq->summary, ~w, __ATOMIC_ACQ_REL);
+	if(__atomic_load_n(&tq->tflag[idx / 64], __ATOMIC_ACQUIRE) != 0)
+		__atomic_fetch_or(&tq->summary, w, __ATOMIC_RELEASE);
 }
 
 /**
- * Yeld the prending trap with highest priority
+ * Find the pending trap with highest priority, tq_pending() should be used
+ * instead as it first checks if anything is pending
  *
  * @param tq: The trap queue
  * @param tn: Set to the highest priority pending trap number
  *
  * @return: 0 if no trap are pending, 1 otherwise
  */
-int tq_pending(struct trap_queue *tq, uint8_t *tn)
+int tq_highest(struct trap_queue *tq, uint8_t *tn)
 {
-	size_t i;
-	int ret = 0, idx;
-
-	for(i = 0; i < ARRAY_SIZE(tq->tflag); ++i) {
-		idx = ffs(tq->tflag[i]);
-		if(!idx)
-			continue;
-		*tn = _prio_to_tn((i * 8) + idx - 1);
-		ret = 1;
-		break;
+	uint64_t summary, flag;
+	unsigned int i;
+
+	summary = __atomic_load_n(&tq->summary, __ATOMIC_ACQUIRE);
+	while(summary) {
+		i = __builtin_ctzll(summary);
+		flag = __atomic_load_n(&tq->tflag[i], __ATOMIC_ACQUIRE);
+		if(flag) {
+			*tn = _prio_to_tn(i * 64 + __builtin_ctzll(flag));
+			return 1;
+		}
+		/* Word acked since summary has been read */
+		summary &= summary - 1;
 	}
 
-	return ret;
+	return 0;
 }
@@ -35,14 +35,38 @@
 /* Trap raised by an instruction exception */
 #define TRAP_IS_ISN(tn) ((tn) >= ST_TISN_MIN)
 
+/* Number of 64bit words in trap flags bitmap */
+#define TQ_NRWORD (256 / 64)
+
+/**
+ * Pending traps, can be raised from any thread
+ */
 struct trap_queue {
-	/* Trap flags */
-	uint8_t tflag[32];
+	/* Bit n is set if tflag[n] has a pending trap */
+	uint64_t summary;
+	/* Trap flags, indexed by trap priority (0 being the highest) */
+	uint64_t tflag[TQ_NRWORD];
 };
 
 void tq_raise(struct trap_queue *tq, uint8_t tn);
 void tq_ack(struct trap_queue *tq, uint8_t tn);
-int tq_pending(struct trap_queue *tq, uint8_t *tn);
+int tq_highest(struct trap_queue *tq, uint8_t *tn);
 int trap_is_interrupt(uint8_t tn);
 
+/**
+ * Yeld the pending trap with highest priority
+ *
+ * @param tq: The trap queue
+ * @param tn: Set to the highest priority pending trap number
+ *
+ * @return: 0 if no trap are pending, 1 otherwise
+ */
+static inline int tq_pending(struct trap_queue *tq, uint8_t *tn)
+{
+	if(__atomic_load_n(&tq->summary, __ATOMIC_ACQUIRE) == 0)
+		return 0;
+
+	return tq_highest(tq, tn);
+}
+
 #endif
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -90,3 +91,96 @@ void dev_destroy(struct dev *d)
 	list_del(&d->next);
 	d->drv->ops->destroy(d);
 }
+
+/**
+ * Saved state of one device
+ */
+struct dev_snapshot_entry {
+	struct dev *dev;
+	void *data;
+};
+
+/**
+ * Saved state of all devices
+ */
+struct dev_snapshot {
+	size_t nr;
+	struct dev_snapshot_entry dev[];
+};
+
+/**
+ * Save state of every device. Devices without snapshot operation are
+ * considered stateless and are skipped. Devices must not be created or
+ * destroyed while snapshot is in use.
+ *
+ * @return: New snapshot, NULL pointer on error
+ */
+struct dev_snapshot *dev_snapshot_take(void)
+{
+	struct dev_snapshot *snap;
+	struct dev *p;
+	size_t nr = 0;
+	int ret;
+
+	list_for_each_entry(p, &devlst, next)
+		if(p->drv->ops->snapshot)
+			++nr;
+
+	snap = malloc(sizeof(*snap) + nr * sizeof(*snap->dev));
+	if(snap == NULL)
+		return NULL;
+
+	snap->nr = 0;
+	list_for_each_entry(p, &devlst, next) {
+		if(!p->drv->ops->snapshot)
+			continue;
+		ret = p->drv->ops->snapshot(p, &snap->dev[snap->nr].data);
+		if(ret != 0) {
+			dev_snapshot_free(snap);
+			return NULL;
+		}
+		snap->dev[snap->nr].dev = p;
+		++snap->nr;
+	}
+
+	return snap;
+}
+
+/**
+ * Restore state of every device from a snapshot
+ *
+ * @param snap: Snapshot to restore
+ * @return: 0 on success, negative number otherwise
+ */
+int dev_snapshot_restore(struct dev_snapshot const *snap)
+{
+	struct dev *d;
+	size_t i;
+	int ret;
+
+	for(i = 0; i < snap->nr; ++i) {
+		d = snap->dev[i].dev;
+		ret = d->drv->ops->restore(d, snap->dev[i].data);
+		if(ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * Free a device snapshot
+ *
+ * @param snap: Snapshot to free
+ */
+void dev_snapshot_free(struct dev_snapshot *snap)
+{
+	struct dev *d;
+	size_t i;
+
+	for(i = 0; i < snap->nr; ++i) {
+		d = snap->dev[i].dev;
+		d->drv->ops->snapshot_free(d, snap->dev[i].data);
+	}
+	free(snap);
+}
@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/anonmem.h"
+
+#include "ramctl.h"
+#include "memsnap.h"
+
+/* Huge page size used to round MAP_HUGETLB mapping size */
+#define AMEM_HUGEPAGE_SZ (2 * 1024 * 1024)
+
+struct anonmem {
+	/* Ramctl device */
+	struct ramdev ramdev;
+	/* Actual mapping size, can be larger than device size */
+	size_t mapsz;
+	/* Memory data */
+	uint8_t *mapmem;
+	/* Snapshot memory has last been restored from, NULL if none */
+	void *base;
+};
+#define to_anonmem(m) (container_of(to_ramdev(m), struct anonmem, ramdev))
+
+#define AMEM_BYTE(mem, off) (*((uint8_t *)((mem) + (off))))
+#define AMEM_HALF(mem, off) (*((uint16_t *)((mem) + (off))))
+#define AMEM_WORD(mem, off) (*((uint32_t *)((mem) + (off))))
+#define AMEM_DWORD(mem, off) (*((uint64_t *)((mem) + (off))))
+
+/**
+ * Fetch a 8 bit value from memory
+ */
+static int amem_read8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	*val = AMEM_BYTE(adev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 16 bit value from memory
+ */
+static int amem_read16(struct dev *dev, phyaddr_t addr, uint16_t *val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	*val = AMEM_HALF(adev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 32 bit value from memory
+ */
+static int amem_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	*val = AMEM_WORD(adev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int amem_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	*val = AMEM_DWORD(adev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Write a 8 bit value into memory
+ */
+static int amem_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	AMEM_BYTE(adev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 16 bit value into memory
+ */
+static int amem_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	AMEM_HALF(adev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 32 bit value into memory
+ */
+static int amem_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	AMEM_WORD(adev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 64 bit value into memory
+ */
+static int amem_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	AMEM_DWORD(adev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Copy a block of memory
+ */
+static int amem_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	if((addr > adev->ramdev.size) || (len > adev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(buf, adev->mapmem + addr, len);
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory
+ */
+static int amem_write_block(struct dev *dev, phyaddr_t addr, void const *buf,
+		size_t len)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	if((addr > adev->ramdev.size) || (len > adev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(adev->mapmem + addr, buf, len);
+
+	return 0;
+}
+
+/**
+ * Get host memory backing the whole device
+ */
+static int amem_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct anonmem *adev = to_anonmem(dev);
+
+	if(addr >= adev->ramdev.size)
+		return -EINVAL;
+
+	hm->host = adev->mapmem;
+	hm->addr = 0;
+	hm->sz = adev->ramdev.size;
+	hm->perm = adev->ramdev.perm;
+
+	return 0;
+}
+
+/**
+ * Save memory content, pages never touched are not read
+ */
+static int amem_snapshot(struct dev *dev, void **snap)
+{
+	struct anonmem *am = to_anonmem(dev);
+
+	return memsnap_take_resident(am->mapmem, am->mapsz, am->base, snap);
+}
+
+/**
+ * Restore memory content, pages are only copied once written
+ */
+static int amem_restore(struct dev *dev, void const *snap)
+{
+	struct anonmem *am = to_anonmem(dev);
+	void *base;
+	int ret;
+
+	/* Pages not written since restore are only held by snapshot */
+	base = memsnap_dup(snap);
+	if(base == NULL)
+		return -ENOMEM;
+
+	ret = memsnap_restore(am->mapmem, am->mapsz, PROT_READ | PROT_WRITE,
+			snap);
+	if(ret != 0) {
+		memsnap_free(base);
+		return ret;
+	}
+
+	if(am->base != NULL)
+		memsnap_free(am->base);
+	am->base = base;
+
+	return 0;
+}
+
+/**
+ * Free a memory snapshot
+ */
+static void amem_snapshot_free(struct dev *dev, void *snap)
+{
+	(void)dev;
+
+	memsnap_free(snap);
+}
+
+/**
+ * Move memory at another host address
+ */
+static int amem_relocate(struct dev *dev, uint8_t *host, size_t sz)
+{
+	struct anonmem *am = to_anonmem(dev);
+	int ret;
+
+	if(am->mapsz > sz)
+		return -ENOSPC;
+
+	ret = ramdev_move(am->mapmem, am->mapsz, host);
+	if(ret == 0)
+		am->mapmem = host;
+
+	return ret;
+}
+
+/**
+ * Allocate anonymous memory, trying huge pages first if requested
+ */
+static inline int amem_map(struct anonmem *amem, unsigned int flags)
+{
+	int mflags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	amem->mapmem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	/*
+	 * Huge pages are always reserved, without reservation an empty pool
+	 * would only be noticed with a SIGBUS on first touch
+	 */
+	if(flags & ANONMEM_HUGEPAGE) {
+		amem->mapsz = (amem->ramdev.size + AMEM_HUGEPAGE_SZ - 1) &
+			~((size_t)AMEM_HUGEPAGE_SZ - 1);
+		amem->mapmem = mmap(NULL, amem->mapsz, PROT_READ | PROT_WRITE,
+				mflags | MAP_HUGETLB, -1, 0);
+	}
+#endif
+
+	/* No (reserved) huge pages, fallback to transparent ones */
+	if(amem->mapmem == MAP_FAILED) {
+		if(flags & ANONMEM_NORESERVE)
+			mflags |= MAP_NORESERVE;
+		amem->mapsz = amem->ramdev.size;
+		amem->mapmem = mmap(NULL, amem->mapsz, PROT_READ | PROT_WRITE,
+				mflags, -1, 0);
+		if(amem->mapmem == MAP_FAILED)
+			return -ENOMEM;
+#ifdef MADV_HUGEPAGE
+		if(flags & ANONMEM_HUGEPAGE)
+			madvise(amem->mapmem, amem->mapsz, MADV_HUGEPAGE);
+#endif
+	}
+
+	return 0;
+}
+
+/**
+ * Create a new anonymous memory device instance
+ */
+static int amem_create(struct dev **dev, struct devcfg const *cfg)
+{
+	struct anonmem *am;
+	struct anonmem_cfg const *acfg = (struct anonmem_cfg const *)cfg->cfg;
+	int err = -EINVAL;
+
+	if(acfg->sz == 0)
+		goto exit;
+
+	err = -ENOMEM;
+	am = calloc(1, sizeof(*am));
+	if(am == NULL)
+		goto exit;
+
+	am->ramdev.perm = acfg->perm;
+	am->ramdev.size = acfg->sz;
+
+	err = amem_map(am, acfg->flags);
+	if(err != 0) {
+		free(am);
+		goto exit;
+	}
+
+	*dev = &am->ramdev.dev;
+exit:
+	return err;
+}
+
+/*
+ * Destroy an anonymous memory device instance
+ */
+static void amem_destroy(struct dev *dev)
+{
+	struct anonmem *am = to_anonmem(dev);
+
+	munmap(am->mapmem, am->mapsz);
+	if(am->base != NULL)
+		memsnap_free(am->base);
+	free(am);
+}
+
+/*
+ * Anonymous memory driver operations
+ */
+static struct phydevops const amops = {
+	.create = amem_create,
+	.destroy = amem_destroy,
+	.read8 = amem_read8,
+	.read16 = amem_read16,
+	.read32 = amem_read32,
+	.read64 = amem_read64,
+	.write8 = amem_write8,
+	.write16 = amem_write16,
+	.write32 = amem_write32,
+	.write64 = amem_write64,
+	.read_block = amem_read_block,
+	.write_block = amem_write_block,
+	.fetch_isn8 = amem_read8,
+	.fetch_isn16 = amem_read16,
+	.fetch_isn32 = amem_read32,
+	.hostmem = amem_hostmem,
+	.relocate = amem_relocate,
+	.snapshot = amem_snapshot,
+	.restore = amem_restore,
+	.snapshot_free = amem_snapshot_free,
+};
+
+/*
+ * Anonymous memory driver structure
+ */
+static struct drv const amem = {
+	.name = "anon-mem",
+	.phyops = &amops,
+};
+
+DRIVER_REGISTER(amem);
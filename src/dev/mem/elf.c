@@ -0,0 +1,667 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+#include <errno.h>
+#include <elf.h>
+
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/elfmem.h"
+#include "loader/loader.h"
+
+#include "ramctl.h"
+#include "memsnap.h"
+
+struct elfmem {
+	/* Ramctl device */
+	struct ramdev ramdev;
+	/* Memory data, image segments are mapped into it */
+	uint8_t *mapmem;
+	/* Actual mapping size */
+	size_t mapsz;
+	/* Image entry point */
+	addr_t entry;
+	/* Image symbols, sorted by address */
+	struct elf_sym *sym;
+	/* Number of image symbols */
+	size_t nrsym;
+	/* Symbol names */
+	char *strtab;
+};
+#define to_elfmem(m) (container_of(to_ramdev(m), struct elfmem, ramdev))
+
+#define EMEM_BYTE(mem, off) (*((uint8_t *)((mem) + (off))))
+#define EMEM_HALF(mem, off) (*((uint16_t *)((mem) + (off))))
+#define EMEM_WORD(mem, off) (*((uint32_t *)((mem) + (off))))
+#define EMEM_DWORD(mem, off) (*((uint64_t *)((mem) + (off))))
+
+static struct drv const emem;
+
+/**
+ * Fetch a 8 bit value from memory
+ */
+static int emem_read8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	*val = EMEM_BYTE(edev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 16 bit value from memory
+ */
+static int emem_read16(struct dev *dev, phyaddr_t addr, uint16_t *val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	*val = EMEM_HALF(edev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 32 bit value from memory
+ */
+static int emem_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	*val = EMEM_WORD(edev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int emem_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	*val = EMEM_DWORD(edev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Write a 8 bit value into memory
+ */
+static int emem_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	EMEM_BYTE(edev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 16 bit value into memory
+ */
+static int emem_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	EMEM_HALF(edev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 32 bit value into memory
+ */
+static int emem_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	EMEM_WORD(edev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 64 bit value into memory
+ */
+static int emem_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	EMEM_DWORD(edev->mapmem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Copy a block of memory
+ */
+static int emem_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	if((addr > edev->ramdev.size) || (len > edev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(buf, edev->mapmem + addr, len);
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory
+ */
+static int emem_write_block(struct dev *dev, phyaddr_t addr, void const *buf,
+		size_t len)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	if((addr > edev->ramdev.size) || (len > edev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(edev->mapmem + addr, buf, len);
+
+	return 0;
+}
+
+/**
+ * Get host memory backing the whole device
+ */
+static int emem_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct elfmem *edev = to_elfmem(dev);
+
+	if(addr >= edev->ramdev.size)
+		return -EINVAL;
+
+	hm->host = edev->mapmem;
+	hm->addr = 0;
+	hm->sz = edev->ramdev.size;
+	hm->perm = edev->ramdev.perm;
+
+	return 0;
+}
+
+/**
+ * Save memory content
+ */
+static int emem_snapshot(struct dev *dev, void **snap)
+{
+	struct elfmem *em = to_elfmem(dev);
+
+	return memsnap_take(em->mapmem, em->mapsz, em->mapsz, snap);
+}
+
+/**
+ * Restore memory content, pages are only copied once written
+ */
+static int emem_restore(struct dev *dev, void const *snap)
+{
+	struct elfmem *em = to_elfmem(dev);
+
+	return memsnap_restore(em->mapmem, em->mapsz, PROT_READ | PROT_WRITE,
+			snap);
+}
+
+/**
+ * Free a memory snapshot
+ */
+static void emem_snapshot_free(struct dev *dev, void *snap)
+{
+	(void)dev;
+
+	memsnap_free(snap);
+}
+
+/**
+ * Move memory at another host address
+ */
+static int emem_relocate(struct dev *dev, uint8_t *host, size_t sz)
+{
+	struct elfmem *em = to_elfmem(dev);
+	int ret;
+
+	if(em->mapsz > sz)
+		return -ENOSPC;
+
+	ret = ramdev_move(em->mapmem, em->mapsz, host);
+	if(ret == 0)
+		em->mapmem = host;
+
+	return ret;
+}
+
+/**
+ * Read a file chunk
+ *
+ * @param fd: File descriptor
+ * @param buf: Read data
+ * @param off: File offset
+ * @param len: Number of bytes to read
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int emem_pread(int fd, void *buf, off_t off, size_t len)
+{
+	ssize_t sz;
+
+	for(; len != 0; buf = (uint8_t *)buf + sz, off += sz, len -= sz) {
+		sz = pread(fd, buf, len, off);
+		if(sz < 0)
+			return -errno;
+		if(sz == 0)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * Load a PT_LOAD segment. File pages are mapped private (thus copy on write)
+ * whenever segment file offset and memory offset are congruent modulo host
+ * page size, only partial first and last pages are copied. What is beyond
+ * segment file size is left to the anonymous mapping, that is lazily zeroed.
+ *
+ * @param em: ELF memory device
+ * @param fd: ELF file descriptor
+ * @param off: Segment offset in device memory
+ * @param foff: Segment offset in file
+ * @param len: Segment file size
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int emem_load_seg(struct elfmem *em, int fd, size_t off, off_t foff,
+		size_t len)
+{
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	size_t start = (off + pgsz - 1) & ~(pgsz - 1);
+	size_t end = (off + len) & ~(pgsz - 1);
+	void *map;
+	int ret;
+
+	if((((off - foff) & (pgsz - 1)) != 0) || (start >= end))
+		return emem_pread(fd, em->mapmem + off, foff, len);
+
+	map = mmap(em->mapmem + start, end - start, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_FIXED, fd, foff + (start - off));
+	if(map == MAP_FAILED)
+		return -ENOMEM;
+
+	ret = emem_pread(fd, em->mapmem + off, foff, start - off);
+	if(ret != 0)
+		return ret;
+
+	return emem_pread(fd, em->mapmem + end, foff + (end - off),
+			off + len - end);
+}
+
+/**
+ * Compare symbol addresses for sorting
+ */
+static int emem_symcmp(void const *a, void const *b)
+{
+	struct elf_sym const *sa = a, *sb = b;
+
+	if(sa->addr < sb->addr)
+		return -1;
+	return (sa->addr > sb->addr);
+}
+
+/**
+ * Load image symbol table, if any
+ *
+ * @param em: ELF memory device
+ * @param fd: ELF file descriptor
+ * @param eh: ELF header, in host byte order
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int emem_load_syms(struct elfmem *em, int fd, Elf32_Ehdr const *eh)
+{
+	Elf32_Shdr sh, strsh;
+	Elf32_Sym *st;
+	size_t i, nr;
+	int ret;
+
+	/* Find symbol table section */
+	for(i = 0; i < eh->e_shnum; ++i) {
+		ret = emem_pread(fd, &sh, eh->e_shoff + i * eh->e_shentsize,
+				sizeof(sh));
+		if(ret != 0)
+			return ret;
+		if(be32toh(sh.sh_type) == SHT_SYMTAB)
+			break;
+	}
+
+	if(i == eh->e_shnum)
+		return 0;
+
+	/* Load its string table */
+	if(be32toh(sh.sh_link) >= eh->e_shnum)
+		return -EINVAL;
+	ret = emem_pread(fd, &strsh, eh->e_shoff +
+			be32toh(sh.sh_link) * eh->e_shentsize, sizeof(strsh));
+	if(ret != 0)
+		return ret;
+
+	em->strtab = malloc(be32toh(strsh.sh_size) + 1);
+	if(em->strtab == NULL)
+		return -ENOMEM;
+	ret = emem_pread(fd, em->strtab, be32toh(strsh.sh_offset),
+			be32toh(strsh.sh_size));
+	if(ret != 0)
+		return ret;
+	em->strtab[be32toh(strsh.sh_size)] = '\0';
+
+	nr = be32toh(sh.sh_size) / sizeof(*st);
+	if(nr == 0)
+		return 0;
+
+	em->sym = calloc(nr, sizeof(*em->sym));
+	if(em->sym == NULL)
+		return -ENOMEM;
+
+	/* Read the whole symbol table at once */
+	st = malloc(nr * sizeof(*st));
+	if(st == NULL)
+		return -ENOMEM;
+	ret = emem_pread(fd, st, be32toh(sh.sh_offset), nr * sizeof(*st));
+	if(ret != 0)
+		goto out;
+
+	/* Keep defined named symbols */
+	for(i = 0; i < nr; ++i) {
+		if((be16toh(st[i].st_shndx) == SHN_UNDEF) ||
+				(be32toh(st[i].st_name) == 0) ||
+				(be32toh(st[i].st_name) >=
+				 be32toh(strsh.sh_size)))
+			continue;
+
+		switch(ELF32_ST_TYPE(st[i].st_info)) {
+		case STT_NOTYPE:
+		case STT_OBJECT:
+		case STT_FUNC:
+			break;
+		default:
+			continue;
+		}
+
+		em->sym[em->nrsym].addr = be32toh(st[i].st_value);
+		em->sym[em->nrsym].sz = be32toh(st[i].st_size);
+		em->sym[em->nrsym].name = em->strtab + be32toh(st[i].st_name);
+		++em->nrsym;
+	}
+
+	qsort(em->sym, em->nrsym, sizeof(*em->sym), emem_symcmp);
+
+out:
+	free(st);
+	return ret;
+}
+
+/**
+ * Check ELF header is a big endian SPARC 32 bit executable one
+ */
+static inline int emem_check_hdr(Elf32_Ehdr const *eh)
+{
+	if(memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0)
+		return -EINVAL;
+
+	if((eh->e_ident[EI_CLASS] != ELFCLASS32) ||
+			(eh->e_ident[EI_DATA] != ELFDATA2MSB))
+		return -EINVAL;
+
+	if((be16toh(eh->e_machine) != EM_SPARC) &&
+			(be16toh(eh->e_machine) != EM_SPARC32PLUS))
+		return -EINVAL;
+
+	if(be16toh(eh->e_type) != ET_EXEC)
+		return -EINVAL;
+
+	if((be16toh(eh->e_phentsize) != sizeof(Elf32_Phdr)) ||
+			((eh->e_shnum != 0) &&
+			 (be16toh(eh->e_shentsize) != sizeof(Elf32_Shdr))))
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * Map ELF image into memory
+ */
+static int emem_load(struct elfmem *em, int fd, struct elfmem_cfg const *ecfg)
+{
+	Elf32_Ehdr eh;
+	Elf32_Phdr *ph = NULL;
+	size_t i, sz, pgsz = sysconf(_SC_PAGESIZE);
+	phyaddr_t pa;
+	int ret;
+
+	ret = emem_pread(fd, &eh, 0, sizeof(eh));
+	if(ret != 0)
+		goto out;
+
+	ret = emem_check_hdr(&eh);
+	if(ret != 0)
+		goto out;
+
+	em->entry = be32toh(eh.e_entry);
+	eh.e_phoff = be32toh(eh.e_phoff);
+	eh.e_phnum = be16toh(eh.e_phnum);
+	eh.e_shoff = be32toh(eh.e_shoff);
+	eh.e_shnum = be16toh(eh.e_shnum);
+	eh.e_shentsize = be16toh(eh.e_shentsize);
+
+	ret = -ENOMEM;
+	ph = calloc(eh.e_phnum, sizeof(*ph));
+	if((ph == NULL) && (eh.e_phnum != 0))
+		goto out;
+
+	ret = emem_pread(fd, ph, eh.e_phoff, eh.e_phnum * sizeof(*ph));
+	if(ret != 0)
+		goto out;
+
+	/* Memory has to hold all loadable segments */
+	sz = ecfg->sz;
+	for(i = 0; i < eh.e_phnum; ++i) {
+		if(be32toh(ph[i].p_type) != PT_LOAD)
+			continue;
+
+		ret = -EINVAL;
+		pa = be32toh(ph[i].p_paddr);
+		if((pa < ecfg->addr) ||
+				(be32toh(ph[i].p_filesz) >
+				 be32toh(ph[i].p_memsz)))
+			goto out;
+
+		if(pa - ecfg->addr + be32toh(ph[i].p_memsz) > sz)
+			sz = pa - ecfg->addr + be32toh(ph[i].p_memsz);
+	}
+
+	/* Zero filled memory is only allocated when touched */
+	ret = -EINVAL;
+	if(sz == 0)
+		goto out;
+	em->ramdev.size = sz;
+	em->mapsz = (sz + pgsz - 1) & ~(pgsz - 1);
+	em->mapmem = mmap(NULL, em->mapsz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(em->mapmem == MAP_FAILED) {
+		em->mapmem = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for(i = 0; i < eh.e_phnum; ++i) {
+		if((be32toh(ph[i].p_type) != PT_LOAD) ||
+				(be32toh(ph[i].p_filesz) == 0))
+			continue;
+
+		ret = emem_load_seg(em, fd,
+				be32toh(ph[i].p_paddr) - ecfg->addr,
+				be32toh(ph[i].p_offset),
+				be32toh(ph[i].p_filesz));
+		if(ret != 0)
+			goto out;
+	}
+
+	ret = emem_load_syms(em, fd, &eh);
+out:
+	free(ph);
+	return ret;
+}
+
+/**
+ * Release ELF memory device resources
+ */
+static void emem_free(struct elfmem *em)
+{
+	if(em->mapmem != NULL)
+		munmap(em->mapmem, em->mapsz);
+	free(em->sym);
+	free(em->strtab);
+	free(em);
+}
+
+/**
+ * Create a new ELF image memory device instance
+ */
+static int emem_create(struct dev **dev, struct devcfg const *cfg)
+{
+	struct elfmem *em;
+	struct elfmem_cfg const *ecfg = (struct elfmem_cfg const *)cfg->cfg;
+	int fd, err = -ENOMEM;
+
+	em = calloc(1, sizeof(*em));
+	if(em == NULL)
+		goto exit;
+
+	fd = open(ecfg->path, O_RDONLY);
+	if(fd < 0) {
+		err = -errno;
+		PERR("Cannot open %s", ecfg->path);
+		emem_free(em);
+		goto exit;
+	}
+
+	em->ramdev.perm = MP_R | MP_W | MP_X;
+	err = emem_load(em, fd, ecfg);
+	/* File mappings hold their own reference */
+	close(fd);
+	if(err != 0) {
+		ERR("Cannot load ELF image %s\n", ecfg->path);
+		emem_free(em);
+		goto exit;
+	}
+
+	*dev = &em->ramdev.dev;
+exit:
+	return err;
+}
+
+/*
+ * Destroy an ELF image memory device instance
+ */
+static void emem_destroy(struct dev *dev)
+{
+	emem_free(to_elfmem(dev));
+}
+
+/**
+ * Get entry point of an ELF memory device image
+ *
+ * @param dev: ELF memory device
+ *
+ * @return: Image entry point address
+ */
+addr_t elfmem_entry(struct dev *dev)
+{
+	if(dev->drv != &emem)
+		return 0;
+
+	return to_elfmem(dev)->entry;
+}
+
+/**
+ * Find ELF memory device image symbol containing an address. Symbols without
+ * size (e.g. assembly labels) extend up to the next symbol.
+ *
+ * @param dev: ELF memory device
+ * @param addr: Address to look up
+ *
+ * @return: Symbol, NULL pointer if none contains address
+ */
+struct elf_sym const *elfmem_find_sym(struct dev *dev, addr_t addr)
+{
+	struct elfmem *em;
+	size_t lo = 0, hi, mid;
+
+	if(dev->drv != &emem)
+		return NULL;
+
+	em = to_elfmem(dev);
+
+	/* Find last symbol starting at or before addr */
+	hi = em->nrsym;
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(em->sym[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if(lo == 0)
+		return NULL;
+
+	if((em->sym[lo - 1].sz != 0) &&
+			(addr - em->sym[lo - 1].addr >= em->sym[lo - 1].sz))
+		return NULL;
+
+	return &em->sym[lo - 1];
+}
+
+/*
+ * ELF image memory driver operations
+ */
+static struct phydevops const emops = {
+	.create = emem_create,
+	.destroy = emem_destroy,
+	.read8 = emem_read8,
+	.read16 = emem_read16,
+	.read32 = emem_read32,
+	.read64 = emem_read64,
+	.write8 = emem_write8,
+	.write16 = emem_write16,
+	.write32 = emem_write32,
+	.write64 = emem_write64,
+	.read_block = emem_read_block,
+	.write_block = emem_write_block,
+	.fetch_isn8 = emem_read8,
+	.fetch_isn16 = emem_read16,
+	.fetch_isn32 = emem_read32,
+	.hostmem = emem_hostmem,
+	.relocate = emem_relocate,
+	.snapshot = emem_snapshot,
+	.restore = emem_restore,
+	.snapshot_free = emem_snapshot_free,
+};
+
+/*
+ * ELF image memory driver structure
+ */
+static struct drv const emem = {
+	.name = "elf-mem",
+	.phyops = &emops,
+};
+
+DRIVER_REGISTER(emem);
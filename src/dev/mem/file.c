@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <string.h>
 #include <errno.h>
 
 #include <sys/mman.h>
@@ -14,6 +15,7 @@
 #include "dev/cfg/filemem.h"
 
 #include "ramctl.h"
+#include "memsnap.h"
 
 struct filemem {
 	/* Ramctl device */
@@ -22,9 +24,44 @@ struct filemem {
 	int fd;
 	/* Actual mapp'ed memory data */
 	uint8_t *mapmem;
+	/* Number of mapped bytes backed by file */
+	size_t filesz;
+	/* FILEMEM_* flags */
+	unsigned int flags;
+	/* Host page size shift, dirty pages granularity */
+	unsigned int pgshift;
+	/* Number of host pages */
+	size_t nrpg;
+	/* Pages written since last flush, NULL if mapping is private */
+	uint64_t *dirty;
+	/* Number of dirty pages */
+	size_t nrdirty;
+	/* Pages written since last checkpoint, allocated along with dirty */
+	uint64_t *ckpt;
+	/* Dirty pages threshold that triggers a flush, 0 if none */
+	size_t flushpg;
+	/* Snapshots of a shared mapping, tracking pages written since */
+	struct list_head snap;
 };
 #define to_filemem(m) (container_of(to_ramdev(m), struct filemem, ramdev))
 
+/* Snapshot of file memory */
+struct fmem_snap {
+	/* Next snapshot of the same shared mapping */
+	struct list_head next;
+	/* Saved memory content */
+	void *ms;
+	/* Pages written since snapshot, unused if mapping is private */
+	uint64_t dirty[];
+};
+
+#define FMEM_BM_WORD(n) ((n) / 64)
+#define FMEM_BM_BIT(n) ((uint64_t)1 << ((n) % 64))
+#define FMEM_BM_SZ(nr) (((nr) + 63) / 64 * sizeof(uint64_t))
+
+static struct drv const fmem;
+static int fmem_flush(struct filemem *fm, int flags);
+
 /* Convert a sporc file permission to a POSIX one */
 static inline int fmem_perm_flag(perm_t perm)
 {
@@ -53,6 +90,7 @@ static inline int fmem_perm_flag(perm_t perm)
 #define FMEM_BYTE(mem, off) (*((uint8_t *)((mem) + (off))))
 #define FMEM_HALF(mem, off) (*((uint16_t *)((mem) + (off))))
 #define FMEM_WORD(mem, off) (*((uint32_t *)((mem) + (off))))
+#define FMEM_DWORD(mem, off) (*((uint64_t *)((mem) + (off))))
 
 /**
  * Fetch a 8 bit value from memory
@@ -90,6 +128,93 @@ static int fmem_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
 	return 0;
 }
 
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int fmem_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	struct filemem *fdev = to_filemem(dev);
+
+	*val = FMEM_DWORD(fdev->mapmem, addr);
+
+	return 0;
+}
+
+/**
+ * Find next run of set bits in a bitmap
+ *
+ * @param bm: Bitmap
+ * @param nr: Number of bits in bitmap
+ * @param n: Start looking from this bit, set to first bit of run
+ *
+ * @return: Run length, 0 if no bit is set from n
+ */
+static size_t fmem_bm_run(uint64_t const *bm, size_t nr, size_t *n)
+{
+	size_t i = *n, end;
+	uint64_t w;
+
+	/* Find first set bit */
+	while(i < nr) {
+		w = bm[FMEM_BM_WORD(i)] & ~(FMEM_BM_BIT(i) - 1);
+		if(w != 0) {
+			i = (i & ~(size_t)63) + __builtin_ctzll(w);
+			break;
+		}
+		i = (i & ~(size_t)63) + 64;
+	}
+	if(i >= nr)
+		return 0;
+
+	/* Find first cleared bit */
+	end = i;
+	while(end < nr) {
+		w = ~bm[FMEM_BM_WORD(end)] & ~(FMEM_BM_BIT(end) - 1);
+		if(w != 0) {
+			end = (end & ~(size_t)63) + __builtin_ctzll(w);
+			break;
+		}
+		end = (end & ~(size_t)63) + 64;
+	}
+	if(end > nr)
+		end = nr;
+
+	*n = i;
+	return end - i;
+}
+
+/**
+ * Mark memory range as written. This is a no-op for private mappings.
+ *
+ * @param fm: File memory device
+ * @param addr: First written byte
+ * @param len: Number of written bytes
+ */
+static inline void fmem_set_dirty(struct filemem *fm, phyaddr_t addr,
+		size_t len)
+{
+	struct fmem_snap *fs;
+	size_t pg, last;
+
+	if((fm->dirty == NULL) || (len == 0))
+		return;
+
+	last = (addr + len - 1) >> fm->pgshift;
+	for(pg = addr >> fm->pgshift; pg <= last; ++pg) {
+		list_for_each_entry(fs, &fm->snap, next)
+			fs->dirty[FMEM_BM_WORD(pg)] |= FMEM_BM_BIT(pg);
+		fm->ckpt[FMEM_BM_WORD(pg)] |= FMEM_BM_BIT(pg);
+		if(fm->dirty[FMEM_BM_WORD(pg)] & FMEM_BM_BIT(pg))
+			continue;
+		fm->dirty[FMEM_BM_WORD(pg)] |= FMEM_BM_BIT(pg);
+		++fm->nrdirty;
+	}
+
+	/* Only schedule write back, stores must not wait for the disk */
+	if(fm->flushpg && (fm->nrdirty >= fm->flushpg))
+		fmem_flush(fm, MS_ASYNC);
+}
+
 /**
  * Write a 8 bit value into memory
  */
@@ -98,6 +223,7 @@ static int fmem_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
 	struct filemem *fdev = to_filemem(dev);
 
 	FMEM_BYTE(fdev->mapmem, addr) = val;
+	fmem_set_dirty(fdev, addr, sizeof(val));
 
 	return 0;
 }
@@ -110,6 +236,7 @@ static int fmem_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
 	struct filemem *fdev = to_filemem(dev);
 
 	FMEM_HALF(fdev->mapmem, addr) = val;
+	fmem_set_dirty(fdev, addr, sizeof(val));
 
 	return 0;
 }
@@ -122,24 +249,232 @@ static int fmem_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
 	struct filemem *fdev = to_filemem(dev);
 
 	FMEM_WORD(fdev->mapmem, addr) = val;
+	fmem_set_dirty(fdev, addr, sizeof(val));
 
 	return 0;
 }
 
 /**
- * Map a file to memory
+ * Write a 64 bit value into memory
  */
-static inline int fmem_map(struct filemem *fmem, off_t off)
+static int fmem_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	struct filemem *fdev = to_filemem(dev);
+
+	FMEM_DWORD(fdev->mapmem, addr) = val;
+	fmem_set_dirty(fdev, addr, sizeof(val));
+
+	return 0;
+}
+
+/**
+ * Copy a block of memory
+ */
+static int fmem_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct filemem *fdev = to_filemem(dev);
+
+	if((addr > fdev->ramdev.size) || (len > fdev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(buf, fdev->mapmem + addr, len);
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory
+ */
+static int fmem_write_block(struct dev *dev, phyaddr_t addr, void const *buf,
+		size_t len)
+{
+	struct filemem *fdev = to_filemem(dev);
+
+	if((addr > fdev->ramdev.size) || (len > fdev->ramdev.size - addr))
+		return -EINVAL;
+
+	memcpy(fdev->mapmem + addr, buf, len);
+	fmem_set_dirty(fdev, addr, len);
+
+	return 0;
+}
+
+/**
+ * Get host memory backing the whole mapped file
+ */
+static int fmem_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct filemem *fdev = to_filemem(dev);
+
+	if(addr >= fdev->ramdev.size)
+		return -EINVAL;
+
+	hm->host = fdev->mapmem;
+	hm->addr = 0;
+	hm->sz = fdev->ramdev.size;
+	hm->perm = fdev->ramdev.perm;
+
+	/* Writes to a shared mapping have to go through dirty tracking */
+	if(fdev->dirty != NULL)
+		hm->perm &= ~MP_W;
+
+	return 0;
+}
+
+/* Convert a sporc file permission to a mapping protection */
+static inline int fmem_prot(perm_t perm)
 {
 	int prot = PROT_NONE;
 
-	if(fmem->ramdev.perm & MP_R)
+	if(perm & MP_R)
 		prot |= PROT_READ;
-	if(fmem->ramdev.perm & MP_W)
+	if(perm & MP_W)
 		prot |= PROT_WRITE;
 
-	fmem->mapmem = mmap(NULL, fmem->ramdev.size, prot, MAP_PRIVATE,
-			fmem->fd, off);
+	return prot;
+}
+
+/**
+ * Move file mapping at another host address
+ */
+static int fmem_relocate(struct dev *dev, uint8_t *host, size_t sz)
+{
+	struct filemem *fm = to_filemem(dev);
+	size_t pgmask = ((size_t)1 << fm->pgshift) - 1;
+	int ret;
+
+	if(((fm->ramdev.size + pgmask) & ~pgmask) > sz)
+		return -ENOSPC;
+
+	ret = ramdev_move(fm->mapmem, fm->ramdev.size, host);
+	if(ret == 0)
+		fm->mapmem = host;
+
+	return ret;
+}
+
+/**
+ * Save memory content. Pages written to a shared mapping from then on are
+ * tracked, so that restoring only copies them back.
+ */
+static int fmem_snapshot(struct dev *dev, void **snap)
+{
+	struct filemem *fm = to_filemem(dev);
+	struct fmem_snap *fs;
+	size_t sz = 0;
+	int ret;
+
+	if(fm->dirty != NULL)
+		sz = FMEM_BM_SZ(fm->nrpg);
+
+	fs = calloc(1, sizeof(*fs) + sz);
+	if(fs == NULL)
+		return -ENOMEM;
+
+	ret = memsnap_take(fm->mapmem, fm->ramdev.size, fm->filesz, &fs->ms);
+	if(ret != 0) {
+		free(fs);
+		return ret;
+	}
+
+	if(fm->dirty != NULL)
+		list_add(&fs->next, &fm->snap);
+
+	*snap = fs;
+	return 0;
+}
+
+/**
+ * Restore memory content. A private mapping is remapped copy-on-write over
+ * the snapshot; pages of a shared mapping written since snapshot are copied
+ * back so that file keeps following memory.
+ */
+static int fmem_restore(struct dev *dev, void const *snap)
+{
+	struct filemem *fm = to_filemem(dev);
+	struct fmem_snap *fs = (struct fmem_snap *)snap;
+	size_t pg = 0, nr, off, len;
+	int ret;
+
+	if(fm->dirty == NULL)
+		return memsnap_restore(fm->mapmem, fm->ramdev.size,
+				fmem_prot(fm->ramdev.perm), fs->ms);
+
+	while((nr = fmem_bm_run(fs->dirty, fm->nrpg, &pg)) != 0) {
+		off = pg << fm->pgshift;
+		len = nr << fm->pgshift;
+		if(len > fm->ramdev.size - off)
+			len = fm->ramdev.size - off;
+		ret = memsnap_read(fs->ms, off, fm->mapmem + off, len);
+		if(ret != 0)
+			return ret;
+		fmem_set_dirty(fm, off, len);
+		pg += nr;
+	}
+	memset(fs->dirty, 0, FMEM_BM_SZ(fm->nrpg));
+
+	return 0;
+}
+
+/**
+ * Free a memory snapshot
+ */
+static void fmem_snapshot_free(struct dev *dev, void *snap)
+{
+	struct filemem *fm = to_filemem(dev);
+	struct fmem_snap *fs = snap;
+
+	if(fm->dirty != NULL)
+		list_del(&fs->next);
+	memsnap_free(fs->ms);
+	free(fs);
+}
+
+/**
+ * Write dirty pages of a shared mapping back to file
+ *
+ * @param fm: File memory device
+ * @param flags: msync() flags, MS_SYNC to wait for write back completion
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int fmem_flush(struct filemem *fm, int flags)
+{
+	size_t pg = 0, nr, off, len;
+	int ret = 0;
+
+	while((nr = fmem_bm_run(fm->dirty, fm->nrpg, &pg)) != 0) {
+		off = pg << fm->pgshift;
+		len = nr << fm->pgshift;
+		if(len > fm->ramdev.size - off)
+			len = fm->ramdev.size - off;
+		if(msync(fm->mapmem + off, len, flags) != 0)
+			ret = -errno;
+		pg += nr;
+	}
+
+	memset(fm->dirty, 0, FMEM_BM_SZ(fm->nrpg));
+	fm->nrdirty = 0;
+
+	return ret;
+}
+
+/**
+ * Map a file to memory
+ */
+static inline int fmem_map(struct filemem *fmem, off_t off)
+{
+	int prot = fmem_prot(fmem->ramdev.perm);
+
+	int flags = MAP_PRIVATE;
+
+	if(fmem->flags & FILEMEM_SHARED)
+		flags = MAP_SHARED;
+
+	fmem->mapmem = mmap(NULL, fmem->ramdev.size, prot, flags, fmem->fd,
+			off);
 	if(fmem->mapmem == MAP_FAILED)
 		return -ENOMEM;
 
@@ -187,8 +522,8 @@ static int fmem_create(struct dev **dev, struct devcfg const *cfg)
 
 		fd = open(fcfg->path, flag);
 		if((fd < 0) && (errno != EACCES)) {
+			err = -errno;
 			PERR("Cannot open %s", fcfg->path);
-			err = errno;
 			goto exit;
 		}
 
@@ -203,8 +538,8 @@ static int fmem_create(struct dev **dev, struct devcfg const *cfg)
 	}
 
 	/* Find file size */
-	err = fstat(fd, &st);
-	if(err != 0) {
+	if(fstat(fd, &st) != 0) {
+		err = -errno;
 		PERR("Cannot stat %s\n", fcfg->path);
 		close(fd);
 		goto exit;
@@ -218,23 +553,58 @@ static int fmem_create(struct dev **dev, struct devcfg const *cfg)
 	fm = calloc(1, sizeof(*fm));
 	if(fm == NULL) {
 		close(fd);
-		err = ENOMEM;
+		err = -ENOMEM;
 		goto exit;
 	}
 
 	fm->fd = fd;
 	fm->ramdev.perm = perm[i];
 	fm->ramdev.size = sz;
-	*dev = &fm->ramdev.dev;
+	fm->flags = fcfg->flags;
+	fm->flushpg = fcfg->flushpg;
+	fm->pgshift = __builtin_ctzl(sysconf(_SC_PAGESIZE));
+	fm->nrpg = (sz + (1 << fm->pgshift) - 1) >> fm->pgshift;
+	INIT_LIST_HEAD(&fm->snap);
+
+	/* Persistent memory has to be entirely backed by file */
+	if((fm->flags & FILEMEM_SHARED) && (fm->ramdev.perm & MP_W) &&
+			(st.st_size < (off_t)(fcfg->off + sz))) {
+		if(ftruncate(fd, fcfg->off + sz) != 0) {
+			err = -errno;
+			PERR("Cannot extend %s", fcfg->path);
+			close(fd);
+			free(fm);
+			goto exit;
+		}
+		st.st_size = fcfg->off + sz;
+	}
+
+	fm->filesz = 0;
+	if(st.st_size > fcfg->off)
+		fm->filesz = st.st_size - fcfg->off;
+	if(fm->filesz > sz)
+		fm->filesz = sz;
+
+	if(fm->flags & FILEMEM_SHARED) {
+		fm->dirty = calloc(2, FMEM_BM_SZ(fm->nrpg));
+		if(fm->dirty == NULL) {
+			close(fd);
+			free(fm);
+			err = -ENOMEM;
+			goto exit;
+		}
+		fm->ckpt = fm->dirty + FMEM_BM_SZ(fm->nrpg) / sizeof(uint64_t);
+	}
 
 	/* Map file to memory */
 	err = fmem_map(fm, fcfg->off);
 	if(err != 0) {
 		close(fd);
+		free(fm->dirty);
 		free(fm);
-		err = ENOMEM;
 		goto exit;
 	}
+	*dev = &fm->ramdev.dev;
 
 exit:
 	return err;
@@ -247,8 +617,11 @@ static void fmem_destroy(struct dev *dev)
 {
 	struct filemem *fm = to_filemem(dev);
 
+	if(fm->dirty != NULL)
+		fmem_flush(fm, MS_SYNC);
 	fmem_unmap(fm);
 	close(fm->fd);
+	free(fm->dirty);
 	free(fm);
 }
 
@@ -261,12 +634,21 @@ static struct phydevops const fmops = {
 	.read8 = fmem_read8,
 	.read16 = fmem_read16,
 	.read32 = fmem_read32,
+	.read64 = fmem_read64,
 	.write8 = fmem_write8,
 	.write16 = fmem_write16,
 	.write32 = fmem_write32,
+	.write64 = fmem_write64,
+	.read_block = fmem_read_block,
+	.write_block = fmem_write_block,
 	.fetch_isn8 = fmem_read8,
 	.fetch_isn16 = fmem_read16,
 	.fetch_isn32 = fmem_read32,
+	.hostmem = fmem_hostmem,
+	.relocate = fmem_relocate,
+	.snapshot = fmem_snapshot,
+	.restore = fmem_restore,
+	.snapshot_free = fmem_snapshot_free,
 };
 
 /*
@@ -278,3 +660,89 @@ static struct drv const fmem = {
 };
 
 DRIVER_REGISTER(fmem);
+
+/**
+ * Write pages of a shared file memory that have been modified since last
+ * flush back to file. Only dirty ranges are synced.
+ *
+ * @param dev: File memory device
+ *
+ * @return: 0 on success, -EINVAL if device is not a shared file memory, other
+ * negative number on error
+ */
+int filemem_flush(struct dev *dev)
+{
+	struct filemem *fm;
+
+	if(dev->drv != &fmem)
+		return -EINVAL;
+
+	fm = to_filemem(dev);
+	if(fm->dirty == NULL)
+		return -EINVAL;
+
+	return fmem_flush(fm, MS_SYNC);
+}
+
+/**
+ * Start a new checkpoint of a shared file memory, filemem_dirty() then only
+ * reports pages written from now on. Flushes do not affect checkpoints.
+ *
+ * @param dev: File memory device
+ *
+ * @return: 0 on success, -EINVAL if device is not a shared file memory
+ */
+int filemem_checkpoint(struct dev *dev)
+{
+	struct filemem *fm;
+
+	if(dev->drv != &fmem)
+		return -EINVAL;
+
+	fm = to_filemem(dev);
+	if(fm->dirty == NULL)
+		return -EINVAL;
+
+	memset(fm->ckpt, 0, FMEM_BM_SZ(fm->nrpg));
+
+	return 0;
+}
+
+/**
+ * Find next range of a shared file memory modified since last checkpoint, so
+ * that only changed pages are copied (e.g. by checkpointing or migration
+ * code).
+ *
+ * @param dev: File memory device
+ * @param from: Start looking from this device address
+ * @param addr: Set to dirty range first byte
+ * @param sz: Set to dirty range size
+ *
+ * @return: 0 on success, -ENOENT if no range is dirty from address, -EINVAL
+ * if device is not a shared file memory
+ */
+int filemem_dirty(struct dev *dev, phyaddr_t from, phyaddr_t *addr,
+		size_t *sz)
+{
+	struct filemem *fm;
+	size_t pg, nr;
+
+	if(dev->drv != &fmem)
+		return -EINVAL;
+
+	fm = to_filemem(dev);
+	if(fm->dirty == NULL)
+		return -EINVAL;
+
+	pg = from >> fm->pgshift;
+	nr = fmem_bm_run(fm->ckpt, fm->nrpg, &pg);
+	if(nr == 0)
+		return -ENOENT;
+
+	*addr = (phyaddr_t)pg << fm->pgshift;
+	*sz = nr << fm->pgshift;
+	if(*sz > fm->ramdev.size - *addr)
+		*sz = fm->ramdev.size - *addr;
+
+	return 0;
+}
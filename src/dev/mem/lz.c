@@ -0,0 +1,228 @@
+/*
+ * Byte oriented LZ77 block codec. A block is a list of sequences, each made
+ * of a token byte, literals and a back reference:
+ *  - token high nibble is the number of literals, 15 meaning more length
+ *    bytes follow the token (each 255 byte meaning yet another one)
+ *  - token low nibble is the match length minus LZ_MINMATCH, extended the
+ *    same way after the 16 bit little endian match offset
+ * The last sequence only holds literals and ends the block.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lz.h"
+
+#define LZ_MINMATCH 4
+#define LZ_MAXOFF 0xffff
+#define LZ_NIBBLE 15
+#define LZ_HASH_BITS 12
+
+/**
+ * Hash the LZ_MINMATCH bytes at a position
+ */
+static inline uint32_t lz_hash(uint8_t const *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * Write extended length bytes
+ *
+ * @return: Next output byte, NULL if output is full
+ */
+static uint8_t *lz_put_len(uint8_t *op, uint8_t const *oend, size_t len)
+{
+	for(; len >= 255; len -= 255) {
+		if(op >= oend)
+			return NULL;
+		*op++ = 255;
+	}
+
+	if(op >= oend)
+		return NULL;
+	*op++ = len;
+
+	return op;
+}
+
+/**
+ * Write a sequence, a zero match length ends the block
+ *
+ * @return: Next output byte, NULL if output is full
+ */
+static uint8_t *lz_put_seq(uint8_t *op, uint8_t const *oend,
+		uint8_t const *lit, size_t nlit, size_t off, size_t mlen)
+{
+	uint8_t *tok;
+
+	if(op >= oend)
+		return NULL;
+
+	tok = op++;
+	*tok = ((nlit < LZ_NIBBLE) ? nlit : LZ_NIBBLE) << 4;
+	if(nlit >= LZ_NIBBLE) {
+		op = lz_put_len(op, oend, nlit - LZ_NIBBLE);
+		if(op == NULL)
+			return NULL;
+	}
+
+	if((size_t)(oend - op) < nlit)
+		return NULL;
+	memcpy(op, lit, nlit);
+	op += nlit;
+
+	if(mlen == 0)
+		return op;
+
+	mlen -= LZ_MINMATCH;
+	*tok |= (mlen < LZ_NIBBLE) ? mlen : LZ_NIBBLE;
+
+	if(oend - op < 2)
+		return NULL;
+	*op++ = off & 0xff;
+	*op++ = off >> 8;
+
+	if(mlen >= LZ_NIBBLE)
+		op = lz_put_len(op, oend, mlen - LZ_NIBBLE);
+
+	return op;
+}
+
+/**
+ * Compress a block
+ *
+ * @param src: Data to compress
+ * @param len: Data size
+ * @param dst: Compressed block
+ * @param dlen: Compressed block buffer size
+ *
+ * @return: Compressed block size, 0 if it does not fit in buffer
+ */
+size_t lz_compress(uint8_t const *src, size_t len, uint8_t *dst,
+		size_t dlen)
+{
+	/* Last position + 1 of each hashed sequence, 0 if none */
+	size_t tbl[1 << LZ_HASH_BITS];
+	uint8_t const *ip = src, *anchor = src, *iend = src + len, *ref;
+	uint8_t *op = dst;
+	size_t mlen, pos;
+	uint32_t h;
+
+	memset(tbl, 0, sizeof(tbl));
+
+	while(iend - ip >= LZ_MINMATCH) {
+		h = lz_hash(ip);
+		pos = tbl[h];
+		tbl[h] = ip - src + 1;
+
+		ref = src + pos - 1;
+		if((pos == 0) || (ip - ref > LZ_MAXOFF) ||
+				(memcmp(ref, ip, LZ_MINMATCH) != 0)) {
+			++ip;
+			continue;
+		}
+
+		for(mlen = LZ_MINMATCH; (ip + mlen < iend) &&
+				(ref[mlen] == ip[mlen]); ++mlen)
+			;
+
+		op = lz_put_seq(op, dst + dlen, anchor, ip - anchor, ip - ref,
+				mlen);
+		if(op == NULL)
+			return 0;
+
+		ip += mlen;
+		anchor = ip;
+	}
+
+	op = lz_put_seq(op, dst + dlen, anchor, iend - anchor, 0, 0);
+	if(op == NULL)
+		return 0;
+
+	return op - dst;
+}
+
+/**
+ * Read extended length bytes
+ *
+ * @return: Next input byte, NULL if input is truncated
+ */
+static uint8_t const *lz_get_len(uint8_t const *ip, uint8_t const *iend,
+		size_t *len)
+{
+	uint8_t b;
+
+	do {
+		if(ip >= iend)
+			return NULL;
+		b = *ip++;
+		*len += b;
+	} while(b == 255);
+
+	return ip;
+}
+
+/**
+ * Decompress a block
+ *
+ * @param src: Compressed block
+ * @param len: Compressed block size
+ * @param dst: Decompressed data
+ * @param dlen: Expected decompressed data size
+ *
+ * @return: 0 on success, negative number if block is malformed
+ */
+int lz_decompress(uint8_t const *src, size_t len, uint8_t *dst, size_t dlen)
+{
+	uint8_t const *ip = src, *iend = src + len;
+	uint8_t *op = dst, *oend = dst + dlen;
+	size_t nlit, mlen, off, i;
+	uint8_t tok;
+
+	while(ip < iend) {
+		tok = *ip++;
+
+		nlit = tok >> 4;
+		if((nlit == LZ_NIBBLE) &&
+				((ip = lz_get_len(ip, iend, &nlit)) == NULL))
+			return -EINVAL;
+
+		if((nlit > (size_t)(iend - ip)) ||
+				(nlit > (size_t)(oend - op)))
+			return -EINVAL;
+		memcpy(op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+
+		/* Last sequence */
+		if(ip == iend)
+			break;
+
+		if(iend - ip < 2)
+			return -EINVAL;
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		mlen = tok & LZ_NIBBLE;
+		if((mlen == LZ_NIBBLE) &&
+				((ip = lz_get_len(ip, iend, &mlen)) == NULL))
+			return -EINVAL;
+		mlen += LZ_MINMATCH;
+
+		if((off == 0) || (off > (size_t)(op - dst)) ||
+				(mlen > (size_t)(oend - op)))
+			return -EINVAL;
+
+		/* Match can overlap output, copy byte by byte */
+		for(i = 0; i < mlen; ++i)
+			op[i] = op[i - off];
+		op += mlen;
+	}
+
+	return (op == oend) ? 0 : -EINVAL;
+}
@@ -0,0 +1,8 @@
+#ifndef _DEV_MEM_LZ_H_
+#define _DEV_MEM_LZ_H_
+
+size_t lz_compress(uint8_t const *src, size_t len, uint8_t *dst,
+		size_t dlen);
+int lz_decompress(uint8_t const *src, size_t len, uint8_t *dst, size_t dlen);
+
+#endif
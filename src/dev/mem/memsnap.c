@@ -0,0 +1,442 @@
+/*
+ * Snapshots of mmap()ed memory. Memory content is saved into an in-memory
+ * file that is mapped private over the memory on restore, so that a restore
+ * only drops pages written since and the memory stays at the same host
+ * address.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/mman.h>
+
+#include "memsnap.h"
+
+/* Number of pages probed at once for residency */
+#define MEMSNAP_BATCH 256
+/* Buffer size used to copy a snapshot */
+#define MEMSNAP_COPYSZ 4096
+/* Page map entry bits of a page present in memory or swapped out */
+#define PAGEMAP_PRESENT ((uint64_t)1 << 63)
+#define PAGEMAP_SWAPPED ((uint64_t)1 << 62)
+
+struct memsnap {
+	/* In-memory file holding memory content */
+	int fd;
+	/* Saved memory size */
+	size_t sz;
+};
+
+/**
+ * Check if a memory range is only made of zero
+ */
+static inline int memsnap_is_zero(uint8_t const *mem, size_t sz)
+{
+	size_t i;
+
+	for(i = 0; i < sz; ++i)
+		if(mem[i] != 0)
+			return 0;
+
+	return 1;
+}
+
+/**
+ * Write a whole buffer into file at given offset
+ */
+static int memsnap_pwrite(int fd, uint8_t const *buf, size_t len, off_t off)
+{
+	ssize_t sz;
+
+	for(; len != 0; len -= sz, buf += sz, off += sz) {
+		sz = pwrite(fd, buf, len, off);
+		if(sz < 0) {
+			if(errno == EINTR)
+				sz = 0;
+			else
+				return -errno;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Allocate an empty snapshot
+ *
+ * @param sz: Memory size
+ * @param snap: Set to newly allocated snapshot
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int memsnap_alloc(size_t sz, struct memsnap **snap)
+{
+	struct memsnap *ms;
+	int ret = -ENOMEM;
+
+	ms = malloc(sizeof(*ms));
+	if(ms == NULL)
+		goto err;
+
+	ms->sz = sz;
+	ms->fd = memfd_create("sporc-snapshot", MFD_CLOEXEC);
+	if(ms->fd < 0) {
+		ret = -errno;
+		goto free;
+	}
+
+	if(ftruncate(ms->fd, sz) != 0) {
+		ret = -errno;
+		goto close;
+	}
+
+	*snap = ms;
+	return 0;
+
+close:
+	close(ms->fd);
+free:
+	free(ms);
+err:
+	return ret;
+}
+
+/**
+ * Save a memory range into snapshot, one page at a time. Zero pages are left
+ * as holes in the snapshot file.
+ *
+ * @param ms: Snapshot to save into
+ * @param mem: Saved memory start
+ * @param off: Saved range offset, page aligned
+ * @param len: Saved range size
+ * @param punch: Snapshot may already hold data over range
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int memsnap_save(struct memsnap *ms, uint8_t const *mem, size_t off,
+		size_t len, int punch)
+{
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	size_t end = off + len, n;
+	int ret;
+
+	for(; off < end; off += n) {
+		n = end - off;
+		if(n > pgsz)
+			n = pgsz;
+
+		if(!memsnap_is_zero(mem + off, n)) {
+			ret = memsnap_pwrite(ms->fd, mem + off, n, off);
+			if(ret != 0)
+				return ret;
+			continue;
+		}
+
+		if(punch && (fallocate(ms->fd, FALLOC_FL_PUNCH_HOLE |
+					FALLOC_FL_KEEP_SIZE, off, n) != 0))
+			return -errno;
+	}
+
+	return 0;
+}
+
+/**
+ * Copy all data held by another snapshot, skipping its holes
+ *
+ * @param ms: Snapshot to copy into
+ * @param base: Snapshot to copy from
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int memsnap_copy(struct memsnap *ms, struct memsnap const *base)
+{
+	uint8_t buf[MEMSNAP_COPYSZ];
+	off_t off = 0, end;
+	size_t n;
+	int ret;
+
+	if(base->sz != ms->sz)
+		return -EINVAL;
+
+	for(;;) {
+		off = lseek(base->fd, off, SEEK_DATA);
+		if(off < 0)
+			return (errno == ENXIO) ? 0 : -errno;
+		end = lseek(base->fd, off, SEEK_HOLE);
+		if(end < 0)
+			return -errno;
+
+		for(; off < end; off += n) {
+			n = end - off;
+			if(n > sizeof(buf))
+				n = sizeof(buf);
+			ret = memsnap_read(base, off, buf, n);
+			if(ret != 0)
+				return ret;
+			ret = memsnap_pwrite(ms->fd, buf, n, off);
+			if(ret != 0)
+				return ret;
+		}
+	}
+}
+
+/**
+ * Save memory content. Zero pages are left as holes in the snapshot file.
+ *
+ * @param mem: Page aligned memory to save
+ * @param sz: Memory size
+ * @param len: Number of bytes that can be read from memory start, rounded up
+ * to a page. The remaining ones are saved as zero
+ * @param snap: Set to newly allocated snapshot
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int memsnap_take(uint8_t *mem, size_t sz, size_t len, void **snap)
+{
+	struct memsnap *ms;
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	int ret;
+
+	ret = memsnap_alloc(sz, &ms);
+	if(ret != 0)
+		return ret;
+
+	len = (len + pgsz - 1) & ~(pgsz - 1);
+	if(len > sz)
+		len = sz;
+
+	ret = memsnap_save(ms, mem, 0, len, 0);
+	if(ret != 0) {
+		memsnap_free(ms);
+		return ret;
+	}
+
+	*snap = ms;
+	return 0;
+}
+
+/**
+ * Save anonymous memory content, only reading pages that are present in
+ * memory or swapped out. The other ones have never been touched, they are
+ * either zero or, if memory has been restored since, unchanged from the
+ * restored snapshot.
+ *
+ * @param mem: Page aligned anonymous memory to save
+ * @param sz: Memory size
+ * @param base: Snapshot memory has last been restored from, NULL if none
+ * @param snap: Set to newly allocated snapshot
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int memsnap_take_resident(uint8_t *mem, size_t sz, void const *base,
+		void **snap)
+{
+	uint64_t pm[MEMSNAP_BATCH];
+	struct memsnap *ms;
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	size_t off, blen, nr, pg, n;
+	off_t pmoff;
+	int fd, ret;
+
+	/* Residency cannot be known, read every page */
+	fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return memsnap_take(mem, sz, sz, snap);
+
+	ret = memsnap_alloc(sz, &ms);
+	if(ret != 0)
+		goto close;
+
+	if(base != NULL) {
+		ret = memsnap_copy(ms, base);
+		if(ret != 0)
+			goto free;
+	}
+
+	for(off = 0; off < sz; off += blen) {
+		blen = sz - off;
+		if(blen > MEMSNAP_BATCH * pgsz)
+			blen = MEMSNAP_BATCH * pgsz;
+		nr = (blen + pgsz - 1) / pgsz;
+
+		pmoff = (uintptr_t)(mem + off) / pgsz * sizeof(*pm);
+		if(pread(fd, pm, nr * sizeof(*pm), pmoff) !=
+				(ssize_t)(nr * sizeof(*pm))) {
+			for(pg = 0; pg < nr; ++pg)
+				pm[pg] = PAGEMAP_PRESENT;
+		}
+
+		for(pg = 0; pg < nr; ++pg) {
+			if(!(pm[pg] & (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)))
+				continue;
+			n = blen - pg * pgsz;
+			if(n > pgsz)
+				n = pgsz;
+			ret = memsnap_save(ms, mem, off + pg * pgsz, n,
+					base != NULL);
+			if(ret != 0)
+				goto free;
+		}
+	}
+
+	*snap = ms;
+	ret = 0;
+	goto close;
+
+free:
+	memsnap_free(ms);
+close:
+	close(fd);
+	return ret;
+}
+
+/**
+ * Save memory pages set in a bitmap, the other ones are saved as zero
+ *
+ * @param mem: Page aligned memory to save
+ * @param sz: Memory size
+ * @param bm: Bitmap of pages to save, bit n % 64 of word n / 64 is set for
+ * page n
+ * @param shift: Bitmap page size shift
+ * @param snap: Set to newly allocated snapshot
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int memsnap_take_pages(uint8_t *mem, size_t sz, uint64_t const *bm,
+		unsigned int shift, void **snap)
+{
+	struct memsnap *ms;
+	size_t pgsz = (size_t)1 << shift;
+	size_t pg, off, n, nr = (sz + pgsz - 1) >> shift;
+	int ret;
+
+	ret = memsnap_alloc(sz, &ms);
+	if(ret != 0)
+		return ret;
+
+	for(pg = 0; pg < nr; ++pg) {
+		/* Skip whole empty bitmap words */
+		if((pg % 64 == 0) && (bm[pg / 64] == 0)) {
+			pg += 63;
+			continue;
+		}
+
+		if(!(bm[pg / 64] & ((uint64_t)1 << (pg % 64))))
+			continue;
+
+		off = pg << shift;
+		n = sz - off;
+		if(n > pgsz)
+			n = pgsz;
+		ret = memsnap_save(ms, mem, off, n, 0);
+		if(ret != 0) {
+			memsnap_free(ms);
+			return ret;
+		}
+	}
+
+	*snap = ms;
+	return 0;
+}
+
+/**
+ * Restore memory content, by mapping snapshot copy-on-write over it
+ *
+ * @param mem: Memory to restore
+ * @param sz: Memory size
+ * @param prot: Memory mapping protection
+ * @param snap: Snapshot to restore from
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int memsnap_restore(uint8_t *mem, size_t sz, int prot, void const *snap)
+{
+	struct memsnap const *ms = snap;
+	void *map;
+
+	if(sz != ms->sz)
+		return -EINVAL;
+
+	map = mmap(mem, sz, prot, MAP_PRIVATE | MAP_FIXED, ms->fd, 0);
+	if(map == MAP_FAILED)
+		return -errno;
+
+	return 0;
+}
+
+/**
+ * Get another handle on a snapshot, that can be freed independently
+ *
+ * @param snap: Snapshot to duplicate
+ *
+ * @return: New snapshot handle, NULL on error
+ */
+void *memsnap_dup(void const *snap)
+{
+	struct memsnap const *ms = snap;
+	struct memsnap *dup;
+
+	dup = malloc(sizeof(*dup));
+	if(dup == NULL)
+		return NULL;
+
+	dup->sz = ms->sz;
+	dup->fd = fcntl(ms->fd, F_DUPFD_CLOEXEC, 0);
+	if(dup->fd < 0) {
+		free(dup);
+		return NULL;
+	}
+
+	return dup;
+}
+
+/**
+ * Read saved memory content
+ *
+ * @param snap: Snapshot to read from
+ * @param off: Memory offset
+ * @param buf: Filled with saved content
+ * @param len: Number of bytes to read
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int memsnap_read(void const *snap, size_t off, uint8_t *buf, size_t len)
+{
+	struct memsnap const *ms = snap;
+	ssize_t sz;
+
+	if((off > ms->sz) || (len > ms->sz - off))
+		return -EINVAL;
+
+	for(; len != 0; len -= sz, buf += sz, off += sz) {
+		sz = pread(ms->fd, buf, len, off);
+		if(sz < 0) {
+			if(errno == EINTR)
+				sz = 0;
+			else
+				return -errno;
+		} else if(sz == 0) {
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Free a memory snapshot
+ *
+ * @param snap: Snapshot to free
+ */
+void memsnap_free(void *snap)
+{
+	struct memsnap *ms = snap;
+
+	close(ms->fd);
+	free(ms);
+}
@@ -0,0 +1,14 @@
+#ifndef _DEV_MEM_MEMSNAP_H_
+#define _DEV_MEM_MEMSNAP_H_
+
+int memsnap_take(uint8_t *mem, size_t sz, size_t len, void **snap);
+int memsnap_take_resident(uint8_t *mem, size_t sz, void const *base,
+		void **snap);
+int memsnap_take_pages(uint8_t *mem, size_t sz, uint64_t const *bm,
+		unsigned int shift, void **snap);
+int memsnap_restore(uint8_t *mem, size_t sz, int prot, void const *snap);
+void *memsnap_dup(void const *snap);
+int memsnap_read(void const *snap, size_t off, uint8_t *buf, size_t len);
+void memsnap_free(void *snap);
+
+#endif
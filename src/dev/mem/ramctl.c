@@ -1,49 +1,121 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <errno.h>
+#include <unistd.h>
 
+#include <sys/mman.h>
+
+#include "utils.h"
 #include "types.h"
 #include "dev/device.h"
 #include "dev/cfg/ramctl.h"
 
 #include "ramctl.h"
 
-#define RAMMAP_MAX 16
+/* Physical address space is 36 bits wide */
+#define RAM_ADDR_BITS 36
+#define RAM_PAGE_SHIFT 12
+#define RAM_PAGE_SZ ((phyaddr_t)1 << RAM_PAGE_SHIFT)
+#define RAM_PAGE_NR(a) (((a) >> RAM_PAGE_SHIFT) & (RAM_TBL_NR - 1))
+/* Each page table handles 2^12 pages, i.e. 16MB */
+#define RAM_TBL_SHIFT 12
+#define RAM_TBL_NR (1 << RAM_TBL_SHIFT)
+#define RAM_DIR_SHIFT (RAM_PAGE_SHIFT + RAM_TBL_SHIFT)
+#define RAM_DIR_NR (1 << (RAM_ADDR_BITS - RAM_DIR_SHIFT))
+#define RAM_DIR_NR_OF(a) ((a) >> RAM_DIR_SHIFT)
+#define RAM_SPACE_SZ ((phyaddr_t)1 << RAM_ADDR_BITS)
+#define RAM_PAGE_DOWN(a) ((a) & ~(RAM_PAGE_SZ - 1))
+#define RAM_PAGE_UP(a) RAM_PAGE_DOWN((a) + RAM_PAGE_SZ - 1)
+
+/*
+ * Check if a naturally aligned access can be directly done on the flat
+ * mirror of physical address space
+ */
+#define RAMFLAT_HAS(c, a, sz, p)					\
+	(((((a) & ((sz) - 1)) | ((a) >> RAM_ADDR_BITS)) == 0) &&	\
+	 ((c)->fperm[(a) >> RAM_PAGE_SHIFT] & (p)))
+#define RAMFLAT_PTR(c, a, t) ((t *)((c)->flat + (a)))
 
 struct ramdev_map {
 	/* Memory device */
 	struct ramdev *dev;
 	/* Physical map address */
 	phyaddr_t addr;
+	/* Physical map end address (first address after map) */
+	phyaddr_t end;
 	/* Permission for this map chunk */
 	perm_t perm;
+	/* Device memory has been moved into the flat mirror */
+	int mirrored;
 };
+#define RAMMAP_HAS(m, a, sz) (((m)->addr <= (a)) && ((a) + (sz) <= (m)->end))
+
+/*
+ * Page table entry for pages that are shared between several maps, these
+ * pages need a full map lookup.
+ */
+static struct ramdev_map ramdev_map_shared;
 
 struct ramctl {
 	/* Ram device */
 	struct dev dev;
+	/* Last map an access has been dispatched to */
+	struct ramdev_map *last;
+	/* Number of maps */
+	size_t nrmap;
 	/* Ram address maping to device array */
-	struct ramdev_map map[RAMMAP_MAX];
+	struct ramdev_map *map;
+	/* Lazily allocated page tables, giving the map handling a page */
+	struct ramdev_map **dir[RAM_DIR_NR];
+	/* Flat host mirror of physical address space, NULL if unused */
+	uint8_t *flat;
+	/* Per page operations that can directly access the flat mirror */
+	perm_t *fperm;
 };
 #define to_ramctl(d) (container_of(d, struct ramctl, dev))
 
-static inline struct ramdev_map *ramctl_get_map(struct dev *dev,
+/**
+ * Find map handling an address range on a page shared by several maps
+ */
+static struct ramdev_map *ramctl_find_map(struct ramctl *ctl,
 		phyaddr_t addr, size_t sz)
 {
-	struct ramdev_map *map = to_ramctl(dev)->map;
-	struct ramdev_map *ret = NULL;
 	size_t i;
 
-	for(i = 0; i < ARRAY_SIZE(to_ramctl(dev)->map); ++i) {
-		if(map[i].dev && map[i].addr <= addr &&
-				map[i].addr + map[i].dev->size >= addr + sz)
-		{
-			ret = &map[i];
-			break;
-		}
-	}
+	for(i = 0; i < ctl->nrmap; ++i)
+		if(RAMMAP_HAS(&ctl->map[i], addr, sz))
+			return &ctl->map[i];
+
+	return NULL;
+}
+
+static inline struct ramdev_map *ramctl_get_map(struct dev *dev,
+		phyaddr_t addr, size_t sz)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+	struct ramdev_map **tbl, *ret = ctl->last;
+
+	if((ret != NULL) && RAMMAP_HAS(ret, addr, sz))
+		return ret;
+
+	if(RAM_DIR_NR_OF(addr) >= RAM_DIR_NR)
+		return NULL;
+
+	tbl = ctl->dir[RAM_DIR_NR_OF(addr)];
+	if(tbl == NULL)
+		return NULL;
+
+	ret = tbl[RAM_PAGE_NR(addr)];
+	if(ret == &ramdev_map_shared)
+		ret = ramctl_find_map(ctl, addr, sz);
+	else if((ret != NULL) && !RAMMAP_HAS(ret, addr, sz))
+		ret = NULL;
+
+	if(ret != NULL)
+		ctl->last = ret;
 
 	return ret;
 }
@@ -105,6 +177,25 @@ static int ramctl_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
 	return mapdev->drv->phyops->read32(mapdev, addr - rd->addr, val);
 }
 
+static int ramctl_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	struct ramdev_map *rd = ramctl_get_map(dev, addr, 8);
+	struct dev *mapdev;
+
+	if(rd == NULL)
+		return -ENODEV;
+
+	mapdev = &rd->dev->dev;
+
+	if(!mapdev->drv->phyops->read64)
+		return -ENOSYS;
+
+	if(!(rd->perm & MP_R))
+		return -EACCES;
+
+	return mapdev->drv->phyops->read64(mapdev, addr - rd->addr, val);
+}
+
 static int ramctl_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
 {
 	struct ramdev_map *rd = ramctl_get_map(dev, addr, 1);
@@ -162,6 +253,100 @@ static int ramctl_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
 	return mapdev->drv->phyops->write32(mapdev, addr - rd->addr, val);
 }
 
+static int ramctl_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	struct ramdev_map *rd = ramctl_get_map(dev, addr, 8);
+	struct dev *mapdev;
+
+	if(rd == NULL)
+		return -ENODEV;
+
+	mapdev = &rd->dev->dev;
+
+	if(!mapdev->drv->phyops->write64)
+		return -ENOSYS;
+
+	if(!(rd->perm & MP_W))
+		return -EACCES;
+
+	return mapdev->drv->phyops->write64(mapdev, addr - rd->addr, val);
+}
+
+/**
+ * Copy a block of memory, that can be split across several contiguous maps
+ */
+static int ramctl_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct ramdev_map *rd;
+	struct dev *mapdev;
+	size_t sz;
+	int ret;
+
+	for(; len != 0; addr += sz, buf = (uint8_t *)buf + sz, len -= sz) {
+		rd = ramctl_get_map(dev, addr, 1);
+		if(rd == NULL)
+			return -ENODEV;
+
+		mapdev = &rd->dev->dev;
+
+		if(!mapdev->drv->phyops->read_block)
+			return -ENOSYS;
+
+		if(!(rd->perm & MP_R))
+			return -EACCES;
+
+		sz = len;
+		if(sz > rd->end - addr)
+			sz = rd->end - addr;
+
+		ret = mapdev->drv->phyops->read_block(mapdev, addr - rd->addr,
+				buf, sz);
+		if(ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory, that can be split across several contiguous maps
+ */
+static int ramctl_write_block(struct dev *dev, phyaddr_t addr,
+		void const *buf, size_t len)
+{
+	struct ramdev_map *rd;
+	struct dev *mapdev;
+	size_t sz;
+	int ret;
+
+	for(; len != 0; addr += sz, buf = (uint8_t const *)buf + sz,
+			len -= sz) {
+		rd = ramctl_get_map(dev, addr, 1);
+		if(rd == NULL)
+			return -ENODEV;
+
+		mapdev = &rd->dev->dev;
+
+		if(!mapdev->drv->phyops->write_block)
+			return -ENOSYS;
+
+		if(!(rd->perm & MP_W))
+			return -EACCES;
+
+		sz = len;
+		if(sz > rd->end - addr)
+			sz = rd->end - addr;
+
+		ret = mapdev->drv->phyops->write_block(mapdev, addr - rd->addr,
+				buf, sz);
+		if(ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int ramctl_fetch_isn8(struct dev *dev, phyaddr_t addr, uint8_t *val)
 {
 	struct ramdev_map *rd = ramctl_get_map(dev, addr, 1);
@@ -219,10 +404,68 @@ static int ramctl_fetch_isn32(struct dev *dev, phyaddr_t addr, uint32_t *val)
 	return mapdev->drv->phyops->fetch_isn32(mapdev, addr - rd->addr, val);
 }
 
+static int ramctl_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct ramdev_map *rd = ramctl_get_map(dev, addr, 1);
+	struct dev *mapdev;
+	int ret;
+
+	if(rd == NULL)
+		return -ENODEV;
+
+	mapdev = &rd->dev->dev;
+
+	if(!mapdev->drv->phyops->hostmem)
+		return -ENOSYS;
+
+	ret = mapdev->drv->phyops->hostmem(mapdev, addr - rd->addr, hm);
+	if(ret != 0)
+		return ret;
+
+	/* Convert range to controller addresses, with map permissions */
+	hm->addr += rd->addr;
+	hm->perm &= rd->perm;
+
+	return 0;
+}
+
+/**
+ * Register a map in page tables
+ *
+ * @param ctl: RAM controller
+ * @param map: Map to register
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int ram_map_pages(struct ramctl *ctl, struct ramdev_map *map)
+{
+	struct ramdev_map ***tbl;
+	phyaddr_t pg;
+
+	for(pg = map->addr & ~(RAM_PAGE_SZ - 1); pg < map->end;
+			pg += RAM_PAGE_SZ) {
+		tbl = &ctl->dir[RAM_DIR_NR_OF(pg)];
+		if(*tbl == NULL) {
+			*tbl = calloc(RAM_TBL_NR, sizeof(**tbl));
+			if(*tbl == NULL)
+				return -ENOMEM;
+		}
+
+		if((*tbl)[RAM_PAGE_NR(pg)] == NULL)
+			(*tbl)[RAM_PAGE_NR(pg)] = map;
+		else
+			(*tbl)[RAM_PAGE_NR(pg)] = &ramdev_map_shared;
+	}
+
+	return 0;
+}
+
 static int ram_map(struct ramctl *ctl, struct rammap const *map)
 {
 	struct ramdev *mapdev;
 	struct dev *dev;
+	phyaddr_t end;
 	size_t i;
 
 	/* Get map'ed memory handling device */
@@ -235,26 +478,38 @@ static int ram_map(struct ramctl *ctl, struct rammap const *map)
 	if((mapdev->perm & map->perm) != map->perm)
 		return -EACCES;
 
-	/* Find an empty map */
-	for(i = 0; i < ARRAY_SIZE(ctl->map); ++i)
-		if(ctl->map[i].dev == NULL)
-			break;
+	end = (phyaddr_t)map->addr + mapdev->size;
+	if(end > ((phyaddr_t)1 << RAM_ADDR_BITS))
+		return -EINVAL;
 
-	/* No more free map */
-	if(i == ARRAY_SIZE(ctl->map))
-		return -ENOMEM;
+	/* Maps cannot overlap */
+	for(i = 0; i < ctl->nrmap; ++i)
+		if((ctl->map[i].addr < end) && (map->addr < ctl->map[i].end))
+			return -EINVAL;
 
 	/* Fill ram device map infos */
 	ctl->map[i].dev = mapdev;
 	ctl->map[i].addr = map->addr;
+	ctl->map[i].end = end;
 	ctl->map[i].perm = map->perm;
+	++ctl->nrmap;
 
-	return 0;
+	return ram_map_pages(ctl, &ctl->map[i]);
 }
 
-static void ram_unmap(struct ramctl *ctl, size_t mapid)
+/**
+ * Release RAM controller maps and page tables
+ *
+ * @param ctl: RAM controller to clean
+ */
+static void ram_unmap_all(struct ramctl *ctl)
 {
-	ctl->map[mapid].dev = NULL;
+	size_t i;
+
+	for(i = 0; i < ARRAY_SIZE(ctl->dir); ++i)
+		free(ctl->dir[i]);
+
+	free(ctl->map);
 }
 
 /**
@@ -270,6 +525,7 @@ static int ramctl_create(struct dev **dev, struct devcfg const *cfg)
 	struct ramctl *ctl;
 	struct ramctl_cfg const *rcfg = (struct ramctl_cfg const*)cfg->cfg;
 	struct rammap *map;
+	size_t nr = 0;
 	int ret = -ENOMEM;
 
 	*dev = NULL;
@@ -278,6 +534,13 @@ static int ramctl_create(struct dev **dev, struct devcfg const *cfg)
 	if(ctl == NULL)
 		goto err;
 
+	for(map = rcfg->devlst; map->devname != NULL; ++map)
+		++nr;
+
+	ctl->map = calloc(nr, sizeof(*ctl->map));
+	if((ctl->map == NULL) && (nr != 0))
+		goto err;
+
 	for(map = rcfg->devlst; map->devname != NULL; ++map) {
 		ret = ram_map(ctl, map);
 		if(ret != 0)
@@ -288,8 +551,10 @@ static int ramctl_create(struct dev **dev, struct devcfg const *cfg)
 
 	return 0;
 err:
-	if(ctl)
+	if(ctl) {
+		ram_unmap_all(ctl);
 		free(ctl);
+	}
 	return ret;
 }
 
@@ -301,12 +566,8 @@ err:
 static void ramctl_destroy(struct dev *dev)
 {
 	struct ramctl *ctl = to_ramctl(dev);
-	size_t i;
-
-	for(i = 0; i < ARRAY_SIZE(ctl->map); ++i)
-		if(ctl->map[i].dev == NULL)
-			ram_unmap(ctl, i);
 
+	ram_unmap_all(ctl);
 	free(ctl);
 }
 
@@ -316,12 +577,17 @@ static struct phydevops const ramctlops = {
 	.read8 = ramctl_read8,
 	.read16 = ramctl_read16,
 	.read32 = ramctl_read32,
+	.read64 = ramctl_read64,
 	.write8 = ramctl_write8,
 	.write16 = ramctl_write16,
 	.write32 = ramctl_write32,
+	.write64 = ramctl_write64,
+	.read_block = ramctl_read_block,
+	.write_block = ramctl_write_block,
 	.fetch_isn8 = ramctl_fetch_isn8,
 	.fetch_isn16 = ramctl_fetch_isn16,
 	.fetch_isn32 = ramctl_fetch_isn32,
+	.hostmem = ramctl_hostmem,
 };
 
 static struct drv const ram = {
@@ -330,3 +596,397 @@ static struct drv const ram = {
 };
 
 DRIVER_REGISTER(ram);
+
+/**
+ * Move a memory device host mapping to another host address, the old
+ * mapping is released. Mappings made of several host areas (e.g. partially
+ * file backed) are moved one page at a time.
+ *
+ * @param mem: Host mapping to move, page aligned
+ * @param sz: Host mapping size
+ * @param host: New page aligned host address
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int ramdev_move(uint8_t *mem, size_t sz, uint8_t *host)
+{
+	size_t pgsz = RAM_PAGE_SZ, off;
+	void *p;
+
+	sz = RAM_PAGE_UP(sz);
+	p = mremap(mem, sz, sz, MREMAP_MAYMOVE | MREMAP_FIXED, host);
+	if(p != MAP_FAILED)
+		return 0;
+	if(errno != EFAULT)
+		return -errno;
+
+	for(off = 0; off < sz; off += pgsz) {
+		p = mremap(mem + off, pgsz, pgsz, MREMAP_MAYMOVE |
+				MREMAP_FIXED, host + off);
+		if(p == MAP_FAILED)
+			goto err;
+	}
+
+	return 0;
+err:
+	/* Put already moved pages back where they were */
+	while(off != 0) {
+		off -= pgsz;
+		mremap(host + off, pgsz, pgsz, MREMAP_MAYMOVE | MREMAP_FIXED,
+				mem + off);
+	}
+	return -ENOMEM;
+}
+
+/**
+ * Check if a range can be directly accessed on the flat mirror
+ */
+static inline int ramflat_has_range(struct ramctl *ctl, phyaddr_t addr,
+		size_t len, perm_t perm)
+{
+	phyaddr_t pg;
+
+	if((len == 0) || (addr >= RAM_SPACE_SZ) ||
+			(len > RAM_SPACE_SZ - addr))
+		return 0;
+
+	for(pg = RAM_PAGE_DOWN(addr); pg < addr + len; pg += RAM_PAGE_SZ)
+		if(!(ctl->fperm[pg >> RAM_PAGE_SHIFT] & perm))
+			return 0;
+
+	return 1;
+}
+
+static int ramflat_read8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 1, MP_R))
+		return ramctl_read8(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint8_t);
+	return 0;
+}
+
+static int ramflat_read16(struct dev *dev, phyaddr_t addr, uint16_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 2, MP_R))
+		return ramctl_read16(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint16_t);
+	return 0;
+}
+
+static int ramflat_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 4, MP_R))
+		return ramctl_read32(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint32_t);
+	return 0;
+}
+
+static int ramflat_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 8, MP_R))
+		return ramctl_read64(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint64_t);
+	return 0;
+}
+
+static int ramflat_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 1, MP_W))
+		return ramctl_write8(dev, addr, val);
+
+	*RAMFLAT_PTR(ctl, addr, uint8_t) = val;
+	return 0;
+}
+
+static int ramflat_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 2, MP_W))
+		return ramctl_write16(dev, addr, val);
+
+	*RAMFLAT_PTR(ctl, addr, uint16_t) = val;
+	return 0;
+}
+
+static int ramflat_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 4, MP_W))
+		return ramctl_write32(dev, addr, val);
+
+	*RAMFLAT_PTR(ctl, addr, uint32_t) = val;
+	return 0;
+}
+
+static int ramflat_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 8, MP_W))
+		return ramctl_write64(dev, addr, val);
+
+	*RAMFLAT_PTR(ctl, addr, uint64_t) = val;
+	return 0;
+}
+
+static int ramflat_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!ramflat_has_range(ctl, addr, len, MP_R))
+		return ramctl_read_block(dev, addr, buf, len);
+
+	memcpy(buf, ctl->flat + addr, len);
+	return 0;
+}
+
+static int ramflat_write_block(struct dev *dev, phyaddr_t addr,
+		void const *buf, size_t len)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!ramflat_has_range(ctl, addr, len, MP_W))
+		return ramctl_write_block(dev, addr, buf, len);
+
+	memcpy(ctl->flat + addr, buf, len);
+	return 0;
+}
+
+static int ramflat_fetch_isn8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 1, MP_X))
+		return ramctl_fetch_isn8(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint8_t);
+	return 0;
+}
+
+static int ramflat_fetch_isn16(struct dev *dev, phyaddr_t addr,
+		uint16_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 2, MP_X))
+		return ramctl_fetch_isn16(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint16_t);
+	return 0;
+}
+
+static int ramflat_fetch_isn32(struct dev *dev, phyaddr_t addr,
+		uint32_t *val)
+{
+	struct ramctl *ctl = to_ramctl(dev);
+
+	if(!RAMFLAT_HAS(ctl, addr, 4, MP_X))
+		return ramctl_fetch_isn32(dev, addr, val);
+
+	*val = *RAMFLAT_PTR(ctl, addr, uint32_t);
+	return 0;
+}
+
+/**
+ * Find host space available for a map in the flat mirror, up to the next
+ * map page
+ */
+static phyaddr_t ramflat_room(struct ramctl *ctl, struct ramdev_map *map)
+{
+	phyaddr_t end = RAM_SPACE_SZ;
+	size_t i;
+
+	for(i = 0; i < ctl->nrmap; ++i)
+		if((ctl->map[i].addr >= map->end) &&
+				(RAM_PAGE_DOWN(ctl->map[i].addr) < end))
+			end = RAM_PAGE_DOWN(ctl->map[i].addr);
+
+	return (end > map->addr) ? end - map->addr : 0;
+}
+
+/**
+ * Move a map device memory into the flat mirror and allow direct accesses
+ * to its pages that are entirely backed by host memory. Maps that cannot
+ * be moved are still accessible through the controller slow path.
+ *
+ * @param ctl: RAM controller
+ * @param map: Map to mirror
+ */
+static void ramflat_map(struct ramctl *ctl, struct ramdev_map *map)
+{
+	struct dev *mapdev = &map->dev->dev;
+	struct dev_hostmem hm;
+	phyaddr_t addr, pg, end;
+
+	if((map->addr & (RAM_PAGE_SZ - 1)) ||
+			(mapdev->drv->phyops->relocate == NULL))
+		return;
+
+	if(mapdev->drv->phyops->relocate(mapdev, ctl->flat + map->addr,
+				ramflat_room(ctl, map)) != 0)
+		return;
+
+	map->mirrored = 1;
+
+	for(addr = map->addr; addr < map->end; addr = hm.addr + hm.sz) {
+		if(ramctl_hostmem(&ctl->dev, addr, &hm) != 0)
+			break;
+
+		/* Host memory has to be the flat mirror itself */
+		if(hm.host != ctl->flat + hm.addr)
+			continue;
+
+		end = hm.addr + hm.sz;
+		if(end > map->end)
+			end = map->end;
+
+		for(pg = RAM_PAGE_UP(hm.addr); pg + RAM_PAGE_SZ <= end;
+				pg += RAM_PAGE_SZ)
+			ctl->fperm[pg >> RAM_PAGE_SHIFT] = hm.perm;
+	}
+}
+
+/**
+ * Release flat mirror parts that are not owned by memory devices
+ *
+ * @param ctl: RAM controller
+ */
+static void ramflat_unmap(struct ramctl *ctl)
+{
+	struct ramdev_map *next;
+	phyaddr_t addr = 0;
+	size_t i;
+
+	if(ctl->fperm != NULL)
+		munmap(ctl->fperm, RAM_SPACE_SZ >> RAM_PAGE_SHIFT);
+
+	if(ctl->flat == NULL)
+		return;
+
+	/* Mirrored memory is released by its own device */
+	for(;;) {
+		next = NULL;
+		for(i = 0; i < ctl->nrmap; ++i)
+			if(ctl->map[i].mirrored && (ctl->map[i].addr >= addr) &&
+					((next == NULL) ||
+					 (ctl->map[i].addr < next->addr)))
+				next = &ctl->map[i];
+
+		if(next == NULL)
+			break;
+
+		if(next->addr != addr)
+			munmap(ctl->flat + addr, next->addr - addr);
+		addr = RAM_PAGE_UP(next->end);
+	}
+
+	if(addr < RAM_SPACE_SZ)
+		munmap(ctl->flat + addr, RAM_SPACE_SZ - addr);
+}
+
+/**
+ * Create a new RAM controller, with memory devices moved in a flat host
+ * mirror of physical address space
+ *
+ * @param dev: Newly created device
+ * @param cfg: device configuration
+ *
+ * @return: 0 on success, negative error otherwise
+ */
+static int ramflat_create(struct dev **dev, struct devcfg const *cfg)
+{
+	struct ramctl *ctl;
+	size_t i;
+	int ret;
+
+	ret = ramctl_create(dev, cfg);
+	if(ret != 0)
+		return ret;
+
+	ctl = to_ramctl(*dev);
+
+	/* Unmapped and non RAM pages stay inaccessible */
+	ret = -ENOMEM;
+	ctl->flat = mmap(NULL, RAM_SPACE_SZ, PROT_NONE, MAP_PRIVATE |
+			MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(ctl->flat == MAP_FAILED) {
+		ctl->flat = NULL;
+		goto err;
+	}
+
+	ctl->fperm = mmap(NULL, RAM_SPACE_SZ >> RAM_PAGE_SHIFT,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS |
+			MAP_NORESERVE, -1, 0);
+	if(ctl->fperm == MAP_FAILED) {
+		ctl->fperm = NULL;
+		goto err;
+	}
+
+	/* Device memory can only be moved with host page granularity */
+	if((phyaddr_t)sysconf(_SC_PAGESIZE) != RAM_PAGE_SZ)
+		return 0;
+
+	for(i = 0; i < ctl->nrmap; ++i)
+		ramflat_map(ctl, &ctl->map[i]);
+
+	return 0;
+err:
+	ramflat_unmap(ctl);
+	ramctl_destroy(*dev);
+	*dev = NULL;
+	return ret;
+}
+
+/**
+ * Destroy a flat RAM controller device
+ *
+ * @param dev: To be freed device
+ */
+static void ramflat_destroy(struct dev *dev)
+{
+	ramflat_unmap(to_ramctl(dev));
+	ramctl_destroy(dev);
+}
+
+static struct phydevops const ramflatops = {
+	.create = ramflat_create,
+	.destroy = ramflat_destroy,
+	.read8 = ramflat_read8,
+	.read16 = ramflat_read16,
+	.read32 = ramflat_read32,
+	.read64 = ramflat_read64,
+	.write8 = ramflat_write8,
+	.write16 = ramflat_write16,
+	.write32 = ramflat_write32,
+	.write64 = ramflat_write64,
+	.read_block = ramflat_read_block,
+	.write_block = ramflat_write_block,
+	.fetch_isn8 = ramflat_fetch_isn8,
+	.fetch_isn16 = ramflat_fetch_isn16,
+	.fetch_isn32 = ramflat_fetch_isn32,
+	.hostmem = ramctl_hostmem,
+};
+
+static struct drv const ramflat = {
+	.name = "ramctl-flat",
+	.phyops = &ramflatops,
+};
+
+DRIVER_REGISTER(ramflat);
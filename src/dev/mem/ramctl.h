@@ -11,4 +11,6 @@ struct ramdev {
 };
 #define to_ramdev(d) (container_of(d, struct ramdev, dev))
 
+int ramdev_move(uint8_t *mem, size_t sz, uint8_t *host);
+
 #endif
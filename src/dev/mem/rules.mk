@@ -1,3 +1,3 @@
 BUNDLE = b-sporc
 
-b-sporc-CSRC = ramctl.c file.c
+b-sporc-CSRC = ramctl.c file.c anon.c elf.c sparse.c memsnap.c zimg.c lz.c
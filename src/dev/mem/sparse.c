@@ -0,0 +1,470 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/sparsemem.h"
+
+#include "ramctl.h"
+
+/*
+ * Sparse memory is split in chunks that are only allocated when first
+ * written. Chunks are found through a two level page directory, whose tables
+ * are allocated lazily as well. Reading an untouched chunk returns zero
+ * without allocating anything so that host memory usage follows the guest
+ * working set.
+ */
+#define SMEM_CHUNK_SHIFT 16
+#define SMEM_CHUNK_SZ ((size_t)1 << SMEM_CHUNK_SHIFT)
+#define SMEM_CHUNK_MASK (SMEM_CHUNK_SZ - 1)
+#define SMEM_CHUNK_OFF(a) ((size_t)((a) & SMEM_CHUNK_MASK))
+#define SMEM_CHUNK_ADDR(a) ((a) & ~(phyaddr_t)SMEM_CHUNK_MASK)
+#define SMEM_CHUNK_NR(a) (((a) >> SMEM_CHUNK_SHIFT) & (SMEM_TBL_NR - 1))
+#define SMEM_TBL_SHIFT 12
+#define SMEM_TBL_NR (1 << SMEM_TBL_SHIFT)
+#define SMEM_DIR_SHIFT (SMEM_CHUNK_SHIFT + SMEM_TBL_SHIFT)
+#define SMEM_DIR_NR_OF(a) ((a) >> SMEM_DIR_SHIFT)
+
+struct sparsemem {
+	/* Ramctl device */
+	struct ramdev ramdev;
+	/* Number of page directory entries */
+	size_t nrdir;
+	/* Page directory, each table holds SMEM_TBL_NR chunks */
+	uint8_t ***dir;
+};
+#define to_sparsemem(m) (container_of(to_ramdev(m), struct sparsemem, ramdev))
+
+#define SMEM_BYTE(mem, off) (*((uint8_t *)((mem) + (off))))
+#define SMEM_HALF(mem, off) (*((uint16_t *)((mem) + (off))))
+#define SMEM_WORD(mem, off) (*((uint32_t *)((mem) + (off))))
+#define SMEM_DWORD(mem, off) (*((uint64_t *)((mem) + (off))))
+
+/**
+ * Get the chunk an address belongs to
+ *
+ * @param sm: Sparse memory device
+ * @param addr: Device address
+ *
+ * @return: Chunk host memory, NULL if chunk has never been written
+ */
+static inline uint8_t *smem_chunk(struct sparsemem *sm, phyaddr_t addr)
+{
+	uint8_t **tbl = sm->dir[SMEM_DIR_NR_OF(addr)];
+
+	if(tbl == NULL)
+		return NULL;
+	return tbl[SMEM_CHUNK_NR(addr)];
+}
+
+/**
+ * Get the chunk an address belongs to, allocating it if needed
+ *
+ * @param sm: Sparse memory device
+ * @param addr: Device address
+ *
+ * @return: Chunk host memory, NULL if it could not be allocated
+ */
+static uint8_t *smem_chunk_alloc(struct sparsemem *sm, phyaddr_t addr)
+{
+	uint8_t ***tbl = &sm->dir[SMEM_DIR_NR_OF(addr)];
+	uint8_t **chunk;
+
+	if(*tbl == NULL) {
+		*tbl = calloc(SMEM_TBL_NR, sizeof(**tbl));
+		if(*tbl == NULL)
+			return NULL;
+	}
+
+	chunk = &(*tbl)[SMEM_CHUNK_NR(addr)];
+	if(*chunk == NULL)
+		*chunk = calloc(1, SMEM_CHUNK_SZ);
+
+	return *chunk;
+}
+
+/**
+ * Fetch a 8 bit value from memory
+ */
+static int smem_read8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	uint8_t *c = smem_chunk(to_sparsemem(dev), addr);
+
+	*val = (c == NULL) ? 0 : SMEM_BYTE(c, SMEM_CHUNK_OFF(addr));
+
+	return 0;
+}
+
+/**
+ * Fetch a 16 bit value from memory
+ */
+static int smem_read16(struct dev *dev, phyaddr_t addr, uint16_t *val)
+{
+	uint8_t *c = smem_chunk(to_sparsemem(dev), addr);
+
+	*val = (c == NULL) ? 0 : SMEM_HALF(c, SMEM_CHUNK_OFF(addr));
+
+	return 0;
+}
+
+/**
+ * Fetch a 32 bit value from memory
+ */
+static int smem_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
+{
+	uint8_t *c = smem_chunk(to_sparsemem(dev), addr);
+
+	*val = (c == NULL) ? 0 : SMEM_WORD(c, SMEM_CHUNK_OFF(addr));
+
+	return 0;
+}
+
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int smem_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	uint8_t *c = smem_chunk(to_sparsemem(dev), addr);
+
+	*val = (c == NULL) ? 0 : SMEM_DWORD(c, SMEM_CHUNK_OFF(addr));
+
+	return 0;
+}
+
+/**
+ * Write a 8 bit value into memory
+ */
+static int smem_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
+{
+	uint8_t *c = smem_chunk_alloc(to_sparsemem(dev), addr);
+
+	if(c == NULL)
+		return -ENOMEM;
+
+	SMEM_BYTE(c, SMEM_CHUNK_OFF(addr)) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 16 bit value into memory
+ */
+static int smem_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
+{
+	uint8_t *c = smem_chunk_alloc(to_sparsemem(dev), addr);
+
+	if(c == NULL)
+		return -ENOMEM;
+
+	SMEM_HALF(c, SMEM_CHUNK_OFF(addr)) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 32 bit value into memory
+ */
+static int smem_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
+{
+	uint8_t *c = smem_chunk_alloc(to_sparsemem(dev), addr);
+
+	if(c == NULL)
+		return -ENOMEM;
+
+	SMEM_WORD(c, SMEM_CHUNK_OFF(addr)) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 64 bit value into memory
+ */
+static int smem_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	uint8_t *c = smem_chunk_alloc(to_sparsemem(dev), addr);
+
+	if(c == NULL)
+		return -ENOMEM;
+
+	SMEM_DWORD(c, SMEM_CHUNK_OFF(addr)) = val;
+
+	return 0;
+}
+
+/**
+ * Copy a block of memory, untouched chunks read as zero
+ */
+static int smem_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	uint8_t *c, *b = buf;
+	size_t sz;
+
+	if((addr > sm->ramdev.size) || (len > sm->ramdev.size - addr))
+		return -EINVAL;
+
+	for(; len != 0; len -= sz, addr += sz, b += sz) {
+		sz = SMEM_CHUNK_SZ - SMEM_CHUNK_OFF(addr);
+		if(sz > len)
+			sz = len;
+		c = smem_chunk(sm, addr);
+		if(c == NULL)
+			memset(b, 0, sz);
+		else
+			memcpy(b, c + SMEM_CHUNK_OFF(addr), sz);
+	}
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory, allocating the chunks it spans
+ */
+static int smem_write_block(struct dev *dev, phyaddr_t addr, void const *buf,
+		size_t len)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	uint8_t const *b = buf;
+	uint8_t *c;
+	size_t sz;
+
+	if((addr > sm->ramdev.size) || (len > sm->ramdev.size - addr))
+		return -EINVAL;
+
+	for(; len != 0; len -= sz, addr += sz, b += sz) {
+		sz = SMEM_CHUNK_SZ - SMEM_CHUNK_OFF(addr);
+		if(sz > len)
+			sz = len;
+		c = smem_chunk_alloc(sm, addr);
+		if(c == NULL)
+			return -ENOMEM;
+		memcpy(c + SMEM_CHUNK_OFF(addr), b, sz);
+	}
+
+	return 0;
+}
+
+/**
+ * Get host memory backing the chunk an address belongs to. Untouched chunks
+ * have no host memory yet, they are accessed through device operations until
+ * first written so that reads do not allocate.
+ */
+static int smem_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	uint8_t *c;
+
+	if(addr >= sm->ramdev.size)
+		return -EINVAL;
+
+	c = smem_chunk(sm, addr);
+	if(c == NULL)
+		return -ENOENT;
+
+	hm->host = c;
+	hm->addr = SMEM_CHUNK_ADDR(addr);
+	hm->sz = SMEM_CHUNK_SZ;
+	if(hm->sz > sm->ramdev.size - hm->addr)
+		hm->sz = sm->ramdev.size - hm->addr;
+	hm->perm = sm->ramdev.perm;
+
+	return 0;
+}
+
+/* Saved sparse memory, chunk copies indexed like the page directory */
+struct smem_snap {
+	size_t nrdir;
+	uint8_t **dir[];
+};
+
+/**
+ * Free a sparse memory snapshot
+ */
+static void smem_snapshot_free(struct dev *dev, void *snap)
+{
+	struct smem_snap *s = snap;
+	size_t i, j;
+	(void)dev;
+
+	for(i = 0; i < s->nrdir; ++i) {
+		if(s->dir[i] == NULL)
+			continue;
+		for(j = 0; j < SMEM_TBL_NR; ++j)
+			free(s->dir[i][j]);
+		free(s->dir[i]);
+	}
+	free(s);
+}
+
+/**
+ * Save sparse memory content, only allocated chunks are copied
+ */
+static int smem_snapshot(struct dev *dev, void **snap)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	struct smem_snap *s;
+	size_t i, j;
+
+	s = calloc(1, sizeof(*s) + sm->nrdir * sizeof(*s->dir));
+	if(s == NULL)
+		return -ENOMEM;
+
+	s->nrdir = sm->nrdir;
+	for(i = 0; i < sm->nrdir; ++i) {
+		if(sm->dir[i] == NULL)
+			continue;
+		s->dir[i] = calloc(SMEM_TBL_NR, sizeof(**s->dir));
+		if(s->dir[i] == NULL)
+			goto err;
+		for(j = 0; j < SMEM_TBL_NR; ++j) {
+			if(sm->dir[i][j] == NULL)
+				continue;
+			s->dir[i][j] = malloc(SMEM_CHUNK_SZ);
+			if(s->dir[i][j] == NULL)
+				goto err;
+			memcpy(s->dir[i][j], sm->dir[i][j], SMEM_CHUNK_SZ);
+		}
+	}
+
+	*snap = s;
+	return 0;
+
+err:
+	smem_snapshot_free(dev, s);
+	return -ENOMEM;
+}
+
+/**
+ * Restore sparse memory content. Chunks allocated since snapshot are freed
+ * along with tables left empty, cpus drop their host pointers on restore.
+ */
+static int smem_restore(struct dev *dev, void const *snap)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	struct smem_snap const *s = snap;
+	phyaddr_t addr;
+	uint8_t *c;
+	size_t i, j, nr;
+
+	if(s->nrdir != sm->nrdir)
+		return -EINVAL;
+
+	for(i = 0; i < sm->nrdir; ++i) {
+		if((s->dir[i] == NULL) && (sm->dir[i] == NULL))
+			continue;
+		for(j = 0, nr = 0; j < SMEM_TBL_NR; ++j) {
+			addr = ((phyaddr_t)i << SMEM_DIR_SHIFT) |
+				((phyaddr_t)j << SMEM_CHUNK_SHIFT);
+			if((s->dir[i] != NULL) && (s->dir[i][j] != NULL)) {
+				c = smem_chunk_alloc(sm, addr);
+				if(c == NULL)
+					return -ENOMEM;
+				memcpy(c, s->dir[i][j], SMEM_CHUNK_SZ);
+				++nr;
+			} else if(sm->dir[i] != NULL) {
+				free(sm->dir[i][j]);
+				sm->dir[i][j] = NULL;
+			}
+		}
+
+		if(nr == 0) {
+			free(sm->dir[i]);
+			sm->dir[i] = NULL;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Create a new sparse memory device instance
+ */
+static int smem_create(struct dev **dev, struct devcfg const *cfg)
+{
+	struct sparsemem *sm;
+	struct sparsemem_cfg const *scfg =
+		(struct sparsemem_cfg const *)cfg->cfg;
+	int err = -EINVAL;
+
+	if(scfg->sz == 0)
+		goto exit;
+
+	err = -ENOMEM;
+	sm = calloc(1, sizeof(*sm));
+	if(sm == NULL)
+		goto exit;
+
+	sm->ramdev.perm = scfg->perm;
+	sm->ramdev.size = scfg->sz;
+	sm->nrdir = SMEM_DIR_NR_OF(scfg->sz - 1) + 1;
+	sm->dir = calloc(sm->nrdir, sizeof(*sm->dir));
+	if(sm->dir == NULL) {
+		free(sm);
+		goto exit;
+	}
+
+	*dev = &sm->ramdev.dev;
+	err = 0;
+exit:
+	return err;
+}
+
+/*
+ * Destroy a sparse memory device instance
+ */
+static void smem_destroy(struct dev *dev)
+{
+	struct sparsemem *sm = to_sparsemem(dev);
+	size_t i, j;
+
+	for(i = 0; i < sm->nrdir; ++i) {
+		if(sm->dir[i] == NULL)
+			continue;
+		for(j = 0; j < SMEM_TBL_NR; ++j)
+			free(sm->dir[i][j]);
+		free(sm->dir[i]);
+	}
+	free(sm->dir);
+	free(sm);
+}
+
+/*
+ * Sparse memory driver operations
+ */
+static struct phydevops const smops = {
+	.create = smem_create,
+	.destroy = smem_destroy,
+	.read8 = smem_read8,
+	.read16 = smem_read16,
+	.read32 = smem_read32,
+	.read64 = smem_read64,
+	.write8 = smem_write8,
+	.write16 = smem_write16,
+	.write32 = smem_write32,
+	.write64 = smem_write64,
+	.read_block = smem_read_block,
+	.write_block = smem_write_block,
+	.fetch_isn8 = smem_read8,
+	.fetch_isn16 = smem_read16,
+	.fetch_isn32 = smem_read32,
+	.hostmem = smem_hostmem,
+	.snapshot = smem_snapshot,
+	.restore = smem_restore,
+	.snapshot_free = smem_snapshot_free,
+};
+
+/*
+ * Sparse memory driver structure
+ */
+static struct drv const smem = {
+	.name = "sparse-mem",
+	.phyops = &smops,
+};
+
+DRIVER_REGISTER(smem);
@@ -0,0 +1,699 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/zimgmem.h"
+
+#include "ramctl.h"
+#include "memsnap.h"
+#include "lz.h"
+
+/*
+ * Compressed memory image, all fields are little endian:
+ *  - a header
+ *  - a page index, giving the block each image page is stored in
+ *  - page blocks, either LZ compressed or stored as is if they would not
+ *    shrink. Zero pages have no block, identical consecutive pages share
+ *    the same one.
+ * The image is mapped and pages are only decompressed when first accessed,
+ * so that loading and snapshot restore do not depend on image size.
+ */
+#define ZIMG_MAGIC "SPZI"
+#define ZIMG_VERSION 1
+#define ZIMG_PAGE_SHIFT 12
+#define ZIMG_PAGE_SZ ((size_t)1 << ZIMG_PAGE_SHIFT)
+#define ZIMG_PAGE_NR(a) ((size_t)((a) >> ZIMG_PAGE_SHIFT))
+
+struct zimg_hdr {
+	/* ZIMG_MAGIC */
+	char magic[4];
+	/* ZIMG_VERSION */
+	uint32_t version;
+	/* Page size shift, ZIMG_PAGE_SHIFT */
+	uint32_t pgshift;
+	uint32_t pad;
+	/* Memory image size */
+	uint64_t sz;
+};
+
+struct zimg_idx {
+	/* Page block file offset */
+	uint64_t off;
+	/* Page block size, 0 for a zero page, page size if not compressed */
+	uint32_t len;
+	uint32_t pad;
+};
+
+struct zimgmem {
+	/* Ramctl device */
+	struct ramdev ramdev;
+	/* Mapped image file */
+	uint8_t const *img;
+	/* Image file size */
+	size_t imgsz;
+	/* Image page index */
+	struct zimg_idx const *idx;
+	/* Number of image pages */
+	size_t nrimg;
+	/* Memory data, pages are filled from image on first access */
+	uint8_t *mapmem;
+	/* Actual mapping size */
+	size_t mapsz;
+	/* Bitmap of memory pages already filled from image */
+	uint64_t *filled;
+};
+#define to_zimgmem(m) (container_of(to_ramdev(m), struct zimgmem, ramdev))
+
+/* Snapshot of compressed image memory */
+struct zmem_snap {
+	/* Saved memory content */
+	void *ms;
+	/* Pages already filled from image */
+	uint64_t filled[];
+};
+
+#define ZMEM_BM_WORD(n) ((n) / 64)
+#define ZMEM_BM_BIT(n) ((uint64_t)1 << ((n) % 64))
+#define ZMEM_BM_SZ(nr) (((nr) + 63) / 64 * sizeof(uint64_t))
+#define ZMEM_FILLED(zm, pg)						\
+	((zm)->filled[ZMEM_BM_WORD(pg)] & ZMEM_BM_BIT(pg))
+
+#define ZMEM_BYTE(mem, off) (*((uint8_t *)((mem) + (off))))
+#define ZMEM_HALF(mem, off) (*((uint16_t *)((mem) + (off))))
+#define ZMEM_WORD(mem, off) (*((uint32_t *)((mem) + (off))))
+#define ZMEM_DWORD(mem, off) (*((uint64_t *)((mem) + (off))))
+
+/**
+ * Decompress a memory page from image
+ *
+ * @param zm: Compressed image memory device
+ * @param pg: Memory page number
+ *
+ * @return: 0 on success, negative number if image is corrupted
+ */
+static int zmem_fill(struct zimgmem *zm, size_t pg)
+{
+	uint8_t *page = zm->mapmem + (pg << ZIMG_PAGE_SHIFT);
+	uint64_t off;
+	uint32_t len;
+
+	/* Pages past the image are zero */
+	if(pg < zm->nrimg) {
+		off = le64toh(zm->idx[pg].off);
+		len = le32toh(zm->idx[pg].len);
+
+		if((off > zm->imgsz) || (len > zm->imgsz - off) ||
+				(len > ZIMG_PAGE_SZ))
+			return -EIO;
+
+		if(len == ZIMG_PAGE_SZ)
+			memcpy(page, zm->img + off, len);
+		else if((len != 0) && (lz_decompress(zm->img + off, len, page,
+						ZIMG_PAGE_SZ) != 0))
+			return -EIO;
+	}
+
+	zm->filled[ZMEM_BM_WORD(pg)] |= ZMEM_BM_BIT(pg);
+
+	return 0;
+}
+
+/**
+ * Get memory data, making sure the page holding an address is filled
+ *
+ * @return: Memory data, NULL if page could not be filled
+ */
+static inline uint8_t *zmem_get(struct zimgmem *zm, phyaddr_t addr)
+{
+	size_t pg = ZIMG_PAGE_NR(addr);
+
+	if(!ZMEM_FILLED(zm, pg) && (zmem_fill(zm, pg) != 0))
+		return NULL;
+
+	return zm->mapmem;
+}
+
+/**
+ * Fill all memory pages of a range
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int zmem_fill_range(struct zimgmem *zm, phyaddr_t addr, size_t len)
+{
+	size_t pg;
+
+	if((addr > zm->ramdev.size) || (len > zm->ramdev.size - addr))
+		return -EINVAL;
+
+	for(pg = ZIMG_PAGE_NR(addr); (len != 0) &&
+			(pg <= ZIMG_PAGE_NR(addr + len - 1)); ++pg)
+		if(!ZMEM_FILLED(zm, pg) && (zmem_fill(zm, pg) != 0))
+			return -EIO;
+
+	return 0;
+}
+
+/**
+ * Fetch a 8 bit value from memory
+ */
+static int zmem_read8(struct dev *dev, phyaddr_t addr, uint8_t *val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	*val = ZMEM_BYTE(mem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 16 bit value from memory
+ */
+static int zmem_read16(struct dev *dev, phyaddr_t addr, uint16_t *val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	*val = ZMEM_HALF(mem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 32 bit value from memory
+ */
+static int zmem_read32(struct dev *dev, phyaddr_t addr, uint32_t *val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	*val = ZMEM_WORD(mem, addr);
+
+	return 0;
+}
+
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int zmem_read64(struct dev *dev, phyaddr_t addr, uint64_t *val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	*val = ZMEM_DWORD(mem, addr);
+
+	return 0;
+}
+
+/**
+ * Write a 8 bit value into memory
+ */
+static int zmem_write8(struct dev *dev, phyaddr_t addr, uint8_t val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	ZMEM_BYTE(mem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 16 bit value into memory
+ */
+static int zmem_write16(struct dev *dev, phyaddr_t addr, uint16_t val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	ZMEM_HALF(mem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 32 bit value into memory
+ */
+static int zmem_write32(struct dev *dev, phyaddr_t addr, uint32_t val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	ZMEM_WORD(mem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Write a 64 bit value into memory
+ */
+static int zmem_write64(struct dev *dev, phyaddr_t addr, uint64_t val)
+{
+	uint8_t *mem = zmem_get(to_zimgmem(dev), addr);
+
+	if(mem == NULL)
+		return -EIO;
+
+	ZMEM_DWORD(mem, addr) = val;
+
+	return 0;
+}
+
+/**
+ * Copy a block of memory
+ */
+static int zmem_read_block(struct dev *dev, phyaddr_t addr, void *buf,
+		size_t len)
+{
+	struct zimgmem *zm = to_zimgmem(dev);
+	int ret;
+
+	ret = zmem_fill_range(zm, addr, len);
+	if(ret != 0)
+		return ret;
+
+	memcpy(buf, zm->mapmem + addr, len);
+
+	return 0;
+}
+
+/**
+ * Copy a block into memory
+ */
+static int zmem_write_block(struct dev *dev, phyaddr_t addr,
+		void const *buf, size_t len)
+{
+	struct zimgmem *zm = to_zimgmem(dev);
+	int ret;
+
+	ret = zmem_fill_range(zm, addr, len);
+	if(ret != 0)
+		return ret;
+
+	memcpy(zm->mapmem + addr, buf, len);
+
+	return 0;
+}
+
+/**
+ * Get host memory backing the page holding an address, filling it first
+ */
+static int zmem_hostmem(struct dev *dev, phyaddr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct zimgmem *zm = to_zimgmem(dev);
+	size_t pg = ZIMG_PAGE_NR(addr);
+
+	if(addr >= zm->ramdev.size)
+		return -EINVAL;
+
+	if(!ZMEM_FILLED(zm, pg) && (zmem_fill(zm, pg) != 0))
+		return -EIO;
+
+	hm->addr = (phyaddr_t)pg << ZIMG_PAGE_SHIFT;
+	hm->host = zm->mapmem + hm->addr;
+	hm->sz = ZIMG_PAGE_SZ;
+	if(hm->sz > zm->ramdev.size - hm->addr)
+		hm->sz = zm->ramdev.size - hm->addr;
+	hm->perm = zm->ramdev.perm;
+
+	return 0;
+}
+
+/**
+ * Save filled memory pages, the other ones are still in image
+ */
+static int zmem_snapshot(struct dev *dev, void **snap)
+{
+	struct zimgmem *zm = to_zimgmem(dev);
+	size_t bmsz = ZMEM_BM_SZ(zm->mapsz >> ZIMG_PAGE_SHIFT);
+	struct zmem_snap *zs;
+	int ret;
+
+	zs = malloc(sizeof(*zs) + bmsz);
+	if(zs == NULL)
+		return -ENOMEM;
+
+	ret = memsnap_take_pages(zm->mapmem, zm->mapsz, zm->filled,
+			ZIMG_PAGE_SHIFT, &zs->ms);
+	if(ret != 0) {
+		free(zs);
+		return ret;
+	}
+
+	memcpy(zs->filled, zm->filled, bmsz);
+	*snap = zs;
+
+	return 0;
+}
+
+/**
+ * Restore memory content, pages filled since are decompressed again if
+ * accessed
+ */
+static int zmem_restore(struct dev *dev, void const *snap)
+{
+	struct zimgmem *zm = to_zimgmem(dev);
+	struct zmem_snap const *zs = snap;
+	int ret;
+
+	ret = memsnap_restore(zm->mapmem, zm->mapsz, PROT_READ | PROT_WRITE,
+			zs->ms);
+	if(ret != 0)
+		return ret;
+
+	memcpy(zm->filled, zs->filled,
+			ZMEM_BM_SZ(zm->mapsz >> ZIMG_PAGE_SHIFT));
+
+	return 0;
+}
+
+/**
+ * Free a memory snapshot
+ */
+static void zmem_snapshot_free(struct dev *dev, void *snap)
+{
+	struct zmem_snap *zs = snap;
+
+	(void)dev;
+
+	memsnap_free(zs->ms);
+	free(zs);
+}
+
+/**
+ * Map compressed image and check its header and page index
+ *
+ * @param zm: Compressed image memory device
+ * @param path: Image file path
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int zmem_open(struct zimgmem *zm, char const *path)
+{
+	struct zimg_hdr const *hdr;
+	struct stat st;
+	void *img;
+	uint64_t sz;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		ret = -errno;
+		PERR("Cannot open %s", path);
+		return ret;
+	}
+
+	if(fstat(fd, &st) != 0) {
+		ret = -errno;
+		goto close;
+	}
+
+	ret = -EINVAL;
+	if((size_t)st.st_size < sizeof(*hdr))
+		goto close;
+
+	img = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(img == MAP_FAILED) {
+		ret = -ENOMEM;
+		goto close;
+	}
+	zm->img = img;
+	zm->imgsz = st.st_size;
+
+	hdr = img;
+	sz = le64toh(hdr->sz);
+	if((memcmp(hdr->magic, ZIMG_MAGIC, sizeof(hdr->magic)) != 0) ||
+			(le32toh(hdr->version) != ZIMG_VERSION) ||
+			(le32toh(hdr->pgshift) != ZIMG_PAGE_SHIFT) ||
+			(sz > SIZE_MAX - ZIMG_PAGE_SZ))
+		goto close;
+
+	zm->nrimg = (sz + ZIMG_PAGE_SZ - 1) >> ZIMG_PAGE_SHIFT;
+	if(zm->nrimg > (zm->imgsz - sizeof(*hdr)) / sizeof(*zm->idx))
+		goto close;
+	zm->idx = (struct zimg_idx const *)(hdr + 1);
+
+	if(zm->ramdev.size == (size_t)-1)
+		zm->ramdev.size = sz;
+	ret = 0;
+
+close:
+	/* File mapping holds its own reference */
+	close(fd);
+	return ret;
+}
+
+/**
+ * Release compressed image memory device resources
+ */
+static void zmem_free(struct zimgmem *zm)
+{
+	if(zm->img != NULL)
+		munmap((void *)zm->img, zm->imgsz);
+	if(zm->mapmem != NULL)
+		munmap(zm->mapmem, zm->mapsz);
+	free(zm->filled);
+	free(zm);
+}
+
+/**
+ * Create a new compressed image memory device instance
+ */
+static int zmem_create(struct dev **dev, struct devcfg const *cfg)
+{
+	struct zimgmem *zm;
+	struct zimgmem_cfg const *zcfg = (struct zimgmem_cfg const *)cfg->cfg;
+	int err = -ENOMEM;
+
+	zm = calloc(1, sizeof(*zm));
+	if(zm == NULL)
+		goto exit;
+
+	zm->ramdev.perm = zcfg->perm;
+	zm->ramdev.size = zcfg->sz;
+
+	err = zmem_open(zm, zcfg->path);
+	if(err != 0) {
+		ERR("Cannot load compressed image %s\n", zcfg->path);
+		goto free;
+	}
+
+	err = -EINVAL;
+	if(zm->ramdev.size == 0)
+		goto free;
+
+	/* Memory is only allocated when pages are filled */
+	err = -ENOMEM;
+	zm->mapsz = (zm->ramdev.size + ZIMG_PAGE_SZ - 1) &
+		~(ZIMG_PAGE_SZ - 1);
+	zm->mapmem = mmap(NULL, zm->mapsz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(zm->mapmem == MAP_FAILED) {
+		zm->mapmem = NULL;
+		goto free;
+	}
+
+	zm->filled = calloc(1, ZMEM_BM_SZ(zm->mapsz >> ZIMG_PAGE_SHIFT));
+	if(zm->filled == NULL)
+		goto free;
+
+	*dev = &zm->ramdev.dev;
+	return 0;
+free:
+	zmem_free(zm);
+exit:
+	return err;
+}
+
+/*
+ * Destroy a compressed image memory device instance
+ */
+static void zmem_destroy(struct dev *dev)
+{
+	zmem_free(to_zimgmem(dev));
+}
+
+/**
+ * Write a whole buffer into file at given offset
+ */
+static int zimg_pwrite(int fd, void const *buf, size_t len, off_t off)
+{
+	uint8_t const *p = buf;
+	ssize_t sz;
+
+	for(; len != 0; len -= sz, p += sz, off += sz) {
+		sz = pwrite(fd, p, len, off);
+		if(sz < 0) {
+			if(errno == EINTR)
+				sz = 0;
+			else
+				return -errno;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Check if a page is only made of zero
+ */
+static inline int zimg_is_zero(uint8_t const *page)
+{
+	size_t i;
+
+	for(i = 0; i < ZIMG_PAGE_SZ; ++i)
+		if(page[i] != 0)
+			return 0;
+
+	return 1;
+}
+
+/**
+ * Write memory content as a compressed memory image
+ *
+ * @param path: Image file path, created or truncated
+ * @param mem: Memory content
+ * @param sz: Memory size
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int zimgmem_write(char const *path, void const *mem, size_t sz)
+{
+	struct zimg_hdr hdr;
+	uint8_t page[ZIMG_PAGE_SZ], blk[ZIMG_PAGE_SZ];
+	uint8_t const *data;
+	struct zimg_idx *idx;
+	size_t nr, pg, prev = 0, len;
+	off_t off;
+	int fd, ret = -ENOMEM;
+
+	nr = (sz + ZIMG_PAGE_SZ - 1) >> ZIMG_PAGE_SHIFT;
+	idx = calloc(nr, sizeof(*idx));
+	if((idx == NULL) && (nr != 0))
+		goto out;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		ret = -errno;
+		PERR("Cannot create %s", path);
+		goto out;
+	}
+
+	off = sizeof(hdr) + nr * sizeof(*idx);
+	for(pg = 0; pg < nr; ++pg) {
+		/* Last page is zero padded */
+		len = sz - (pg << ZIMG_PAGE_SHIFT);
+		if(len > ZIMG_PAGE_SZ)
+			len = ZIMG_PAGE_SZ;
+		memset(page, 0, sizeof(page));
+		memcpy(page, (uint8_t const *)mem + (pg << ZIMG_PAGE_SHIFT),
+				len);
+
+		if(zimg_is_zero(page))
+			continue;
+
+		/* Share block of last stored page if identical */
+		if((idx[prev].len != 0) && (len == ZIMG_PAGE_SZ) &&
+				(memcmp((uint8_t const *)mem +
+					(prev << ZIMG_PAGE_SHIFT), page,
+					ZIMG_PAGE_SZ) == 0)) {
+			idx[pg] = idx[prev];
+			continue;
+		}
+		prev = pg;
+
+		/* Keep page as is if it does not shrink */
+		data = blk;
+		len = lz_compress(page, ZIMG_PAGE_SZ, blk, ZIMG_PAGE_SZ - 1);
+		if(len == 0) {
+			data = page;
+			len = ZIMG_PAGE_SZ;
+		}
+
+		ret = zimg_pwrite(fd, data, len, off);
+		if(ret != 0)
+			goto close;
+
+		idx[pg].off = htole64(off);
+		idx[pg].len = htole32(len);
+		off += len;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, ZIMG_MAGIC, sizeof(hdr.magic));
+	hdr.version = htole32(ZIMG_VERSION);
+	hdr.pgshift = htole32(ZIMG_PAGE_SHIFT);
+	hdr.sz = htole64(sz);
+
+	ret = zimg_pwrite(fd, &hdr, sizeof(hdr), 0);
+	if(ret != 0)
+		goto close;
+
+	ret = zimg_pwrite(fd, idx, nr * sizeof(*idx), sizeof(hdr));
+close:
+	close(fd);
+out:
+	free(idx);
+	return ret;
+}
+
+/*
+ * Compressed image memory driver operations
+ */
+static struct phydevops const zmops = {
+	.create = zmem_create,
+	.destroy = zmem_destroy,
+	.read8 = zmem_read8,
+	.read16 = zmem_read16,
+	.read32 = zmem_read32,
+	.read64 = zmem_read64,
+	.write8 = zmem_write8,
+	.write16 = zmem_write16,
+	.write32 = zmem_write32,
+	.write64 = zmem_write64,
+	.read_block = zmem_read_block,
+	.write_block = zmem_write_block,
+	.fetch_isn8 = zmem_read8,
+	.fetch_isn16 = zmem_read16,
+	.fetch_isn32 = zmem_read32,
+	.hostmem = zmem_hostmem,
+	.snapshot = zmem_snapshot,
+	.restore = zmem_restore,
+	.snapshot_free = zmem_snapshot_free,
+};
+
+/*
+ * Compressed image memory driver structure
+ */
+static struct drv const zmem = {
+	.name = "zimg-mem",
+	.phyops = &zmops,
+};
+
+DRIVER_REGISTER(zmem);
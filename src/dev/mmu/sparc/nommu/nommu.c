@@ -68,6 +68,18 @@ static int snommu_read32(struct dev *dev, addr_t addr, uint32_t *val)
 	return mem->drv->phyops->read32(mem, addr, val);
 }
 
+/**
+ * Fetch a 64 bit value from memory
+ */
+static int snommu_read64(struct dev *dev, addr_t addr, uint64_t *val)
+{
+	struct dev *mem = to_snommu_dev(dev)->mem;
+
+	if(!mem->drv->phyops->read64)
+		return -ENOSYS;
+	return mem->drv->phyops->read64(mem, addr, val);
+}
+
 /**
  * Write a 8 bit value into memory
  */
@@ -104,6 +116,44 @@ static int snommu_write32(struct dev *dev, addr_t addr, uint32_t val)
 	return mem->drv->phyops->write32(mem, addr, val);
 }
 
+/**
+ * Write a 64 bit value into memory
+ */
+static int snommu_write64(struct dev *dev, addr_t addr, uint64_t val)
+{
+	struct dev *mem = to_snommu_dev(dev)->mem;
+
+	if(!mem->drv->phyops->write64)
+		return -ENOSYS;
+	return mem->drv->phyops->write64(mem, addr, val);
+}
+
+/**
+ * Copy a block of memory
+ */
+static int snommu_read_block(struct dev *dev, addr_t addr, void *buf,
+		size_t len)
+{
+	struct dev *mem = to_snommu_dev(dev)->mem;
+
+	if(!mem->drv->phyops->read_block)
+		return -ENOSYS;
+	return mem->drv->phyops->read_block(mem, addr, buf, len);
+}
+
+/**
+ * Copy a block into memory
+ */
+static int snommu_write_block(struct dev *dev, addr_t addr, void const *buf,
+		size_t len)
+{
+	struct dev *mem = to_snommu_dev(dev)->mem;
+
+	if(!mem->drv->phyops->write_block)
+		return -ENOSYS;
+	return mem->drv->phyops->write_block(mem, addr, buf, len);
+}
+
 /**
  * Fetch a 8 bit value from memory with execute permission
  */
@@ -140,6 +190,60 @@ static int snommu_fetch_isn32(struct dev *dev, addr_t addr, uint32_t *val)
 	return mem->drv->phyops->fetch_isn32(mem, addr, val);
 }
 
+/**
+ * Get host memory backing physical memory, for identity mapped accesses
+ */
+static int snommu_hostmem(struct dev *dev, addr_t addr,
+		struct dev_hostmem *hm)
+{
+	struct dev *mem = to_snommu_dev(dev)->mem;
+	int ret;
+
+	if(!mem->drv->phyops->hostmem)
+		return -ENOSYS;
+
+	ret = mem->drv->phyops->hostmem(mem, addr, hm);
+	if(ret != 0)
+		return ret;
+
+	/* Virtual address space is only 32 bits wide */
+	if(hm->addr + hm->sz > ((phyaddr_t)1 << 32))
+		hm->sz = ((phyaddr_t)1 << 32) - hm->addr;
+
+	return 0;
+}
+
+/**
+ * Get host memory backing data memory
+ */
+static int snommu_data_hostmem(struct dev *dev, addr_t addr,
+		struct dev_hostmem *hm)
+{
+	int ret;
+
+	ret = snommu_hostmem(dev, addr, hm);
+	if(ret == 0)
+		hm->perm &= MP_R | MP_W;
+
+	return ret;
+}
+
+/**
+ * Get host memory backing instruction memory, it can only be read if physical
+ * memory is executable
+ */
+static int snommu_isn_hostmem(struct dev *dev, addr_t addr,
+		struct dev_hostmem *hm)
+{
+	int ret;
+
+	ret = snommu_hostmem(dev, addr, hm);
+	if(ret == 0)
+		hm->perm = (hm->perm & MP_X) ? MP_R : 0;
+
+	return ret;
+}
+
 /**
  * Create a new sparc fixed mmu instruction access virtual device
  *
@@ -347,9 +451,14 @@ static struct devops const snommudops = {
 	.read8 = snommu_read8,
 	.read16 = snommu_read16,
 	.read32 = snommu_read32,
+	.read64 = snommu_read64,
 	.write8 = snommu_write8,
 	.write16 = snommu_write16,
 	.write32 = snommu_write32,
+	.write64 = snommu_write64,
+	.read_block = snommu_read_block,
+	.write_block = snommu_write_block,
+	.hostmem = snommu_data_hostmem,
 };
 
 static struct drv const snommu_data = {
@@ -365,6 +474,7 @@ static struct devops const snommuiops = {
 	.read8 = snommu_fetch_isn8,
 	.read16 = snommu_fetch_isn16,
 	.read32 = snommu_fetch_isn32,
+	.hostmem = snommu_isn_hostmem,
 };
 
 static struct drv const snommu_isn = {
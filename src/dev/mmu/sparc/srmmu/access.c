@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <errno.h>
 
 #include "types.h"
 #include "dev/device.h"
@@ -6,146 +7,74 @@
 #include "srmmu.h"
 #include "access.h"
 
-/**
- * Sparc MMU read physical 8 bits from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Read result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyread8(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->read8)
-		return -ENOSYS;
-	return mem->drv->phyops->read8(mem, pa, (uint8_t *)ptr);
-}
-
-/**
- * Sparc MMU read physical 16 bits from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Read result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyread16(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->read16)
-		return -ENOSYS;
-	return mem->drv->phyops->read16(mem, pa, (uint16_t *)ptr);
+/* Generate a physical access operation for a missing memory controller one */
+#define SRMMU_PHY_NOSYS(op, type)					\
+static int srmmu_nosys_ ## op(struct dev *mem, phyaddr_t pa, type val)	\
+{									\
+	(void)mem;							\
+	(void)pa;							\
+	(void)val;							\
+	return -ENOSYS;							\
 }
 
-/**
- * Sparc MMU read physical 32 bits from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Read result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyread32(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->read32)
-		return -ENOSYS;
-	return mem->drv->phyops->read32(mem, pa, (uint32_t *)ptr);
-}
-
-/**
- * Sparc MMU fetch physical 8bit instruction from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Fetch result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyexec8(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->fetch_isn8)
-		return -ENOSYS;
-	return mem->drv->phyops->fetch_isn8(mem, pa, (uint8_t *)ptr);
-}
+SRMMU_PHY_NOSYS(read8, uint8_t *)
+SRMMU_PHY_NOSYS(read16, uint16_t *)
+SRMMU_PHY_NOSYS(read32, uint32_t *)
+SRMMU_PHY_NOSYS(read64, uint64_t *)
+SRMMU_PHY_NOSYS(write8, uint8_t)
+SRMMU_PHY_NOSYS(write16, uint16_t)
+SRMMU_PHY_NOSYS(write32, uint32_t)
+SRMMU_PHY_NOSYS(write64, uint64_t)
 
-/**
- * Sparc MMU fetch physical 16bit instruction from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Fetch result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyexec16(struct dev *mem, phyaddr_t pa, void *ptr)
+static int srmmu_nosys_read_block(struct dev *mem, phyaddr_t pa, void *buf,
+		size_t len)
 {
-	if(!mem->drv->phyops->fetch_isn16)
-		return -ENOSYS;
-	return mem->drv->phyops->fetch_isn16(mem, pa, (uint16_t *)ptr);
+	(void)mem;
+	(void)pa;
+	(void)buf;
+	(void)len;
+	return -ENOSYS;
 }
 
-/**
- * Sparc MMU fetch physical 32bit instruction from memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Fetch result
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phyexec32(struct dev *mem, phyaddr_t pa, void *ptr)
+static int srmmu_nosys_write_block(struct dev *mem, phyaddr_t pa,
+		void const *buf, size_t len)
 {
-	if(!mem->drv->phyops->fetch_isn32)
-		return -ENOSYS;
-	return mem->drv->phyops->fetch_isn32(mem, pa, (uint32_t *)ptr);
+	(void)mem;
+	(void)pa;
+	(void)buf;
+	(void)len;
+	return -ENOSYS;
 }
 
-/**
- * Sparc MMU write physical 8bit value to memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Write data
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phywrite8(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->write8)
-		return -ENOSYS;
-	return mem->drv->phyops->write8(mem, pa, *(uint8_t *)ptr);
-}
+/* Use op if memory controller has one, fallback to a -ENOSYS one otherwise */
+#define SRMMU_PHY_BIND(ops, op, fallback) do {				\
+	if((ops)->op == NULL)						\
+		(ops)->op = fallback;					\
+} while(0)
 
 /**
- * Sparc MMU write physical 16bit value to memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Write data
+ * Bind Sparc MMU physical accesses to a memory controller. Its missing
+ * operations are replaced by ones failing with -ENOSYS, so that access paths
+ * never have to check for them.
  *
- * @return: 0 on success negative number otherwise
+ * @param ops: Filled with memory controller physical operations
+ * @param mem: Memory controller physical device
  */
-int srmmu_phywrite16(struct dev *mem, phyaddr_t pa, void *ptr)
+void srmmu_phyops_bind(struct phydevops *ops, struct dev const *mem)
 {
-	if(!mem->drv->phyops->write16)
-		return -ENOSYS;
-	return mem->drv->phyops->write16(mem, pa, *(uint16_t *)ptr);
-}
+	*ops = *mem->drv->phyops;
 
-/**
- * Sparc MMU write physical 32bit value to memory
- *
- * @mem: Memory physical device
- * @pa: Physical address
- * @ptr: Write data
- *
- * @return: 0 on success negative number otherwise
- */
-int srmmu_phywrite32(struct dev *mem, phyaddr_t pa, void *ptr)
-{
-	if(!mem->drv->phyops->write32)
-		return -ENOSYS;
-	return mem->drv->phyops->write32(mem, pa, *(uint32_t *)ptr);
+	SRMMU_PHY_BIND(ops, read8, srmmu_nosys_read8);
+	SRMMU_PHY_BIND(ops, read16, srmmu_nosys_read16);
+	SRMMU_PHY_BIND(ops, read32, srmmu_nosys_read32);
+	SRMMU_PHY_BIND(ops, read64, srmmu_nosys_read64);
+	SRMMU_PHY_BIND(ops, write8, srmmu_nosys_write8);
+	SRMMU_PHY_BIND(ops, write16, srmmu_nosys_write16);
+	SRMMU_PHY_BIND(ops, write32, srmmu_nosys_write32);
+	SRMMU_PHY_BIND(ops, write64, srmmu_nosys_write64);
+	SRMMU_PHY_BIND(ops, read_block, srmmu_nosys_read_block);
+	SRMMU_PHY_BIND(ops, write_block, srmmu_nosys_write_block);
+	SRMMU_PHY_BIND(ops, fetch_isn8, srmmu_nosys_read8);
+	SRMMU_PHY_BIND(ops, fetch_isn16, srmmu_nosys_read16);
+	SRMMU_PHY_BIND(ops, fetch_isn32, srmmu_nosys_read32);
 }
@@ -1,38 +1,133 @@
 #ifndef _SRMMU_ACCESS_H_
 #define _SRMMU_ACCESS_H_
 
+/* Kind of access, each one has its own micro-TLB */
+enum srmmu_acc_kind {
+	SAK_READ,
+	SAK_WRITE,
+	SAK_EXEC,
+	SAK_NR,
+};
+#define SAK_read SAK_READ
+#define SAK_write SAK_WRITE
+#define SAK_exec SAK_EXEC
+
+/*
+ * Kind of MMU transaction, each access entry point has its own constant
+ * one. Accessed address, context and data are passed separately.
+ */
 struct srmmu_access {
-	int (*phyacc)(struct dev *mem, phyaddr_t paddr, void *ptr);
+	int (*phyacc)(struct dev *mem, struct phydevops const *ops,
+			phyaddr_t paddr, void *ptr);
 	int (*ptecheck)(struct pdc_entry *pdce);
-	void *ptr;
-	addr_t addr;
-	ctx_t ctx;
+	enum srmmu_acc_kind kind;
 	pte_t flag;
 };
 
-#define SRMMU_ACCESS_INIT(c, va, p, type, sz, f)			\
+/* Block transfer, used as srmmu_access ptr for block accesses */
+struct srmmu_block {
+	void *buf;
+	size_t len;
+};
+
+#define SRMMU_ACCESS_INIT(type, sz, f)					\
 {									\
 	.phyacc = srmmu_phy ## type ## sz,				\
 	.ptecheck = pdc_pte_ ## type,					\
-	.ptr = p,							\
-	.addr = va,							\
-	.ctx = c,							\
+	.kind = SAK_ ## type,						\
 	.flag = f,							\
 }
 
+void srmmu_phyops_bind(struct phydevops *ops, struct dev const *mem);
+
+/*
+ * Sparc MMU memory controller physical accesses, ops are the memory
+ * controller operations bound with srmmu_phyops_bind(), they are never NULL
+ */
+
 /* Sparc MMU memory controller physical read */
-int srmmu_phyread8(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phyread16(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phyread32(struct dev *mem, phyaddr_t paddr, void *ptr);
+static inline int srmmu_phyread8(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->read8(mem, pa, (uint8_t *)ptr);
+}
+
+static inline int srmmu_phyread16(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->read16(mem, pa, (uint16_t *)ptr);
+}
+
+static inline int srmmu_phyread32(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->read32(mem, pa, (uint32_t *)ptr);
+}
+
+static inline int srmmu_phyread64(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->read64(mem, pa, (uint64_t *)ptr);
+}
+
+static inline int srmmu_phyread_block(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	struct srmmu_block *blk = (struct srmmu_block *)ptr;
+
+	return ops->read_block(mem, pa, blk->buf, blk->len);
+}
 
 /* Sparc MMU memory controller physical fetch */
-int srmmu_phyexec8(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phyexec16(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phyexec32(struct dev *mem, phyaddr_t paddr, void *ptr);
+static inline int srmmu_phyexec8(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->fetch_isn8(mem, pa, (uint8_t *)ptr);
+}
+
+static inline int srmmu_phyexec16(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->fetch_isn16(mem, pa, (uint16_t *)ptr);
+}
+
+static inline int srmmu_phyexec32(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->fetch_isn32(mem, pa, (uint32_t *)ptr);
+}
 
 /* Sparc MMU memory controller physical write */
-int srmmu_phywrite8(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phywrite16(struct dev *mem, phyaddr_t paddr, void *ptr);
-int srmmu_phywrite32(struct dev *mem, phyaddr_t paddr, void *ptr);
+static inline int srmmu_phywrite8(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->write8(mem, pa, *(uint8_t *)ptr);
+}
+
+static inline int srmmu_phywrite16(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->write16(mem, pa, *(uint16_t *)ptr);
+}
+
+static inline int srmmu_phywrite32(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->write32(mem, pa, *(uint32_t *)ptr);
+}
+
+static inline int srmmu_phywrite64(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	return ops->write64(mem, pa, *(uint64_t *)ptr);
+}
+
+static inline int srmmu_phywrite_block(struct dev *mem,
+		struct phydevops const *ops, phyaddr_t pa, void *ptr)
+{
+	struct srmmu_block *blk = (struct srmmu_block *)ptr;
+
+	return ops->write_block(mem, pa, blk->buf, blk->len);
+}
 
 #endif
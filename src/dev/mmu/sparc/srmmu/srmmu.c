@@ -6,7 +6,6 @@
 #include <errno.h>
 
 #include "types.h"
-#include "list.h"
 #include "dev/device.h"
 #include "dev/cfg/mmu/sparc/srmmu.h"
 #include "cpu/cpu.h"
@@ -66,12 +65,32 @@ struct srmmu_dev_cfg {
 	char const *mem;
 };
 
+/* Number of micro-TLB entries of each access kind */
+#define SRMMU_UTLB_SZ 16
+#define SRMMU_UTLB_IDX(va) (((va) >> 12) & (SRMMU_UTLB_SZ - 1))
+/* Virtual address of an invalid micro-TLB entry, never matches any page */
+#define UTLB_VA_INVAL VA_PAGE_OFF_MASK
+
+/*
+ * Micro-TLB entry, a page translation whose permissions have been checked
+ * and whose PTE referenced (and modified for stores) bits are already set
+ */
+struct srmmu_utlb {
+	addr_t va; /* Virtual page address */
+	ctx_t ctx;
+	uint32_t gen; /* Micro-TLBs generation entry is valid for */
+	phyaddr_t pa; /* Physical page address */
+};
+
 /* sparc MMU virtual device (data/instruction) */
 struct srmmu_dev {
 	struct dev dev;
 	struct dev *mem; /* Memory controller device */
+	struct phydevops phy; /* Memory controller ops, never NULL */
 	struct srmmu *mmu;
 	asi_t asi;
+	/* Direct mapped micro-TLBs, one per access kind */
+	struct srmmu_utlb utlb[SAK_NR][SRMMU_UTLB_SZ];
 };
 #define to_srmmu_dev(d) (container_of(d, struct srmmu_dev, dev))
 
@@ -107,168 +126,368 @@ struct srmmu_reg {
 #define CTRL_NF(sr) ((((sr)->ctrl) >> 1) & 0x1)
 #define CTRL_EN(sr) (((sr)->ctrl) & 0x1)
 
-#define SRMMU_CACHESZ 64 /* TODO make it tunable */
+/* Default number of PDC entries per level */
+#define SRMMU_PDC_DEFSZ 64
+/* PDC associativity, each set replacement uses a 3 bits pseudo-LRU tree */
+#define SRMMU_PDC_WAYS 4
+/* Virtual address of an invalid PDC slot, never matches any lookup */
+#define PDC_VA_INVAL VA_PAGE_OFF_MASK
+/* Maximum number of PTEs read at once by a page table walk, a whole table */
+#define SRMMU_PREFETCH_MAX 64
+
+/*
+ * PDC flush generations. An entry is only valid while the sum of the
+ * generations it depends on is the one it has been cached with, so that
+ * flushing a whole class of entries is done by bumping its generation.
+ */
+struct srmmu_pdc_gen {
+	uint64_t all; /* Entire flush generation */
+	uint64_t user; /* Generation of PTEs accessible from user mode */
+	uint64_t ctx[CTX_MAX + 2]; /* Per context generation */
+	/*
+	 * A supervisor only PTE has been cached with a user context, page
+	 * flushes have to look for it in every set
+	 */
+	int stray;
+};
+
+/* One level of Page Descriptor Cache, as arrays indexed by slot */
+struct srmmu_pdc {
+	uint64_t *stamp; /* Sum of flush generations entry was cached with */
+	phyaddr_t *pta; /* Page Table entry address */
+	addr_t *va;
+	ctx_t *ctx;
+	ptd_t *ptd;
+	uint8_t *pf; /* Entry has been prefetched and not used yet */
+	uint8_t *plru; /* Pseudo-LRU tree of each set */
+};
+
 struct srmmu {
 	struct dev dev;
 	struct srmmu_reg reg;
 	struct srmmu_dev vdev[SDT_NR]; /* SRMMU memory virtual devices */
-	struct list_head pdc; /* Page Descriptor cache */
-	struct pdc_entry pdesc[SRMMU_CACHESZ]; /* pool of page descriptors */
+	struct srmmu_pdc pdc[PL_NR]; /* Page Descriptor cache levels */
+	size_t pdcsz; /* Number of PDC entries per level */
+	void *pdcmem; /* Memory holding all PDC levels arrays */
+	struct srmmu_pdc_gen gen; /* PDC flush generations */
+	uint32_t utlbgen; /* Micro-TLBs generation */
+	size_t pfnr; /* Number of PTEs read at once by page table walk */
+	struct sparc_srmmu_stats stats;
 	struct cpu *cpu;
 };
 #define to_srmmu(d) (container_of(d, struct srmmu, dev))
 
+/* Generation index of a context */
+#define PDC_GEN_CTX(c) (((c) == CTX_SUPER) ? CTX_MAX + 1 : ((c) & CTX_MAX))
+/* PTE also accessible from user mode, flushed by any context flush */
+#define PDC_PTE_USER(p) ((ENTRY_TYPE(p) == ET_PTE) && (PTE_TO_ACC(p) < 6))
+
+/* Virtual address shift giving a PDC level index */
+static unsigned int const _pdc_shift[] = {
+	[PL_PAGE] = 12,
+	[PL_SEGMENT] = 18,
+	[PL_REGION] = 24,
+	[PL_CTX] = 0,
+};
+
+/**
+ * Get size of one PDC level arrays
+ *
+ * @param nr: Number of entries per level
+ *
+ * @return: Level arrays size, keeping next level arrays aligned
+ */
+static inline size_t srmmu_pdc_lvlsz(size_t nr)
+{
+	size_t sz = nr * (sizeof(uint64_t) + sizeof(phyaddr_t) +
+			sizeof(addr_t) + sizeof(ctx_t) + sizeof(ptd_t) +
+			sizeof(uint8_t)) + nr / SRMMU_PDC_WAYS;
+
+	return (sz + sizeof(phyaddr_t) - 1) & ~(sizeof(phyaddr_t) - 1);
+}
+
+/**
+ * Get first slot of the PDC set an entry belongs to
+ */
+static inline size_t srmmu_pdc_set(struct srmmu *mmu, addr_t va, ctx_t ctx,
+		enum pdc_lvl lvl)
+{
+	uint32_t h = (va >> _pdc_shift[lvl]) ^ (ctx * 0x9e3779b1U);
+
+	return (h & (mmu->pdcsz / SRMMU_PDC_WAYS - 1)) * SRMMU_PDC_WAYS;
+}
+
+/**
+ * Mark a PDC slot as most recently used, pointing its set pseudo-LRU tree
+ * nodes away from it
+ */
+static inline void srmmu_pdc_touch(struct srmmu_pdc *pdc, size_t slot)
+{
+	uint8_t *t = &pdc->plru[slot / SRMMU_PDC_WAYS];
+
+	switch(slot % SRMMU_PDC_WAYS) {
+	case 0:
+		*t |= 0x3;
+		break;
+	case 1:
+		*t = (*t & ~0x2) | 0x1;
+		break;
+	case 2:
+		*t = (*t & ~0x1) | 0x4;
+		break;
+	default:
+		*t &= ~0x5;
+		break;
+	}
+}
+
+/**
+ * Invalidate all micro-TLB entries of a virtual device
+ *
+ * @param dev: Sparc MMU virtual device
+ */
+static void srmmu_vdev_utlb_flush(struct srmmu_dev *dev)
+{
+	size_t k, i;
+
+	for(k = 0; k < SAK_NR; ++k)
+		for(i = 0; i < SRMMU_UTLB_SZ; ++i)
+			dev->utlb[k][i].va = UTLB_VA_INVAL;
+}
+
+/**
+ * Invalidate all micro-TLBs, when address translation may have changed. This
+ * only bumps micro-TLBs generation, entries are really walked through on
+ * generation wrap around.
+ *
+ * @param mmu: Sparc MMU
+ */
+static void srmmu_utlb_flush(struct srmmu *mmu)
+{
+	size_t i;
+
+	if(++mmu->utlbgen != 0)
+		return;
+
+	for(i = 0; i < SDT_NR; ++i)
+		srmmu_vdev_utlb_flush(&mmu->vdev[i]);
+}
+
+/**
+ * Get flush generations sum a PDC entry is valid for
+ *
+ * @param mmu: Sparc MMU
+ * @param ctx: Entry context
+ * @param ptd: Entry page descriptor
+ *
+ * @return: Generations sum
+ */
+static inline uint64_t srmmu_pdc_stamp(struct srmmu *mmu, ctx_t ctx, ptd_t ptd)
+{
+	struct srmmu_pdc_gen const *g = &mmu->gen;
+
+	return g->all + g->ctx[PDC_GEN_CTX(ctx)] +
+		(PDC_PTE_USER(ptd) ? g->user : 0);
+}
+
+/**
+ * Check if a PDC slot holds a valid entry, that is an entry that has not been
+ * flushed since it has been cached
+ */
+static inline int srmmu_pdc_valid(struct srmmu *mmu, struct srmmu_pdc *pdc,
+		size_t slot)
+{
+	return (pdc->va[slot] != PDC_VA_INVAL) && (pdc->stamp[slot] ==
+			srmmu_pdc_stamp(mmu, pdc->ctx[slot], pdc->ptd[slot]));
+}
+
+/**
+ * Get the PDC slot holding a valid entry, without marking it as used
+ *
+ * @param mmu: Sparc MMU
+ * @param vaddr: Entry virtual address
+ * @param ctx: Entry context
+ * @param lvl: PDC entry level
+ *
+ * @return: Entry slot, PDC_NOSLOT if not cached
+ */
+static inline size_t srmmu_pdc_slot(struct srmmu *mmu, addr_t vaddr,
+		ctx_t ctx, enum pdc_lvl lvl)
+{
+	struct srmmu_pdc *pdc = &mmu->pdc[lvl];
+	size_t i, set = srmmu_pdc_set(mmu, vaddr, ctx, lvl);
+
+	for(i = set; i < set + SRMMU_PDC_WAYS; ++i) {
+		if((pdc->va[i] != vaddr) || (pdc->ctx[i] != ctx))
+			continue;
+
+		if(pdc->stamp[i] == srmmu_pdc_stamp(mmu, ctx, pdc->ptd[i]))
+			return i;
+	}
+
+	return PDC_NOSLOT;
+}
+
 /*
  * Try to find address translation in page cache
  *
- * @param dev: Sparc MMU virutal device
+ * @param mmu: Sparc MMU
  * @param vaddr: Virtual address to translate
  * @param ctx: Process context number
  * @param lvl: PDC entry level
- * @param pdce: If pdce points to non NULL pointer, it is copied with PDC entry
- * content if one is hit, otherwise pdce is set to point to a unlinked matching
- * PDC entry if one is hit. An unlinked PDC entry should be put backed into
- * cache with srmmu_pdc_put().
+ * @param pdce: Filled with PDC entry content if one is hit
  *
  * @return: 0 if an entry has been found in cache, negative number otherwise.
  */
-static int srmmu_pdc_find(struct srmmu_dev *dev, addr_t vaddr, ctx_t ctx,
-		enum pdc_lvl lvl, struct pdc_entry **pdce)
+static inline int srmmu_pdc_find(struct srmmu *mmu, addr_t vaddr, ctx_t ctx,
+		enum pdc_lvl lvl, struct pdc_entry *pdce)
 {
-	struct srmmu *mmu = dev->mmu;
-	struct pdc_entry *e;
-	int ret = -1;
-
-	list_for_each_entry(e, &mmu->pdc, next) {
-		if(!PDC_IS_VALID(e))
-			break;
-
-		if((e->ctx == ctx) && (e->va == vaddr) && (e->lvl == lvl)) {
-			if(*pdce == NULL) {
-				list_del(&e->next);
-				*pdce = e;
-			} else {
-				**pdce = *e;
-			}
-			ret = 0;
-			break;
+	struct srmmu_pdc *pdc = &mmu->pdc[lvl];
+	size_t i = srmmu_pdc_slot(mmu, vaddr, ctx, lvl);
+
+	if(i == PDC_NOSLOT)
+		return -1;
+
+	pdce->pta = pdc->pta[i];
+	pdce->ptd = pdc->ptd[i];
+	pdce->ctx = ctx;
+	pdce->va = vaddr;
+	pdce->lvl = lvl;
+	pdce->slot = i;
+	srmmu_pdc_touch(pdc, i);
+
+	if(lvl == PL_PAGE) {
+		++mmu->stats.hit;
+		if(pdc->pf[i]) {
+			++mmu->stats.useful;
+			pdc->pf[i] = 0;
 		}
 	}
 
-	return ret;
+	return 0;
 }
 
 /**
- * Get, invalidate and unlink the oldest PDC entry.
- *
- * @param dev: Sparc MMU virtual device
+ * Add virtual address translation in cache, replacing an invalid entry or
+ * the pseudo least recently used one of its set.
  *
- * @return: The oldest PDC entry. This entry has been unlinked from the cache,
- * it must be put back in cache with srmmu_pdc_put() after use.
+ * @param mmu: Sparc MMU
+ * @param pdce: Page Descriptor entry to store, its slot is updated
  */
-static inline struct pdc_entry *srmmu_pdc_get(struct srmmu_dev *dev)
+static void srmmu_pdc_insert(struct srmmu *mmu, struct pdc_entry *pdce)
 {
-	struct pdc_entry *res = list_last_entry(&dev->mmu->pdc,
-			struct pdc_entry, next);
-	list_del(&res->next);
-	PDC_INVALIDATE(res);
+	struct srmmu_pdc *pdc = &mmu->pdc[pdce->lvl];
+	size_t i, set = srmmu_pdc_set(mmu, pdce->va, pdce->ctx, pdce->lvl);
+	uint8_t t = pdc->plru[set / SRMMU_PDC_WAYS];
+
+	for(i = set; i < set + SRMMU_PDC_WAYS; ++i)
+		if(!srmmu_pdc_valid(mmu, pdc, i))
+			break;
+
+	if(i == set + SRMMU_PDC_WAYS) {
+		if(t & 0x1)
+			i = set + 2 + ((t >> 2) & 0x1);
+		else
+			i = set + ((t >> 1) & 0x1);
+	}
 
-	return res;
+	/* Page flushes cannot only look at current and supervisor contexts */
+	if((ENTRY_TYPE(pdce->ptd) == ET_PTE) && !PDC_PTE_USER(pdce->ptd) &&
+			(pdce->ctx != CTX_SUPER))
+		mmu->gen.stray = 1;
+
+	pdc->stamp[i] = srmmu_pdc_stamp(mmu, pdce->ctx, pdce->ptd);
+	pdc->pta[i] = pdce->pta;
+	pdc->va[i] = pdce->va;
+	pdc->ctx[i] = pdce->ctx;
+	pdc->ptd[i] = pdce->ptd;
+	pdc->pf[i] = 0;
+	srmmu_pdc_touch(pdc, i);
+	pdce->slot = i;
 }
 
 /**
- * Add virtual address translation in cache. Depending upon its validity, the
- * entry is either add at the head or the tail of the cache.
+ * Check if a cached entry has to be flushed by a page, segment or region
+ * flush
+ *
+ * @param mmu: Sparc MMU
+ * @param ptd: Cached page descriptor
+ * @param ctx: Cached entry context
  *
- * @param dev: Sparc MMU device
- * @param pdce: Page Descriptor entry to store
+ * @return: 1 if entry has to be flushed, 0 otherwise
  */
-static inline void srmmu_pdc_put(struct srmmu_dev *dev, struct pdc_entry *pdce)
+static inline int _srmmu_pdc_flush_page(struct srmmu *mmu, ptd_t ptd,
+		ctx_t ctx)
 {
-	struct srmmu *mmu = dev->mmu;
-
-	if(PDC_IS_VALID(pdce))
-		list_add(&pdce->next, &mmu->pdc);
-	else
-		list_add_tail(&pdce->next, &mmu->pdc);
+	switch(ENTRY_TYPE(ptd)) {
+	case ET_PTE:
+		return (PTE_TO_ACC(ptd) > 5) || (ctx == mmu->reg.ctx);
+	case ET_PTD:
+		return ctx == mmu->reg.ctx;
+	default:
+		/* Just in case, should not happen */
+		return 1;
+	}
 }
 
 /**
- * Flush a PTE from cache depending on the flush level
+ * Flush one PDC level entries matching a page, segment or region flush by
+ * walking through the whole level
  *
- * @param dev: Sparc MMU virtual device
- * @param pte: pte to flush
- * @param type: flushed entry's type (an entire cache flush is done with
- * 		type equals to VFP_ENTIRE)
+ * @param mmu: Sparc MMU
+ * @param pdc: PDC level
+ * @param addr: Flushed address
+ * @param mask: Flushed address mask
  */
-static inline void _srmmu_pdc_flush_pte(struct srmmu_dev *dev,
-		struct pdc_entry *pte, enum vfp_type type)
+static void srmmu_pdc_flush_scan(struct srmmu *mmu, struct srmmu_pdc *pdc,
+		addr_t addr, addr_t mask)
 {
-	struct srmmu *mmu = dev->mmu;
+	size_t i;
 
-	switch(type) {
-	case VFP_PAGE:
-	case VFP_SEG:
-	case VFP_REG:
-		if((PTE_TO_ACC(pte->ptd) > 5) || (pte->ctx == mmu->reg.ctx)) {
-			list_del(&pte->next);
-			PDC_INVALIDATE(pte);
-			list_add_tail(&pte->next, &mmu->pdc);
-		}
-		break;
-	case VFP_CTX:
-		if((PTE_TO_ACC(pte->ptd) < 6) || (pte->ctx == mmu->reg.ctx)) {
-			list_del(&pte->next);
-			PDC_INVALIDATE(pte);
-			list_add_tail(&pte->next, &mmu->pdc);
-		}
-		break;
-	case VFP_ENTIRE:
-		list_del(&pte->next);
-		PDC_INVALIDATE(pte);
-		list_add_tail(&pte->next, &mmu->pdc);
-		break;
-	default:
-		break;
+	for(i = 0; i < mmu->pdcsz; ++i) {
+		if(!srmmu_pdc_valid(mmu, pdc, i))
+			continue;
+
+		if((pdc->va[i] & mask) != (addr & mask))
+			continue;
+
+		if(_srmmu_pdc_flush_page(mmu, pdc->ptd[i], pdc->ctx[i]))
+			pdc->va[i] = PDC_VA_INVAL;
 	}
 }
 
 /**
- * Flush a PTD from cache depending on the flush level
+ * Flush PDC entries of one virtual address and context, only looking in the
+ * set they could have been cached in
  *
- * @param dev: Sparc MMU virtual device
- * @param ptd: ptd to flush
- * @param type: flushed entry's type (an entire cache flush is done with
- * 		type equals to VFP_ENTIRE)
+ * @param mmu: Sparc MMU
+ * @param va: Flushed entries virtual address
+ * @param ctx: Flushed entries context
+ * @param lvl: PDC level
  */
-static inline void _srmmu_pdc_flush_ptd(struct srmmu_dev *dev,
-		struct pdc_entry *ptd, enum vfp_type type)
+static void srmmu_pdc_flush_set(struct srmmu *mmu, addr_t va, ctx_t ctx,
+		enum pdc_lvl lvl)
 {
-	struct srmmu *mmu = dev->mmu;
+	struct srmmu_pdc *pdc = &mmu->pdc[lvl];
+	size_t i, set = srmmu_pdc_set(mmu, va, ctx, lvl);
 
-	switch(type) {
-	case VFP_PAGE:
-	case VFP_SEG:
-	case VFP_REG:
-	case VFP_CTX:
-		if(ptd->ctx == mmu->reg.ctx) {
-			list_del(&ptd->next);
-			PDC_INVALIDATE(ptd);
-			list_add_tail(&ptd->next, &mmu->pdc);
-		}
-		break;
-	case VFP_ENTIRE:
-		list_del(&ptd->next);
-		PDC_INVALIDATE(ptd);
-		list_add_tail(&ptd->next, &mmu->pdc);
-		break;
-	default:
-		break;
+	for(i = set; i < set + SRMMU_PDC_WAYS; ++i) {
+		if((pdc->va[i] != va) || (pdc->ctx[i] != ctx))
+			continue;
+
+		if(!srmmu_pdc_valid(mmu, pdc, i))
+			continue;
+
+		if(_srmmu_pdc_flush_page(mmu, pdc->ptd[i], ctx))
+			pdc->va[i] = PDC_VA_INVAL;
 	}
 }
 
 /**
- * Flush some PDC cache entries
+ * Flush some PDC cache entries. Entire and context flushes only bump flush
+ * generations. Page, segment and region flushes only look in the sets that
+ * could hold flushed entries of current or supervisor context, unless a
+ * supervisor only PTE could have been cached with another context.
  *
  * @param dev: Sparc MMU virtual device
  * @param addr: Entry address to flush when applicable
@@ -279,12 +498,9 @@ static inline void srmmu_pdc_flushcache(struct srmmu_dev *dev,
 		addr_t addr, enum vfp_type type)
 {
 	struct srmmu *mmu = dev->mmu;
-	struct pdc_entry *pdce;
-	enum pdc_lvl lvl = vfp_to_pdc_lvl(type);
-	addr_t mask;
-
-	if(type == VFP_INVAL)
-		return;
+	enum pdc_lvl l, lvl = vfp_to_pdc_lvl(type);
+	addr_t mask, va;
+	size_t i, nr;
 
 	/* Find Addr mask comparison */
 	switch(type) {
@@ -298,38 +514,84 @@ static inline void srmmu_pdc_flushcache(struct srmmu_dev *dev,
 		mask = ~VA_REG_OFF_MASK;
 		break;
 	case VFP_CTX:
+		/* Current context entries and any context user PTEs */
+		++mmu->gen.ctx[PDC_GEN_CTX(mmu->reg.ctx)];
+		++mmu->gen.user;
+		return;
 	case VFP_ENTIRE:
-		mask = 0;
-		break;
+		++mmu->gen.all;
+		mmu->gen.stray = 0;
+		return;
 	default:
 		return;
 	}
 
-	list_for_each_entry(pdce, &mmu->pdc, next) {
-		if(!PDC_IS_VALID(pdce))
-			break;
+	for(l = PL_PAGE; l <= lvl; ++l) {
+		/* Number of level entries the flushed area spans */
+		nr = ((size_t)(~mask) >> _pdc_shift[l]) + 1;
+		if(mmu->gen.stray || (nr >= mmu->pdcsz / SRMMU_PDC_WAYS / 2)) {
+			srmmu_pdc_flush_scan(mmu, &mmu->pdc[l], addr, mask);
+			continue;
+		}
+
+		for(i = 0; i < nr; ++i) {
+			va = (addr & mask) + (i << _pdc_shift[l]);
+			srmmu_pdc_flush_set(mmu, va, mmu->reg.ctx, l);
+			if(mmu->reg.ctx != CTX_SUPER)
+				srmmu_pdc_flush_set(mmu, va, CTX_SUPER, l);
+		}
+	}
+}
+
+/**
+ * Read a window of page table entries around the one translating a virtual
+ * address in one block access, caching valid neighbouring PTEs ahead of use
+ *
+ * @param dev: Sparc MMU virtual device
+ * @param ctx: Current MMU context
+ * @param vaddr: Virtual address being translated
+ * @param pt: Page table physical address
+ * @param ptd: Filled with raw page table entry translating vaddr
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_prefetch(struct srmmu_dev *dev, ctx_t ctx, addr_t vaddr,
+		phyaddr_t pt, ptd_t *ptd)
+{
+	struct srmmu *mmu = dev->mmu;
+	struct dev *mem = dev->mem;
+	ptd_t win[SRMMU_PREFETCH_MAX];
+	struct pdc_entry pe;
+	size_t i, nr = mmu->pfnr, first = VA_PAGE_NR(vaddr) & ~(nr - 1);
+	int ret;
 
-		if((pdce->va & mask) != (addr & mask))
+	ret = dev->phy.read_block(mem, pt + first * sizeof(ptd_t), win,
+			nr * sizeof(ptd_t));
+	if(ret != 0)
+		return ret;
+
+	for(i = 0; i < nr; ++i) {
+		if(first + i == VA_PAGE_NR(vaddr)) {
+			*ptd = win[i];
 			continue;
+		}
 
-		if((type != VFP_ENTIRE) && (pdce->lvl > lvl))
+		PDC_INIT(&pe, VA_SEG_ADDR(vaddr) + ((first + i) << 12), ctx,
+				PL_PAGE);
+		pe.ptd = be32toh(win[i]);
+		if(ENTRY_TYPE(pe.ptd) != ET_PTE)
 			continue;
 
-		switch(ENTRY_TYPE(pdce->ptd)) {
-		case ET_PTE:
-			_srmmu_pdc_flush_pte(dev, pdce, type);
-			break;
-		case ET_PTD:
-			_srmmu_pdc_flush_ptd(dev, pdce, type);
-			break;
-		default:
-			/* Just in case, should not happen */
-			list_del(&pdce->next);
-			PDC_INVALIDATE(pdce);
-			list_add_tail(&pdce->next, &mmu->pdc);
-			break;
-		}
+		if(srmmu_pdc_slot(mmu, pe.va, ctx, PL_PAGE) != PDC_NOSLOT)
+			continue;
+
+		pe.pta = pt + (first + i) * sizeof(ptd_t);
+		srmmu_pdc_insert(mmu, &pe);
+		mmu->pdc[PL_PAGE].pf[pe.slot] = 1;
+		++mmu->stats.prefetch;
 	}
+
+	return 0;
 }
 
 /**
@@ -339,17 +601,17 @@ static inline void srmmu_pdc_flushcache(struct srmmu_dev *dev,
  * @param ctx: Current MMU context
  * @param vaddr: Virtual address being translated
  * @param lvl: Cache probing level (a full cache access has a PL_PAGE lvl)
- * @param pdce: Virtual address PDC entry found or created. If set to NULL, pdc
- * is updated, else the entry pointed by pdce is either filled out with
- * address translation result or pdce is set to point to a cache entry.
+ * @param pdce: Filled out with address translation result
+ * @param cache: If set, PTD levels walked through are added to pdc. The
+ * resulting entry is only added once validated with srmmu_pdc_update().
  *
  * @return: 0 on success (the pdce is filled with proper translation), negative
  * number otherwise.
  */
 static int srmmu_translate(struct srmmu_dev *dev, ctx_t ctx, addr_t vaddr,
-		enum pdc_lvl lvl, struct pdc_entry **pdce)
+		enum pdc_lvl lvl, struct pdc_entry *pdce, int cache)
 {
-	struct pdc_entry *e = *pdce;
+	struct pdc_entry *e = pdce;
 	struct dev *mem = dev->mem;
 	size_t i;
 	phyaddr_t pta;
@@ -367,27 +629,23 @@ static int srmmu_translate(struct srmmu_dev *dev, ctx_t ctx, addr_t vaddr,
 	};
 	int ret;
 
-	if(mem->drv->phyops->read32 == NULL)
-		return -ENOSYS;
-
 	/* Find closest macthing pdc entry */
 	for(i = lvl; i < PL_NR; ++i) {
-		ret = srmmu_pdc_find(dev, addr[i], ctx, i, &e);
+		ret = srmmu_pdc_find(dev->mmu, addr[i], ctx, i, e);
 		if(ret == 0)
 			break;
 	}
 
+	if(i != lvl)
+		++dev->mmu->stats.walk;
+
 	if(ret != 0) {
 		/* XXX ASSERT(i == PL_NR); */
-		ret = mem->drv->phyops->read32(mem,
-				(dev->mmu->reg.ctp << 4) + dev->mmu->reg.ctx,
-				&ptd);
+		ret = dev->phy.read32(mem, (dev->mmu->reg.ctp << 4) +
+				dev->mmu->reg.ctx * sizeof(ptd), &ptd);
 		if(ret != 0)
 			goto out;
 
-		if(*pdce == NULL)
-			e = srmmu_pdc_get(dev);
-
 		--i;
 		PDC_INIT(e, 0, ctx, PL_CTX);
 		e->ptd = be32toh(ptd);
@@ -398,19 +656,19 @@ static int srmmu_translate(struct srmmu_dev *dev, ctx_t ctx, addr_t vaddr,
 
 	/* Walk through, translate and cache all PTD levels */
 	for(; (i > lvl) && (ENTRY_TYPE(e->ptd) == ET_PTD); --i) {
-		if(*pdce == NULL) {
-			PDC_VALIDATE(e);
-			srmmu_pdc_put(dev, e);
-		}
+		if(cache && (e->slot == PDC_NOSLOT))
+			srmmu_pdc_insert(dev->mmu, e);
 
 		pta = (PTD_TO_PTP(e->ptd) << 6) + off[i - 1];
-		ret = mem->drv->phyops->read32(mem, pta, &ptd);
+		ret = -ENOSYS;
+		if(cache && (i - 1 == PL_PAGE) && (dev->mmu->pfnr > 1))
+			ret = srmmu_prefetch(dev, ctx, vaddr,
+					PTD_TO_PTP(e->ptd) << 6, &ptd);
+		if(ret != 0)
+			ret = dev->phy.read32(mem, pta, &ptd);
 		if(ret != 0)
 			goto out;
 
-		if(*pdce == NULL)
-			e = srmmu_pdc_get(dev);
-
 		PDC_INIT(e, addr[i - 1], ctx, i - 1);
 		e->ptd = be32toh(ptd);
 	}
@@ -421,7 +679,6 @@ static int srmmu_translate(struct srmmu_dev *dev, ctx_t ctx, addr_t vaddr,
 
 	/* Translation succeed */
 	e->pta = pta;
-	*pdce = e;
 	ret = 0;
 
 out:
@@ -429,7 +686,7 @@ out:
 }
 
 /**
- * Update a Page descriptor PTE
+ * Update a Page descriptor PTE, and cache it
  *
  * @param dev: Current Sparc MMU virtual device
  * @param pdce: Page descriptor to update
@@ -442,24 +699,22 @@ static inline int srmmu_pdc_update(struct srmmu_dev *dev,
 {
 	struct dev *mem = dev->mem;
 	pte_t new = pdce->ptd | flags;
-	int ret = -ENOSYS;
-
-	if(!mem->drv->phyops->write32)
-		goto out;
+	int ret = -EINVAL;
 
-	ret = -EINVAL;
 	if(ENTRY_TYPE(pdce->ptd) != ET_PTE)
 		goto out;
 
 	if(new != pdce->ptd) {
 		pdce->ptd = new;
-		ret = mem->drv->phyops->write32(mem, pdce->pta,
-				htobe32(pdce->ptd));
+		ret = dev->phy.write32(mem, pdce->pta, htobe32(pdce->ptd));
 		if(ret != 0)
 			goto out;
 	}
 
-	PDC_VALIDATE(pdce);
+	if(pdce->slot == PDC_NOSLOT)
+		srmmu_pdc_insert(dev->mmu, pdce);
+	else
+		dev->mmu->pdc[pdce->lvl].ptd[pdce->slot] = pdce->ptd;
 	ret = 0;
 
 out:
@@ -467,58 +722,298 @@ out:
 }
 
 /**
- * Access MMU memory
+ * Access MMU memory through a full address translation, micro-TLB missed
+ *
+ * @param mdev: MMU virtual device
+ * @param acc: MMU transaction description
+ * @param ctx: MMU context
+ * @param vaddr: Accessed virtual address
+ * @param ptr: Accessed data
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_access_walk(struct srmmu_dev *mdev,
+		struct srmmu_access const *acc, ctx_t ctx, addr_t vaddr,
+		void *ptr)
+{
+	struct srmmu_utlb *u;
+	struct pdc_entry pdce;
+	phyaddr_t pa;
+	int ret;
+
+	ret = srmmu_translate(mdev, ctx, vaddr, PL_PAGE, &pdce, 1);
+	if(ret != 0)
+		goto out;
+
+	/* Check access permissions */
+	ret = -EPERM;
+	if(!acc->ptecheck(&pdce))
+		goto out;
+
+	/* Fetch requested value */
+	pa = pdc_to_phyaddr(&pdce, vaddr);
+	ret = acc->phyacc(mdev->mem, &mdev->phy, pa, ptr);
+	if(ret != 0)
+		goto out;
+
+	ret = srmmu_pdc_update(mdev, &pdce, acc->flag);
+	if(ret != 0)
+		goto out;
+
+	u = &mdev->utlb[acc->kind][SRMMU_UTLB_IDX(vaddr)];
+	u->va = VA_PAGE_ADDR(vaddr);
+	u->ctx = ctx;
+	u->gen = mdev->mmu->utlbgen;
+	u->pa = pdc_to_phyaddr(&pdce, u->va);
+
+out:
+	return ret;
+}
+
+/**
+ * Access MMU memory. This is always inlined so that each access entry point
+ * gets its own path, with physical access and permission check resolved at
+ * compile time.
  *
  * @param dev: MMU virtual device dev pointer
  * @param acc: MMU transaction description
+ * @param ctx: MMU context
+ * @param vaddr: Accessed virtual address
+ * @param ptr: Accessed data
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static inline __attribute__((always_inline)) int srmmu_access(
+		struct dev *dev, struct srmmu_access const *acc, ctx_t ctx,
+		addr_t vaddr, void *ptr)
+{
+	struct srmmu_dev *mdev = to_srmmu_dev(dev);
+	struct srmmu_utlb *u;
+
+	/* MMU disabled, passthrough */
+	if(!CTRL_EN(&mdev->mmu->reg))
+		return acc->phyacc(mdev->mem, &mdev->phy, (phyaddr_t)vaddr,
+				ptr);
+
+	/* Page already translated and checked for this kind of access */
+	u = &mdev->utlb[acc->kind][SRMMU_UTLB_IDX(vaddr)];
+	if((u->va == VA_PAGE_ADDR(vaddr)) && (u->ctx == ctx) &&
+			(u->gen == mdev->mmu->utlbgen))
+		return acc->phyacc(mdev->mem, &mdev->phy,
+				u->pa | VA_PAGE_OFF(vaddr), ptr);
+
+	return srmmu_access_walk(mdev, acc, ctx, vaddr, ptr);
+}
+
+/**
+ * Copy a block from or to virtual memory, one page at a time
+ *
+ * @param dev: MMU virtual device dev pointer
+ * @param ctx: MMU context
+ * @param vaddr: Virtual address of block
+ * @param buf: Block data
+ * @param len: Block size in bytes
+ * @param wr: 1 to write block to memory, 0 to read it
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_block(struct dev *dev, ctx_t ctx, addr_t vaddr, void *buf,
+		size_t len, int wr)
+{
+	static struct srmmu_access const acc[] = {
+		SRMMU_ACCESS_INIT(read, _block, PTE_R),
+		SRMMU_ACCESS_INIT(write, _block, PTE_R | PTE_M),
+	};
+	struct srmmu_block blk;
+	int ret;
+
+	for(; len != 0; vaddr += blk.len, buf = (uint8_t *)buf + blk.len,
+			len -= blk.len) {
+		blk.buf = buf;
+		blk.len = VA_PAGE_OFF_MASK + 1 - VA_PAGE_OFF(vaddr);
+		if(blk.len > len)
+			blk.len = len;
+
+		ret = srmmu_access(dev, &acc[!!wr], ctx, vaddr, &blk);
+		if(ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * Copy a block from user data memory
+ */
+static int srmmu_uread_block(struct dev *dev, addr_t vaddr, void *buf,
+		size_t len)
+{
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_block(dev, mmu->reg.ctx, vaddr, buf, len, 0);
+}
+
+/**
+ * Copy a block to user data memory
+ */
+static int srmmu_uwrite_block(struct dev *dev, addr_t vaddr, void const *buf,
+		size_t len)
+{
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_block(dev, mmu->reg.ctx, vaddr, (void *)buf, len, 1);
+}
+
+/**
+ * Copy a block from supervisor data memory
+ */
+static int srmmu_sread_block(struct dev *dev, addr_t vaddr, void *buf,
+		size_t len)
+{
+	return srmmu_block(dev, CTX_SUPER, vaddr, buf, len, 0);
+}
+
+/**
+ * Copy a block to supervisor data memory
+ */
+static int srmmu_swrite_block(struct dev *dev, addr_t vaddr, void const *buf,
+		size_t len)
+{
+	return srmmu_block(dev, CTX_SUPER, vaddr, (void *)buf, len, 1);
+}
+
+/**
+ * Get host memory backing a virtual page. Write (resp. read) permission is
+ * only given once the PTE M (resp. R) bit is set, so that direct accesses
+ * never skip a PTE update.
+ *
+ * @param dev: MMU virtual device dev pointer
+ * @param ctx: MMU context
+ * @param vaddr: Virtual address to look up
+ * @param isn: 1 for instruction virtual device, 0 for data one
+ * @param hm: Filled with host memory backing vaddr page
  *
  * @return: 0 on success, negative number otherwise
  */
-static int srmmu_access(struct dev *dev, struct srmmu_access const *acc)
+static int srmmu_hostmem(struct dev *dev, ctx_t ctx, addr_t vaddr, int isn,
+		struct dev_hostmem *hm)
 {
 	struct srmmu_dev *mdev = to_srmmu_dev(dev);
 	struct dev *mem = mdev->mem;
-	struct pdc_entry *pdce = NULL;
+	struct pdc_entry pdce;
 	phyaddr_t pa;
+	perm_t phyperm, allowed = 0, perm = 0;
 	int ret = -ENOSYS;
 
+	if(!mem->drv->phyops->hostmem)
+		goto out;
+
 	/* MMU disabled, passthrough */
-	if(!CTRL_EN(&mdev->mmu->reg))
-		return acc->phyacc(mem, (phyaddr_t)acc->addr, acc->ptr);
+	if(!CTRL_EN(&mdev->mmu->reg)) {
+		ret = mem->drv->phyops->hostmem(mem, (phyaddr_t)vaddr, hm);
+		if(ret != 0)
+			goto out;
+		if(hm->addr + hm->sz > ((phyaddr_t)1 << 32))
+			hm->sz = ((phyaddr_t)1 << 32) - hm->addr;
+		if(isn)
+			hm->perm = (hm->perm & MP_X) ? MP_R : 0;
+		else
+			hm->perm &= MP_R | MP_W;
+		goto out;
+	}
 
-	ret = srmmu_translate(mdev, acc->ctx, acc->addr, PL_PAGE, &pdce);
+	ret = srmmu_translate(mdev, ctx, vaddr, PL_PAGE, &pdce, 1);
 	if(ret != 0)
 		goto out;
 
-	/* Check access permissions */
-	ret = -EPERM;
-	if(!acc->ptecheck(pdce))
+	pa = pdc_to_phyaddr(&pdce, VA_PAGE_ADDR(vaddr));
+	ret = mem->drv->phyops->hostmem(mem, pa, hm);
+	if(ret != 0)
 		goto out;
 
-	/* Fetch requested value */
-	pa = pdc_to_phyaddr(pdce, acc->addr);
-	ret = acc->phyacc(mem, pa, acc->ptr);
-	if(ret != 0)
+	/* Only the translated page can be exposed */
+	ret = -ERANGE;
+	if(hm->addr + hm->sz < pa + VA_PAGE_OFF_MASK + 1)
 		goto out;
 
-	ret = srmmu_pdc_update(mdev, pdce, acc->flag);
+	phyperm = hm->perm;
+	if(isn) {
+		if(pdc_pte_exec(&pdce) && (phyperm & MP_X))
+			allowed |= MP_R;
+	} else {
+		if(pdc_pte_read(&pdce) && (phyperm & MP_R))
+			allowed |= MP_R;
+		if(pdc_pte_write(&pdce) && (phyperm & MP_W))
+			allowed |= MP_W;
+	}
+
+	/* Direct accesses need the PTE bit they would have set */
+	if(PTE_TO_R(pdce.ptd))
+		perm |= allowed & MP_R;
+	if(PTE_TO_M(pdce.ptd))
+		perm |= allowed & MP_W;
+
+	hm->host += pa - hm->addr;
+	hm->addr = VA_PAGE_ADDR(vaddr);
+	hm->sz = VA_PAGE_OFF_MASK + 1;
+	hm->perm = perm;
+	hm->pending = allowed & ~perm;
+	ret = 0;
 
 out:
-	if(pdce != NULL)
-		srmmu_pdc_put(mdev, pdce);
 	return ret;
 }
 
+/**
+ * Get host memory backing user data memory
+ */
+static int srmmu_uhostmem(struct dev *dev, addr_t vaddr,
+		struct dev_hostmem *hm)
+{
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_hostmem(dev, mmu->reg.ctx, vaddr, 0, hm);
+}
+
+/**
+ * Get host memory backing supervisor data memory
+ */
+static int srmmu_shostmem(struct dev *dev, addr_t vaddr,
+		struct dev_hostmem *hm)
+{
+	return srmmu_hostmem(dev, CTX_SUPER, vaddr, 0, hm);
+}
+
+/**
+ * Get host memory backing user instruction memory
+ */
+static int srmmu_uihostmem(struct dev *dev, addr_t vaddr,
+		struct dev_hostmem *hm)
+{
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_hostmem(dev, mmu->reg.ctx, vaddr, 1, hm);
+}
+
+/**
+ * Get host memory backing supervisor instruction memory
+ */
+static int srmmu_sihostmem(struct dev *dev, addr_t vaddr,
+		struct dev_hostmem *hm)
+{
+	return srmmu_hostmem(dev, CTX_SUPER, vaddr, 1, hm);
+}
+
 /**
  * Fetch a 8 bit value from user data memory
  */
 static int srmmu_uread8(struct dev *dev, addr_t vaddr, uint8_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 8,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, read, 8, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -526,11 +1021,11 @@ static int srmmu_uread8(struct dev *dev, addr_t vaddr, uint8_t *val)
  */
 static int srmmu_uread16(struct dev *dev, addr_t vaddr, uint16_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 16,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, read, 16, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -538,11 +1033,23 @@ static int srmmu_uread16(struct dev *dev, addr_t vaddr, uint16_t *val)
  */
 static int srmmu_uread32(struct dev *dev, addr_t vaddr, uint32_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 32,
+			PTE_R);
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
+}
+
+/**
+ * Fetch a 64 bit value from user data memory
+ */
+static int srmmu_uread64(struct dev *dev, addr_t vaddr, uint64_t *val)
+{
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 64,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, read, 32, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -550,11 +1057,11 @@ static int srmmu_uread32(struct dev *dev, addr_t vaddr, uint32_t *val)
  */
 static int srmmu_uwrite8(struct dev *dev, addr_t vaddr, uint8_t val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 8,
+			PTE_R | PTE_M);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			&val, write, 8, PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, &val);
 }
 
 /**
@@ -562,11 +1069,11 @@ static int srmmu_uwrite8(struct dev *dev, addr_t vaddr, uint8_t val)
  */
 static int srmmu_uwrite16(struct dev *dev, addr_t vaddr, uint16_t val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 16,
+			PTE_R | PTE_M);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			&val, write, 16, PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, &val);
 }
 
 /**
@@ -574,11 +1081,23 @@ static int srmmu_uwrite16(struct dev *dev, addr_t vaddr, uint16_t val)
  */
 static int srmmu_uwrite32(struct dev *dev, addr_t vaddr, uint32_t val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 32,
+			PTE_R | PTE_M);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			&val, write, 32, PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, &val);
+}
+
+/**
+ * Write a 64 bit value to user data memory
+ */
+static int srmmu_uwrite64(struct dev *dev, addr_t vaddr, uint64_t val)
+{
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 64,
+			PTE_R | PTE_M);
+	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
+
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, &val);
 }
 
 /**
@@ -586,11 +1105,11 @@ static int srmmu_uwrite32(struct dev *dev, addr_t vaddr, uint32_t val)
  */
 static int srmmu_ufetch8(struct dev *dev, addr_t vaddr, uint8_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 8,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, exec, 8, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -598,11 +1117,11 @@ static int srmmu_ufetch8(struct dev *dev, addr_t vaddr, uint8_t *val)
  */
 static int srmmu_ufetch16(struct dev *dev, addr_t vaddr, uint16_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 16,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, exec, 16, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -610,11 +1129,11 @@ static int srmmu_ufetch16(struct dev *dev, addr_t vaddr, uint16_t *val)
  */
 static int srmmu_ufetch32(struct dev *dev, addr_t vaddr, uint32_t *val)
 {
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 32,
+			PTE_R);
 	struct srmmu *mmu = to_srmmu_dev(dev)->mmu;
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(mmu->reg.ctx, vaddr,
-			val, exec, 32, PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, mmu->reg.ctx, vaddr, val);
 }
 
 /**
@@ -622,10 +1141,10 @@ static int srmmu_ufetch32(struct dev *dev, addr_t vaddr, uint32_t *val)
  */
 static int srmmu_sread8(struct dev *dev, addr_t vaddr, uint8_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, read, 8, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 8,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -633,10 +1152,10 @@ static int srmmu_sread8(struct dev *dev, addr_t vaddr, uint8_t *val)
  */
 static int srmmu_sread16(struct dev *dev, addr_t vaddr, uint16_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, read, 16, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 16,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -644,10 +1163,21 @@ static int srmmu_sread16(struct dev *dev, addr_t vaddr, uint16_t *val)
  */
 static int srmmu_sread32(struct dev *dev, addr_t vaddr, uint32_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, read, 32, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 32,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
+}
+
+/**
+ * Fetch a 64 bit value from supervisor data memory
+ */
+static int srmmu_sread64(struct dev *dev, addr_t vaddr, uint64_t *val)
+{
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(read, 64,
+			PTE_R);
+
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -655,10 +1185,10 @@ static int srmmu_sread32(struct dev *dev, addr_t vaddr, uint32_t *val)
  */
 static int srmmu_swrite8(struct dev *dev, addr_t vaddr, uint8_t val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			&val, write, 8, PTE_R | PTE_M);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 8,
+			PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, &val);
 }
 
 /**
@@ -666,10 +1196,10 @@ static int srmmu_swrite8(struct dev *dev, addr_t vaddr, uint8_t val)
  */
 static int srmmu_swrite16(struct dev *dev, addr_t vaddr, uint16_t val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			&val, write, 16, PTE_R | PTE_M);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 16,
+			PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, &val);
 }
 
 /**
@@ -677,10 +1207,21 @@ static int srmmu_swrite16(struct dev *dev, addr_t vaddr, uint16_t val)
  */
 static int srmmu_swrite32(struct dev *dev, addr_t vaddr, uint32_t val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			&val, write, 32, PTE_R | PTE_M);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 32,
+			PTE_R | PTE_M);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, &val);
+}
+
+/**
+ * Write a 64 bit value to supervisor data memory
+ */
+static int srmmu_swrite64(struct dev *dev, addr_t vaddr, uint64_t val)
+{
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(write, 64,
+			PTE_R | PTE_M);
+
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, &val);
 }
 
 /**
@@ -688,10 +1229,10 @@ static int srmmu_swrite32(struct dev *dev, addr_t vaddr, uint32_t val)
  */
 static int srmmu_sfetch8(struct dev *dev, addr_t vaddr, uint8_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, exec, 8, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 8,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -699,10 +1240,10 @@ static int srmmu_sfetch8(struct dev *dev, addr_t vaddr, uint8_t *val)
  */
 static int srmmu_sfetch16(struct dev *dev, addr_t vaddr, uint16_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, exec, 16, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 16,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -710,10 +1251,10 @@ static int srmmu_sfetch16(struct dev *dev, addr_t vaddr, uint16_t *val)
  */
 static int srmmu_sfetch32(struct dev *dev, addr_t vaddr, uint32_t *val)
 {
-	struct srmmu_access acc = SRMMU_ACCESS_INIT(CTX_SUPER, vaddr,
-			val, exec, 32, PTE_R);
+	static struct srmmu_access const acc = SRMMU_ACCESS_INIT(exec, 32,
+			PTE_R);
 
-	return srmmu_access(dev, &acc);
+	return srmmu_access(dev, &acc, CTX_SUPER, vaddr, val);
 }
 
 /**
@@ -739,8 +1280,12 @@ static int srmmu_vdev_create(struct dev **dev, struct devcfg const *cfg)
 	if(mdev->mem == NULL)
 		goto out;
 
+	/* Resolve missing memory operations once */
+	srmmu_phyops_bind(&mdev->phy, mdev->mem);
+
 	mdev->mmu = scfg->mmu;
 	mdev->asi = _vdev_desc[scfg->type].asi;
+	srmmu_vdev_utlb_flush(mdev);
 
 	ret = scpu_register_mem(mdev->mmu->cpu, mdev->asi, &mdev->dev);
 	if(ret != 0)
@@ -770,9 +1315,8 @@ static void srmmu_vdev_destroy(struct dev *dev)
  */
 static int srmmu_pdc_probe(struct dev *dev, addr_t addr, uint32_t *val)
 {
-	struct pdc_entry _entry;
 	struct srmmu_dev *mdev = to_srmmu_dev(dev);
-	struct pdc_entry *pdce = &_entry;
+	struct pdc_entry pdce;
 	addr_t va = VFP_ADDR(addr);
 	enum vfp_type type = VFP_TYPE(addr);
 	enum pdc_lvl lvl = vfp_to_pdc_lvl(type);
@@ -786,29 +1330,24 @@ static int srmmu_pdc_probe(struct dev *dev, addr_t addr, uint32_t *val)
 	if(type == VFP_INVAL)
 		goto out;
 
-	/* Update cache */
-	if(type == VFP_ENTIRE)
-		pdce = NULL;
-
-	ret = srmmu_translate(mdev, mdev->mmu->reg.ctx, va, lvl, &pdce);
+	/* Only update cache when type is VFP_ENTIRE */
+	ret = srmmu_translate(mdev, mdev->mmu->reg.ctx, va, lvl, &pdce,
+			type == VFP_ENTIRE);
 	if(ret == 0)
 		goto out;
 
 	/* This is not a proper level cache entry */
-	if((type != VFP_ENTIRE) && (pdce->lvl != lvl))
+	if((type != VFP_ENTIRE) && (pdce.lvl != lvl))
 		goto out;
 
 	if(type == VFP_ENTIRE) {
-		/* Only update when type is VFP_ENTIRE */
-		ret = srmmu_pdc_update(mdev, pdce, PTE_R);
+		ret = srmmu_pdc_update(mdev, &pdce, PTE_R);
 		if(ret == 0)
 			goto out;
 	}
 
-	*val = pdce->ptd;
+	*val = pdce.ptd;
 out:
-	if(pdce != NULL)
-		srmmu_pdc_put(mdev, pdce);
 	return 0;
 }
 
@@ -829,6 +1368,9 @@ static int srmmu_pdc_flush(struct dev *dev, addr_t addr, uint32_t val)
 		goto out;
 
 	srmmu_pdc_flushcache(mdev, vfpa, type);
+	srmmu_utlb_flush(mdev->mmu);
+	scpu_flush_isn_cache(mdev->mmu->cpu);
+	scpu_flush_hostmem(mdev->mmu->cpu);
 
 out:
 	return 0;
@@ -886,18 +1428,71 @@ static int srmmu_wrreg(struct dev *dev, addr_t addr, uint32_t val)
 			mmu->reg.ctp = be32toh(val) & ~(0x3);
 		break;
 	case SRMMU_REG_CTX_ADDR:
-		if(val <= CTX_MAX)
+		if(be32toh(val) <= CTX_MAX)
 			mmu->reg.ctx = be32toh(val);
 		break;
 	case SRMMU_REG_FSR_ADDR:
 	case SRMMU_REG_FAR_ADDR:
-		break;
+		return 0;
 	default:
 		/*
 		 * TODO Sparc Manual is not clear about undefined sparc register
 		 * accesses. For now they are just ignored.
 		 */
-		break;
+		return 0;
+	}
+
+	/* Address translation may have changed */
+	srmmu_utlb_flush(mmu);
+	scpu_flush_isn_cache(mmu->cpu);
+	scpu_flush_hostmem(mmu->cpu);
+	return 0;
+}
+
+/**
+ * Allocate and invalidate the page descriptor cache
+ *
+ * @param mmu: Sparc MMU
+ * @param sz: Number of entries per level, rounded up to a power of two, 0
+ * for default
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_pdc_init(struct srmmu *mmu, size_t sz)
+{
+	uint8_t *p;
+	size_t i, n = SRMMU_PDC_WAYS;
+	enum pdc_lvl l;
+
+	if(sz == 0)
+		sz = SRMMU_PDC_DEFSZ;
+	while(n < sz)
+		n <<= 1;
+
+	mmu->pdcsz = n;
+	memset(&mmu->gen, 0, sizeof(mmu->gen));
+	mmu->pdcmem = malloc(PL_NR * srmmu_pdc_lvlsz(n));
+	if(mmu->pdcmem == NULL)
+		return -ENOMEM;
+
+	p = mmu->pdcmem;
+	for(l = PL_PAGE; l < PL_NR; ++l, p += srmmu_pdc_lvlsz(n)) {
+		mmu->pdc[l].stamp = (uint64_t *)p;
+		mmu->pdc[l].pta = (phyaddr_t *)(mmu->pdc[l].stamp + n);
+		mmu->pdc[l].va = (addr_t *)(mmu->pdc[l].pta + n);
+		mmu->pdc[l].ctx = (ctx_t *)(mmu->pdc[l].va + n);
+		mmu->pdc[l].ptd = (ptd_t *)(mmu->pdc[l].ctx + n);
+		mmu->pdc[l].pf = (uint8_t *)(mmu->pdc[l].ptd + n);
+		mmu->pdc[l].plru = mmu->pdc[l].pf + n;
+
+		memset(mmu->pdc[l].stamp, 0, n * sizeof(uint64_t));
+		memset(mmu->pdc[l].pta, 0, n * sizeof(phyaddr_t));
+		for(i = 0; i < n; ++i)
+			mmu->pdc[l].va[i] = PDC_VA_INVAL;
+		memset(mmu->pdc[l].ctx, 0, n * sizeof(ctx_t));
+		memset(mmu->pdc[l].ptd, 0, n * sizeof(ptd_t));
+		memset(mmu->pdc[l].pf, 0, n);
+		memset(mmu->pdc[l].plru, 0, n / SRMMU_PDC_WAYS);
 	}
 
 	return 0;
@@ -966,6 +1561,8 @@ static int srmmu_create(struct dev **dev, struct devcfg const *cfg)
 	if(mmu == NULL)
 		goto err;
 
+	mmu->pdcmem = NULL;
+	mmu->utlbgen = 0;
 	SRMMU_REG_INIT(&mmu->reg);
 
 	ret = -ENODEV;
@@ -974,11 +1571,21 @@ static int srmmu_create(struct dev **dev, struct devcfg const *cfg)
 		goto err;
 
 	/* Initialize SRMMU page cache */
-	INIT_LIST_HEAD(&mmu->pdc);
-	for(i = 0; i < SRMMU_CACHESZ; ++i) {
-		PDC_INVALIDATE(&mmu->pdesc[i]);
-		list_add(&mmu->pdesc[i].next, &mmu->pdc);
-	}
+	ret = srmmu_pdc_init(mmu, scfg->pdcsz);
+	if(ret != 0)
+		goto err;
+
+	/*
+	 * Page table walk prefetch window, consecutive pages fall in
+	 * consecutive PDC sets so that a window no larger than the number of
+	 * sets evicts at most one entry per set
+	 */
+	mmu->pfnr = 1;
+	while((mmu->pfnr < scfg->prefetch) &&
+			(mmu->pfnr < SRMMU_PREFETCH_MAX) &&
+			(mmu->pfnr < mmu->pdcsz / SRMMU_PDC_WAYS))
+		mmu->pfnr <<= 1;
+	memset(&mmu->stats, 0, sizeof(mmu->stats));
 
 	/* Configure data and instruction memory virtual devices */
 	ret = -EINVAL;
@@ -1010,11 +1617,81 @@ derr:
 		dev_destroy(&mmu->vdev[vcfg->type].dev);
 	}
 err:
-	if(mmu)
+	if(mmu) {
+		free(mmu->pdcmem);
 		free(mmu);
+	}
 	return ret;
 }
 
+/* Saved sparc reference mmu state */
+struct srmmu_snap {
+	struct srmmu_reg reg;
+	struct srmmu_pdc_gen gen;
+	/* PDC levels arrays */
+	uint8_t pdc[];
+};
+
+/**
+ * Save sparc reference mmu registers and page descriptor cache
+ *
+ * @param dev: Device to save
+ * @param snap: Set to newly allocated snapshot
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_snapshot(struct dev *dev, void **snap)
+{
+	struct srmmu *mmu = to_srmmu(dev);
+	size_t sz = PL_NR * srmmu_pdc_lvlsz(mmu->pdcsz);
+	struct srmmu_snap *s;
+
+	s = malloc(sizeof(*s) + sz);
+	if(s == NULL)
+		return -ENOMEM;
+
+	s->reg = mmu->reg;
+	s->gen = mmu->gen;
+	memcpy(s->pdc, mmu->pdcmem, sz);
+
+	*snap = s;
+	return 0;
+}
+
+/**
+ * Restore sparc reference mmu registers and page descriptor cache
+ *
+ * @param dev: Device to restore
+ * @param snap: Snapshot to restore from
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+static int srmmu_restore(struct dev *dev, void const *snap)
+{
+	struct srmmu *mmu = to_srmmu(dev);
+	struct srmmu_snap const *s = snap;
+
+	mmu->reg = s->reg;
+	mmu->gen = s->gen;
+	memcpy(mmu->pdcmem, s->pdc, PL_NR * srmmu_pdc_lvlsz(mmu->pdcsz));
+	srmmu_utlb_flush(mmu);
+
+	scpu_flush_isn_cache(mmu->cpu);
+	scpu_flush_hostmem(mmu->cpu);
+
+	return 0;
+}
+
+/**
+ * Free a sparc reference mmu snapshot
+ */
+static void srmmu_snapshot_free(struct dev *dev, void *snap)
+{
+	(void)dev;
+
+	free(snap);
+}
+
 /**
  * Destroy a sparc reference mmu device
  *
@@ -1028,6 +1705,7 @@ static void srmmu_destroy(struct dev *dev)
 	for(i = 0; i < ARRAY_SIZE(mmu->vdev); ++i)
 		dev_destroy(&mmu->vdev[i].dev);
 
+	free(mmu->pdcmem);
 	free(mmu);
 }
 
@@ -1052,9 +1730,14 @@ static struct devops const srmmuudops = {
 	.read8 = srmmu_uread8,
 	.read16 = srmmu_uread16,
 	.read32 = srmmu_uread32,
+	.read64 = srmmu_uread64,
 	.write8 = srmmu_uwrite8,
 	.write16 = srmmu_uwrite16,
 	.write32 = srmmu_uwrite32,
+	.write64 = srmmu_uwrite64,
+	.read_block = srmmu_uread_block,
+	.write_block = srmmu_uwrite_block,
+	.hostmem = srmmu_uhostmem,
 };
 
 static struct drv const srmmu_udata = {
@@ -1070,9 +1753,14 @@ static struct devops const srmmusdops = {
 	.read8 = srmmu_sread8,
 	.read16 = srmmu_sread16,
 	.read32 = srmmu_sread32,
+	.read64 = srmmu_sread64,
 	.write8 = srmmu_swrite8,
 	.write16 = srmmu_swrite16,
 	.write32 = srmmu_swrite32,
+	.write64 = srmmu_swrite64,
+	.read_block = srmmu_sread_block,
+	.write_block = srmmu_swrite_block,
+	.hostmem = srmmu_shostmem,
 };
 
 static struct drv const srmmu_sdata = {
@@ -1088,6 +1776,7 @@ static struct devops const srmmuuiops = {
 	.read8 = srmmu_ufetch8,
 	.read16 = srmmu_ufetch16,
 	.read32 = srmmu_ufetch32,
+	.hostmem = srmmu_uihostmem,
 };
 
 static struct drv const srmmu_uisn = {
@@ -1103,6 +1792,7 @@ static struct devops const srmmusiops = {
 	.read8 = srmmu_sfetch8,
 	.read16 = srmmu_sfetch16,
 	.read32 = srmmu_sfetch32,
+	.hostmem = srmmu_sihostmem,
 };
 
 static struct drv const srmmu_sisn = {
@@ -1117,6 +1807,9 @@ static struct devops const srmmuops = {
 	.destroy = srmmu_destroy,
 	.read32 = srmmu_rdreg,
 	.write32 = srmmu_wrreg,
+	.snapshot = srmmu_snapshot,
+	.restore = srmmu_restore,
+	.snapshot_free = srmmu_snapshot_free,
 };
 
 static struct drv const srmmu = {
@@ -1124,3 +1817,20 @@ static struct drv const srmmu = {
 	.ops = &srmmuops,
 };
 DRIVER_REGISTER(srmmu);
+
+/**
+ * Get reference sparc MMU page descriptor cache statistics
+ *
+ * @param dev: Sparc reference MMU device
+ * @param st: Filled with MMU statistics
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int sparc_srmmu_stats(struct dev *dev, struct sparc_srmmu_stats *st)
+{
+	if(dev->drv != &srmmu)
+		return -EINVAL;
+
+	*st = to_srmmu(dev)->stats;
+	return 0;
+}
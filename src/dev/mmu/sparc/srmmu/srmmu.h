@@ -63,22 +63,20 @@ enum  pdc_lvl {
 };
 
 struct pdc_entry {
-	struct list_head next;
 	phyaddr_t pta; /* Page Table entry address */
 	ptd_t ptd;
 	ctx_t ctx;
 	addr_t va;
 	enum pdc_lvl lvl;
+	size_t slot; /* PDC slot caching this entry, PDC_NOSLOT if none */
 };
-#define PDC_IS_VALID(p) (VA_PAGE_OFF(p->va) == 0)
-#define PDC_INVALIDATE(p) ((p)->va |= VA_PAGE_OFF_MASK)
-#define PDC_VALIDATE(p) ((p)->va &= ~VA_PAGE_OFF_MASK)
+#define PDC_NOSLOT ((size_t)-1)
 #define PDC_INIT(p, a, c, l) do {					\
 	(p)->va = (a) & ~VA_PAGE_OFF_MASK;				\
-	PDC_INVALIDATE(p);						\
 	(p)->ctx = c;							\
 	(p)->pta = 0;							\
 	(p)->lvl = l;							\
+	(p)->slot = PDC_NOSLOT;						\
 } while(0);
 
 static inline int pdc_pte_read(struct pdc_entry *pdce)
@@ -23,6 +23,32 @@ struct cpucfg {
 };
 #define CPUCFG(n) &(struct n)
 
+/**
+ * Reason why a cpu run stopped
+ */
+enum cpu_stop {
+	/* Instruction budget exhausted */
+	CS_BUDGET,
+	/* Cpu entered error mode */
+	CS_ERROR,
+	/* A caught trap has been taken */
+	CS_TRAP,
+	/* A PC breakpoint has been hit */
+	CS_BREAK,
+	/* A device requested the cpu to stop */
+	CS_DEVREQ,
+};
+
+/**
+ * Cpu run result
+ */
+struct cpu_run {
+	/* Why the cpu stopped */
+	enum cpu_stop stop;
+	/* Number of executed instructions */
+	size_t nrisn;
+};
+
 /**
  * Cpu operations
  */
@@ -54,6 +80,22 @@ struct cpu_ops {
 	 * Instruction execution operation
 	 */
 	int (*exec)(struct cpu *cpu);
+	/**
+	 * Execute up to budget instructions
+	 */
+	int (*run)(struct cpu *cpu, size_t budget, struct cpu_run *res);
+	/**
+	 * Save cpu state into a newly allocated snapshot
+	 */
+	int (*snapshot)(struct cpu *cpu, void **snap);
+	/**
+	 * Restore cpu state from a snapshot
+	 */
+	int (*restore)(struct cpu *cpu, void const *snap);
+	/**
+	 * Free a cpu snapshot
+	 */
+	void (*snapshot_free)(struct cpu *cpu, void *snap);
 };
 
 /**
@@ -86,6 +128,11 @@ struct cpu {
 	 * Cpu unique name
 	 */
 	char name[CPUNAMESZ];
+	/*
+	 * Stop request from a device, checked between two instructions by
+	 * cpu run operation
+	 */
+	volatile int stopreq;
 };
 
 /**
@@ -98,9 +145,16 @@ struct cpu {
 int cpu_fetch(struct cpu *c);
 int cpu_decode(struct cpu *c);
 int cpu_exec(struct cpu *c);
+int cpu_run(struct cpu *c, size_t budget, struct cpu_run *res);
+void cpu_stop_request(struct cpu *c);
 int cpu_boot(struct cpu *c, addr_t addr);
 struct cpu *cpu_create(struct cpucfg const *cfg);
 int cpu_destroy(struct cpu *c);
 struct cpu *cpu_get(char const *name);
 
+struct cpu_snapshot;
+struct cpu_snapshot *cpu_snapshot_take(void);
+int cpu_snapshot_restore(struct cpu_snapshot const *snap);
+void cpu_snapshot_free(struct cpu_snapshot *snap);
+
 #endif
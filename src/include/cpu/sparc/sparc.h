@@ -13,5 +13,17 @@ typedef uint8_t asi_t;
 int scpu_register_mem(struct cpu * cpu, asi_t id, struct dev *dev);
 /* Remove a memory controller for sparc alternate space accesses */
 int scpu_remove_mem(struct cpu * cpu, asi_t id);
+/* Drop predecoded instructions (e.g. on instruction address mapping change) */
+void scpu_flush_isn_cache(struct cpu *cpu);
+/* Drop cached host memory pointers (e.g. on data address mapping change) */
+void scpu_flush_hostmem(struct cpu *cpu);
+/* Set a PC breakpoint that stops cpu run */
+int scpu_set_break(struct cpu *cpu, addr_t addr);
+/* Remove a PC breakpoint */
+int scpu_clear_break(struct cpu *cpu, addr_t addr);
+/* Stop cpu run when a specific trap is taken */
+void scpu_catch_trap(struct cpu *cpu, uint8_t tn, int catch);
+/* Number of instruction dispatches saved by fused instruction pairs */
+uint64_t scpu_get_fused(struct cpu *cpu);
 
 #endif
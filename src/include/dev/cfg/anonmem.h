@@ -0,0 +1,23 @@
+#ifndef _DEV_CFG_ANONMEM_H_
+#define _DEV_CFG_ANONMEM_H_
+
+/* Back memory with huge pages, if host supports it */
+#define ANONMEM_HUGEPAGE (1 << 0)
+/*
+ * Do not reserve swap space, pages are only allocated when first touched.
+ * Only applies to regular pages, huge pages are always reserved so that an
+ * empty huge page pool falls back to regular pages.
+ */
+#define ANONMEM_NORESERVE (1 << 1)
+
+/* Anonymous memory device configuration */
+struct anonmem_cfg {
+	/* Memory size */
+	size_t sz;
+	/* Memory access rights */
+	perm_t perm;
+	/* Allocation flags (ANONMEM_*) */
+	unsigned int flags;
+};
+
+#endif
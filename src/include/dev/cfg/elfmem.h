@@ -0,0 +1,14 @@
+#ifndef _DEV_CFG_ELFMEM_H_
+#define _DEV_CFG_ELFMEM_H_
+
+/* ELF image memory device configuration */
+struct elfmem_cfg {
+	/* ELF file path */
+	char const *path;
+	/* Physical address the device is mapped at */
+	phyaddr_t addr;
+	/* Memory size, extended if image does not fit in */
+	size_t sz;
+};
+
+#endif
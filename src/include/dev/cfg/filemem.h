@@ -1,6 +1,12 @@
 #ifndef _DEV_CFG_FILEMEM_H_
 #define _DEV_CFG_FILEMEM_H_
 
+/*
+ * Share mapping with file so that guest writes are persisted, written pages
+ * are tracked and only those are synced by filemem_flush()
+ */
+#define FILEMEM_SHARED (1 << 0)
+
 /* List of RAM devices configuration */
 struct filemem_cfg {
 	/* File to map path */
@@ -9,6 +15,15 @@ struct filemem_cfg {
 	off_t off;
 	/* Map size */
 	size_t sz;
+	/* Mapping flags (FILEMEM_*) */
+	unsigned int flags;
+	/* Flush once that many pages are dirty, 0 to only flush on demand */
+	size_t flushpg;
 };
 
+int filemem_flush(struct dev *dev);
+int filemem_checkpoint(struct dev *dev);
+int filemem_dirty(struct dev *dev, phyaddr_t from, phyaddr_t *addr,
+		size_t *sz);
+
 #endif
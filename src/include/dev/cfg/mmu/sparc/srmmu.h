@@ -9,6 +9,35 @@ struct sparc_srmmu_cfg {
 	char const *dmem;
 	/* Instruction memory controller device name */
 	char const *imem;
+	/*
+	 * Number of page descriptor cache entries per level, rounded up to a
+	 * power of two, 0 for default
+	 */
+	size_t pdcsz;
+	/*
+	 * Number of page table entries read at once when a table walk reaches
+	 * a page level PTE, rounded up to a power of two up to a whole 64
+	 * entries table and to the number of page descriptor cache sets
+	 * (pdcsz / 4). Valid neighbouring PTEs are cached ahead of their use,
+	 * guest is thus expected to flush modified PTEs even if they have not
+	 * been accessed yet. 0 or 1 to disable.
+	 */
+	size_t prefetch;
 };
 
+/* Reference sparc MMU page descriptor cache statistics */
+struct sparc_srmmu_stats {
+	/* Page level page descriptor cache hits */
+	uint64_t hit;
+	/* Translations that had to walk through page tables in memory */
+	uint64_t walk;
+	/* PTEs cached ahead of use by page table walk prefetch */
+	uint64_t prefetch;
+	/* Prefetched PTEs that have been used afterwards */
+	uint64_t useful;
+};
+
+struct dev;
+int sparc_srmmu_stats(struct dev *dev, struct sparc_srmmu_stats *st);
+
 #endif
@@ -0,0 +1,12 @@
+#ifndef _DEV_CFG_SPARSEMEM_H_
+#define _DEV_CFG_SPARSEMEM_H_
+
+/* Sparse memory device configuration */
+struct sparsemem_cfg {
+	/* Memory size, host memory is only allocated for touched chunks */
+	size_t sz;
+	/* Memory access rights */
+	perm_t perm;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _DEV_CFG_ZIMGMEM_H_
+#define _DEV_CFG_ZIMGMEM_H_
+
+/* Compressed image memory device configuration */
+struct zimgmem_cfg {
+	/* Compressed image file path */
+	char const *path;
+	/* Memory size, -1 for image size */
+	size_t sz;
+	/* Memory access rights */
+	perm_t perm;
+};
+
+int zimgmem_write(char const *path, void const *mem, size_t sz);
+
+#endif
@@ -2,6 +2,7 @@
 #define _DEVICE_H_
 
 #include <errno.h>
+#include <stddef.h>
 
 #include "list.h"
 #include "types.h"
@@ -23,6 +24,26 @@ struct devcfg {
 
 struct dev;
 
+/**
+ * Host memory directly backing a device address range. Data are stored in
+ * guest byte order, as they are read and written by device operations.
+ */
+struct dev_hostmem {
+	/* Host address of range first byte */
+	uint8_t *host;
+	/* Device address of range first byte */
+	phyaddr_t addr;
+	/* Range size in bytes */
+	size_t sz;
+	/* Device operations the host memory can stand in for */
+	perm_t perm;
+	/*
+	 * Operations not allowed yet that a later look up could grant (e.g.
+	 * once MMU PTE referenced or modified bit is set), zeroed by caller
+	 */
+	perm_t pending;
+};
+
 /**
  * Device operations, that handles logical addresses
  */
@@ -35,18 +56,45 @@ struct devops {
 	 * Destroy a device
 	 */
 	void (*destroy)(struct dev *dev);
+	/**
+	 * Save device state into a newly allocated snapshot, snapshot
+	 * operations have to be at the same place in devops and phydevops
+	 */
+	int (*snapshot)(struct dev *dev, void **snap);
+	/**
+	 * Restore device state from a snapshot
+	 */
+	int (*restore)(struct dev *dev, void const *snap);
+	/**
+	 * Free a device snapshot
+	 */
+	void (*snapshot_free)(struct dev *dev, void *snap);
 	/**
 	 * Read device's memory/register
 	 */
 	int (*read8)(struct dev *dev, addr_t addr, uint8_t *val);
 	int (*read16)(struct dev *dev, addr_t addr, uint16_t *val);
 	int (*read32)(struct dev *dev, addr_t addr, uint32_t *val);
+	int (*read64)(struct dev *dev, addr_t addr, uint64_t *val);
 	/**
 	 * Write into device's memory/register
 	 */
 	int (*write8)(struct dev *dev, addr_t addr, uint8_t val);
 	int (*write16)(struct dev *dev, addr_t addr, uint16_t val);
 	int (*write32)(struct dev *dev, addr_t addr, uint32_t val);
+	int (*write64)(struct dev *dev, addr_t addr, uint64_t val);
+	/**
+	 * Copy a block of device's memory
+	 */
+	int (*read_block)(struct dev *dev, addr_t addr, void *buf, size_t len);
+	int (*write_block)(struct dev *dev, addr_t addr, void const *buf,
+			size_t len);
+	/**
+	 * Get host memory backing device's memory, MP_R (resp. MP_W) perm
+	 * means read (resp. write) operations can be replaced by direct
+	 * accesses
+	 */
+	int (*hostmem)(struct dev *dev, addr_t addr, struct dev_hostmem *hm);
 };
 
 /**
@@ -61,24 +109,56 @@ struct phydevops {
 	 * Destroy a device
 	 */
 	void (*destroy)(struct dev *dev);
+	/**
+	 * Save device state into a newly allocated snapshot
+	 */
+	int (*snapshot)(struct dev *dev, void **snap);
+	/**
+	 * Restore device state from a snapshot
+	 */
+	int (*restore)(struct dev *dev, void const *snap);
+	/**
+	 * Free a device snapshot
+	 */
+	void (*snapshot_free)(struct dev *dev, void *snap);
 	/**
 	 * Read device's memory/register
 	 */
 	int (*read8)(struct dev *dev, phyaddr_t addr, uint8_t *val);
 	int (*read16)(struct dev *dev, phyaddr_t addr, uint16_t *val);
 	int (*read32)(struct dev *dev, phyaddr_t addr, uint32_t *val);
+	int (*read64)(struct dev *dev, phyaddr_t addr, uint64_t *val);
 	/**
 	 * Write into device's memory/register
 	 */
 	int (*write8)(struct dev *dev, phyaddr_t addr, uint8_t val);
 	int (*write16)(struct dev *dev, phyaddr_t addr, uint16_t val);
 	int (*write32)(struct dev *dev, phyaddr_t addr, uint32_t val);
+	int (*write64)(struct dev *dev, phyaddr_t addr, uint64_t val);
+	/**
+	 * Copy a block of device's memory
+	 */
+	int (*read_block)(struct dev *dev, phyaddr_t addr, void *buf,
+			size_t len);
+	int (*write_block)(struct dev *dev, phyaddr_t addr, void const *buf,
+			size_t len);
 	/**
 	 * Fetch with exec perm device's memory
 	 */
 	int (*fetch_isn8)(struct dev *dev, phyaddr_t addr, uint8_t *val);
 	int (*fetch_isn16)(struct dev *dev, phyaddr_t addr, uint16_t *val);
 	int (*fetch_isn32)(struct dev *dev, phyaddr_t addr, uint32_t *val);
+	/**
+	 * Get host memory backing device's memory, MP_R, MP_W and MP_X perms
+	 * respectively stand for read, write and fetch operations
+	 */
+	int (*hostmem)(struct dev *dev, phyaddr_t addr,
+			struct dev_hostmem *hm);
+	/**
+	 * Move host memory backing the whole device at a page aligned host
+	 * address, with at most sz bytes available there
+	 */
+	int (*relocate)(struct dev *dev, uint8_t *host, size_t sz);
 };
 
 /**
@@ -120,6 +200,11 @@ struct dev *dev_get(char const *name);
 struct dev *dev_create(struct devcfg const *cfg);
 void dev_destroy(struct dev *d);
 
+struct dev_snapshot;
+struct dev_snapshot *dev_snapshot_take(void);
+int dev_snapshot_restore(struct dev_snapshot const *snap);
+void dev_snapshot_free(struct dev_snapshot *snap);
+
 static inline int dev_read8(struct dev *dev, addr_t addr, uint8_t *val)
 {
 	if(!dev->drv->ops->read8)
@@ -141,6 +226,13 @@ static inline int dev_read32(struct dev *dev, addr_t addr, uint32_t *val)
 	return dev->drv->ops->read32(dev, addr, val);
 }
 
+static inline int dev_read64(struct dev *dev, addr_t addr, uint64_t *val)
+{
+	if(!dev->drv->ops->read64)
+		return -ENOSYS;
+	return dev->drv->ops->read64(dev, addr, val);
+}
+
 static inline int dev_write8(struct dev *dev, addr_t addr, uint8_t val)
 {
 	if(!dev->drv->ops->write8)
@@ -162,6 +254,47 @@ static inline int dev_write32(struct dev *dev, addr_t addr, uint32_t val)
 	return dev->drv->ops->write32(dev, addr, val);
 }
 
+static inline int dev_write64(struct dev *dev, addr_t addr, uint64_t val)
+{
+	if(!dev->drv->ops->write64)
+		return -ENOSYS;
+	return dev->drv->ops->write64(dev, addr, val);
+}
+
+static inline int dev_read_block(struct dev *dev, addr_t addr, void *buf,
+		size_t len)
+{
+	if(!dev->drv->ops->read_block)
+		return -ENOSYS;
+	return dev->drv->ops->read_block(dev, addr, buf, len);
+}
+
+static inline int dev_write_block(struct dev *dev, addr_t addr,
+		void const *buf, size_t len)
+{
+	if(!dev->drv->ops->write_block)
+		return -ENOSYS;
+	return dev->drv->ops->write_block(dev, addr, buf, len);
+}
+
+/**
+ * Get host memory directly backing a device address
+ *
+ * @param dev: Device to get memory from
+ * @param addr: Device address to look up
+ * @param hm: Filled with host memory range containing addr
+ *
+ * @return: 0 on success, -ENOSYS if device memory cannot be directly accessed,
+ * other negative number otherwise
+ */
+static inline int dev_hostmem(struct dev *dev, addr_t addr,
+		struct dev_hostmem *hm)
+{
+	if(!dev->drv->ops->hostmem)
+		return -ENOSYS;
+	return dev->drv->ops->hostmem(dev, addr, hm);
+}
+
 /**
  * Register a memory plugin
  */
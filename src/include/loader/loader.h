@@ -0,0 +1,27 @@
+#ifndef _LOADER_LOADER_H_
+#define _LOADER_LOADER_H_
+
+#include "types.h"
+#include "dev/device.h"
+
+/* Copy a raw binary image file into physical memory */
+int load_raw(struct dev *mem, phyaddr_t addr, char const *path);
+
+/**
+ * ELF image symbol
+ */
+struct elf_sym {
+	/* Symbol address */
+	addr_t addr;
+	/* Symbol size in bytes */
+	uint32_t sz;
+	/* Symbol name */
+	char const *name;
+};
+
+/* Get entry point of an ELF memory device image */
+addr_t elfmem_entry(struct dev *dev);
+/* Find ELF memory device image symbol containing an address */
+struct elf_sym const *elfmem_find_sym(struct dev *dev, addr_t addr);
+
+#endif
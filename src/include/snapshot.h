@@ -0,0 +1,10 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+struct snapshot;
+
+struct snapshot *snapshot_take(void);
+int snapshot_restore(struct snapshot const *snap);
+void snapshot_free(struct snapshot *snap);
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "loader/loader.h"
+
+/* Size of chunks image is copied by */
+#define LOAD_CHUNKSZ (64 * 1024)
+
+/**
+ * Copy a raw binary image file into physical memory
+ *
+ * @param mem: Physical memory device to load image into
+ * @param addr: Physical address of image first byte
+ * @param path: Image file path
+ *
+ * @return: 0 on success, negative number otherwise
+ */
+int load_raw(struct dev *mem, phyaddr_t addr, char const *path)
+{
+	uint8_t *buf;
+	ssize_t sz;
+	int fd, ret = -ENOSYS;
+
+	if(!mem->drv->phyops->write_block)
+		goto out;
+
+	buf = malloc(LOAD_CHUNKSZ);
+	if(buf == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		ret = -errno;
+		PERR("Cannot open %s", path);
+		goto free;
+	}
+
+	while((sz = read(fd, buf, LOAD_CHUNKSZ)) > 0) {
+		ret = mem->drv->phyops->write_block(mem, addr, buf, sz);
+		if(ret != 0)
+			goto close;
+		addr += sz;
+	}
+
+	ret = 0;
+	if(sz < 0) {
+		PERR("Cannot read %s", path);
+		ret = -EIO;
+	}
+
+close:
+	close(fd);
+free:
+	free(buf);
+out:
+	return ret;
+}
@@ -0,0 +1,3 @@
+BUNDLE = b-sporc
+
+b-sporc-CSRC = raw.c
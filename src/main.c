@@ -6,12 +6,15 @@
 #include "cpu/cpu.h"
 #include "dev/device.h"
 #include "dev/cfg/ramctl.h"
-#include "dev/cfg/filemem.h"
+#include "dev/cfg/elfmem.h"
 #include "dev/cfg/mmu/sparc/nommu.h"
+#include "loader/loader.h"
 
-#define PROGFILE "./example/example.bin"
+#define PROGFILE "./example/example.bin.elf"
 #define KB 1024
 #define MEMSZ (250 * KB)
+/* Number of instructions executed between two cpu run calls */
+#define RUNBUDGET (1 << 20)
 
 
 /* Sparc cpu configuration */
@@ -23,8 +26,8 @@ static struct cpucfg const cpucfg = {
 /* Platform devices configuration */
 static struct devcfg devcfg[] = {
 	{
-		.drvname = "file-mem",
-		.name = "progmap",
+		.drvname = "elf-mem",
+		.name = "mem0",
 	},
 	{
 		.drvname = "ramctl",
@@ -32,7 +35,7 @@ static struct devcfg devcfg[] = {
 		.cfg = DEVCFG(ramctl_cfg) {
 			.devlst = (struct rammap[]){
 				{
-					.devname = "progmap",
+					.devname = "mem0",
 					.addr = 0x0,
 					.perm = MP_R | MP_W | MP_X,
 					.sz = -1,
@@ -74,10 +77,11 @@ int get_file_path(int argc, char **argv, char *file,
 
 int main(int argc, char **argv)
 {
-	struct filemem_cfg fc = {
-		.off = 0,
+	struct elfmem_cfg ec = {
+		.addr = 0x0,
 		.sz = MEMSZ,
 	};
+	struct cpu_run run;
 	struct cpu *cpu;
 	struct dev *d;
 	size_t i;
@@ -90,8 +94,8 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Cannot get file path\n");
 		return -1;
 	}
-	fc.path = f;
-	devcfg[0].cfg = &fc;
+	ec.path = f;
+	devcfg[0].cfg = &ec;
 
 	/* Create Cpu */
 	cpu = cpu_create(&cpucfg);
@@ -108,31 +112,29 @@ int main(int argc, char **argv)
 		}
 	}
 
-	ret = cpu_boot(cpu, 0x0);
+	/* Program image has been mapped in RAM, boot on its entry point */
+	d = dev_get("mem0");
+	if(d == NULL) {
+		fprintf(stderr, "Cannot load %s\n", f);
+		goto exit;
+	}
+
+	ret = cpu_boot(cpu, elfmem_entry(d));
 	if(ret < 0) {
 		fprintf(stderr, "Cannot boot cpu\n");
 		goto exit;
 	}
 
-	while(1) {
-		ret = cpu_fetch(cpu);
-		if(ret < 0) {
-			fprintf(stderr, "Cannot fetch instruction\n");
-			goto exit;
-		}
-
-		ret = cpu_decode(cpu);
-		if(ret < 0) {
-			fprintf(stderr, "Cannot decode instruction\n");
-			goto exit;
-		}
-
-		ret = cpu_exec(cpu);
+	do {
+		ret = cpu_run(cpu, RUNBUDGET, &run);
 		if(ret < 0) {
 			fprintf(stderr, "Cannot execute instruction\n");
 			goto exit;
 		}
-	}
+	} while(run.stop == CS_BUDGET || run.stop == CS_DEVREQ);
+
+	if(run.stop == CS_ERROR)
+		fprintf(stderr, "Cpu entered error mode\n");
 
 exit:
 	for(i = ARRAY_SIZE(devcfg); i > 0; --i)
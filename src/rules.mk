@@ -6,3 +6,4 @@ sporc-DEPS = b-sporc
 BUNDLE = b-sporc
 b-sporc-LDSCRIPT = script.ld
 b-sporc-INCLUDE = include
+b-sporc-CSRC = snapshot.c
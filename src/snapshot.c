@@ -0,0 +1,78 @@
+#include <stdlib.h>
+
+#include "types.h"
+#include "cpu/cpu.h"
+#include "dev/device.h"
+#include "snapshot.h"
+
+/**
+ * Whole machine saved state
+ */
+struct snapshot {
+	struct dev_snapshot *dev;
+	struct cpu_snapshot *cpu;
+};
+
+/**
+ * Save state of the whole machine (cpus, devices and memories). Memory
+ * devices keep their snapshot copy-on-write where they can, so that a
+ * restore only costs the pages dirtied since.
+ *
+ * @return: New snapshot, NULL pointer on error
+ */
+struct snapshot *snapshot_take(void)
+{
+	struct snapshot *snap;
+
+	snap = malloc(sizeof(*snap));
+	if(snap == NULL)
+		goto err;
+
+	snap->dev = dev_snapshot_take();
+	if(snap->dev == NULL)
+		goto free;
+
+	snap->cpu = cpu_snapshot_take();
+	if(snap->cpu == NULL)
+		goto devfree;
+
+	return snap;
+
+devfree:
+	dev_snapshot_free(snap->dev);
+free:
+	free(snap);
+err:
+	return NULL;
+}
+
+/**
+ * Restore whole machine state. Devices are restored first, cpus then drop
+ * everything they have cached from devices. Cpus are restored even if a
+ * device could not be, devices restored before it may already have released
+ * memory cpus still point to.
+ *
+ * @param snap: Snapshot to restore
+ * @return: 0 on success, negative number otherwise
+ */
+int snapshot_restore(struct snapshot const *snap)
+{
+	int ret, cret;
+
+	ret = dev_snapshot_restore(snap->dev);
+	cret = cpu_snapshot_restore(snap->cpu);
+
+	return (ret != 0) ? ret : cret;
+}
+
+/**
+ * Free a whole machine snapshot
+ *
+ * @param snap: Snapshot to free
+ */
+void snapshot_free(struct snapshot *snap)
+{
+	cpu_snapshot_free(snap->cpu);
+	dev_snapshot_free(snap->dev);
+	free(snap);
+}
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "utils.h"
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/anonmem.h"
+
+#define MB (1024 * 1024)
+#define MEMSZ (1024 * MB)
+/* Page modified after restore */
+#define MODADDR 0x1000
+/* Page zeroed after restore */
+#define ZEROADDR 0x2000
+/* Page not touched after restore */
+#define KEEPADDR (512 * MB)
+/* Page only written after restore */
+#define NEWADDR (768 * MB)
+/* Page never touched */
+#define UNTOUCHEDADDR (256 * MB)
+
+static struct devcfg const devcfg = {
+	.drvname = "anon-mem",
+	.name = "amem0",
+	.cfg = DEVCFG(anonmem_cfg) {
+		.sz = MEMSZ,
+		.perm = MP_R | MP_W,
+		.flags = ANONMEM_NORESERVE,
+	},
+};
+
+/**
+ * Check memory word value
+ */
+static int test_mem(struct dev *d, phyaddr_t addr, uint32_t val)
+{
+	uint32_t v;
+	int ret;
+
+	ret = d->drv->phyops->read32(d, addr, &v);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot read 0x%x\n", (unsigned int)addr);
+		return ret;
+	}
+
+	if(v != val) {
+		fprintf(stderr, "Wrong memory value at 0x%x 0x%x\n",
+				(unsigned int)addr, v);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Write memory words
+ */
+static int test_write(struct dev *d, phyaddr_t const *addr,
+		uint32_t const *val, size_t nr)
+{
+	size_t i;
+	int ret = 0;
+
+	for(i = 0; i < nr; ++i) {
+		ret = d->drv->phyops->write32(d, addr[i], val[i]);
+		if(ret != 0)
+			break;
+	}
+
+	return ret;
+}
+
+/**
+ * Check that a memory page has never been brought in host memory
+ */
+static int test_untouched(struct dev *d, phyaddr_t addr)
+{
+	struct dev_hostmem hm;
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	unsigned char vec;
+	int ret;
+
+	ret = d->drv->phyops->hostmem(d, addr, &hm);
+	if(ret != 0)
+		return ret;
+
+	ret = mincore(hm.host + (addr - hm.addr), pgsz, &vec);
+	if(ret != 0)
+		return ret;
+
+	if(vec & 1) {
+		fprintf(stderr, "Untouched page 0x%x read by snapshot\n",
+				(unsigned int)addr);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	/* Kept page is last, it is left alone between restore and snapshot */
+	phyaddr_t const addr[] = {MODADDR, ZEROADDR, NEWADDR, KEEPADDR};
+	uint32_t const first[] = {0x11, 0x22, 0, 0x33};
+	uint32_t const second[] = {0x44, 0, 0x55, 0x33};
+	uint32_t const junk[] = {0x66, 0x66, 0x66, 0x66};
+	struct dev_snapshot *snap, *snap2;
+	struct dev *d;
+	size_t i;
+	int ret = -1;
+
+	d = dev_create(&devcfg);
+	if(d == NULL)
+		goto exit;
+
+	ret = test_write(d, addr, first, ARRAY_SIZE(addr));
+	if(ret != 0)
+		goto close;
+
+	snap = dev_snapshot_take();
+	if(snap == NULL) {
+		fprintf(stderr, "Cannot take snapshot\n");
+		ret = -1;
+		goto close;
+	}
+
+	/* Snapshot only reads pages that have been touched */
+	ret = test_untouched(d, UNTOUCHEDADDR);
+	if(ret != 0)
+		goto free;
+
+	ret = test_write(d, addr, junk, ARRAY_SIZE(addr));
+	if(ret != 0)
+		goto free;
+	ret = dev_snapshot_restore(snap);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore snapshot\n");
+		goto free;
+	}
+	for(i = 0; i < ARRAY_SIZE(addr) - 1; ++i) {
+		ret = test_mem(d, addr[i], first[i]);
+		if(ret != 0)
+			goto free;
+	}
+
+	/*
+	 * Kept page is only held by the restored snapshot, it has to be in
+	 * the next one too
+	 */
+	ret = test_write(d, addr, second, ARRAY_SIZE(addr) - 1);
+	if(ret != 0)
+		goto free;
+
+	snap2 = dev_snapshot_take();
+	if(snap2 == NULL) {
+		fprintf(stderr, "Cannot take snapshot\n");
+		ret = -1;
+		goto free;
+	}
+
+	ret = test_write(d, addr, junk, ARRAY_SIZE(addr));
+	if(ret != 0)
+		goto free2;
+	ret = dev_snapshot_restore(snap2);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore snapshot\n");
+		goto free2;
+	}
+	for(i = 0; i < ARRAY_SIZE(addr); ++i) {
+		ret = test_mem(d, addr[i], second[i]);
+		if(ret != 0)
+			goto free2;
+	}
+
+	printf("[OK]\n");
+	ret = 0;
+
+free2:
+	dev_snapshot_free(snap2);
+free:
+	dev_snapshot_free(snap);
+close:
+	dev_destroy(d);
+exit:
+	return ret;
+}
@@ -0,0 +1,7 @@
+ifeq ($(TESTS),1)
+	TARGET = t-anonsnap
+endif
+
+t-anonsnap-OUTDIR = tests/anonsnap
+t-anonsnap-CSRC = main.c
+t-anonsnap-DEPS = b-test-utils
@@ -0,0 +1,29 @@
+.section .text, "ax", @progbits
+
+tmain:
+	/* Number of loop iterations */
+	sethi %hi(1000000), %g2
+	or %g2, %lo(1000000), %g2
+	or %g0, %g0, %g1
+	or %g0, 1, %g3
+
+	/* ALU heavy loop */
+1:
+	add %g3, %g1, %g3
+	xor %g3, 0x5a, %g4
+	sll %g4, 3, %g5
+	srl %g5, 1, %g5
+	sub %g5, %g4, %g6
+	and %g6, 0xff, %g6
+	or %g6, %g3, %g7
+	andcc %g7, 0x1, %g0
+	be 2f
+	add %g3, %g7, %g3
+2:
+	addcc %g1, 1, %g1
+	subcc %g1, %g2, %g0
+	bne 1b
+	nop
+
+	/* Traps are disabled, thus this halts cpu in error mode */
+	ta 0
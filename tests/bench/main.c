@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "cpu/sparc/sparc.h"
+
+#define PROGFILE "../binaries/bench/bench.bin"
+#define KB 1024
+#define MEMSZ (250 * KB)
+#define RUNBUDGET (1 << 20)
+#define ITER 1000000
+
+int main(int argc, char **argv)
+{
+	struct timespec start, end;
+	struct cpu_run run;
+	struct cpu *c;
+	size_t nrisn = 0;
+	double t;
+	int ret = -1;
+	uint32_t reg;
+
+	c = test_cpu_open(argc, argv, PROGFILE, MEMSZ);
+	if(c == NULL)
+		goto exit;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		ret = cpu_run(c, RUNBUDGET, &run);
+		if(ret != 0) {
+			fprintf(stderr, "Cannot run cpu\n");
+			goto close;
+		}
+		nrisn += run.nrisn;
+	} while(run.stop == CS_BUDGET);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Benchmark ends with cpu halted in error mode */
+	if(run.stop != CS_ERROR) {
+		fprintf(stderr, "Wrong stop reason %d\n", run.stop);
+		ret = -1;
+		goto close;
+	}
+
+	reg = test_cpu_get_reg(c, 1);
+	if(reg != ITER) {
+		fprintf(stderr, "Wrong register value after exec 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	t = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%zu instructions in %.3fs: %.2f MIPS (%llu fused dispatches)\n",
+			nrisn, t, nrisn / t / 1e6,
+			(unsigned long long)scpu_get_fused(c));
+	ret = 0;
+
+close:
+	test_cpu_close(c);
+exit:
+	return ret;
+}
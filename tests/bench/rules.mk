@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = bench-iu
+	CROSSTARGET = bench.bin
+endif
+
+bench-iu-OUTDIR = tests/bench
+bench-iu-CSRC = main.c
+bench-iu-DEPS = b-test-utils
+
+bench.bin-OUTDIR = tests/binaries/bench
+bench.bin-ASRC = bench.s
+bench.bin-DEPS = b-test-tsparc-utils
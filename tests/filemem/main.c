@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/filemem.h"
+
+#define KB 1024
+#define MEMSZ (64 * KB)
+/* Dirty pages threshold that triggers a flush */
+#define FLUSHPG 2
+
+/**
+ * Check the first dirty range of a shared file memory
+ */
+static int test_dirty(struct dev *d, phyaddr_t from, phyaddr_t addr,
+		int dirty)
+{
+	phyaddr_t a;
+	size_t sz;
+	int ret;
+
+	ret = filemem_dirty(d, from, &a, &sz);
+	if(!dirty && (ret == -ENOENT))
+		return 0;
+
+	if(ret != 0) {
+		fprintf(stderr, "Wrong dirty state from 0x%x %d\n",
+				(unsigned int)from, ret);
+		return -1;
+	}
+
+	if(!dirty || (a != addr)) {
+		fprintf(stderr, "Wrong dirty range at 0x%x\n", (unsigned int)a);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	char path[] = "/tmp/sporc-filemem-XXXXXX";
+	struct filemem_cfg fc = {
+		.path = path,
+		.off = 0,
+		.sz = MEMSZ,
+		.flags = FILEMEM_SHARED,
+		.flushpg = FLUSHPG,
+	};
+	struct devcfg dc = {
+		.drvname = "file-mem",
+		.name = "fmem0",
+		.cfg = &fc,
+	};
+	struct dev *d;
+	size_t pgsz = sysconf(_SC_PAGESIZE);
+	uint32_t val;
+	int fd, ret = -1;
+
+	fd = mkstemp(path);
+	if(fd < 0) {
+		perror("Cannot create memory file");
+		goto exit;
+	}
+	close(fd);
+
+	d = dev_create(&dc);
+	if(d == NULL)
+		goto unlink;
+
+	/* Shared memory file is extended to memory size */
+	ret = test_dirty(d, 0, 0, 0);
+	if(ret != 0)
+		goto close;
+
+	ret = d->drv->phyops->write32(d, pgsz, 0xdeadbeef);
+	if(ret != 0)
+		goto close;
+	ret = test_dirty(d, 0, pgsz, 1);
+	if(ret != 0)
+		goto close;
+
+	/* Explicit and threshold flushes keep checkpoint dirty pages */
+	ret = filemem_flush(d);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot flush file memory\n");
+		goto close;
+	}
+	ret = d->drv->phyops->write32(d, 3 * pgsz, 0x1);
+	if(ret != 0)
+		goto close;
+	ret = d->drv->phyops->write32(d, 5 * pgsz, 0x2);
+	if(ret != 0)
+		goto close;
+	ret = test_dirty(d, 0, pgsz, 1);
+	if(ret != 0)
+		goto close;
+	ret = test_dirty(d, 4 * pgsz, 5 * pgsz, 1);
+	if(ret != 0)
+		goto close;
+
+	/* Checkpoint only tracks pages written from then on */
+	ret = filemem_checkpoint(d);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot checkpoint file memory\n");
+		goto close;
+	}
+	ret = test_dirty(d, 0, 0, 0);
+	if(ret != 0)
+		goto close;
+	ret = d->drv->phyops->write32(d, 2 * pgsz, 0x3);
+	if(ret != 0)
+		goto close;
+	ret = test_dirty(d, 0, 2 * pgsz, 1);
+	if(ret != 0)
+		goto close;
+
+	dev_destroy(d);
+
+	/* Memory content has been persisted */
+	fc.flushpg = 0;
+	d = dev_create(&dc);
+	if(d == NULL) {
+		ret = -1;
+		goto unlink;
+	}
+	d->drv->phyops->read32(d, pgsz, &val);
+	if(val != 0xdeadbeef) {
+		fprintf(stderr, "Wrong persisted value 0x%x\n", val);
+		ret = -1;
+		goto close;
+	}
+
+	printf("[OK]\n");
+	ret = 0;
+
+close:
+	dev_destroy(d);
+unlink:
+	unlink(path);
+exit:
+	return ret;
+}
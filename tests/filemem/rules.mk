@@ -0,0 +1,7 @@
+ifeq ($(TESTS),1)
+	TARGET = t-filemem
+endif
+
+t-filemem-OUTDIR = tests/filemem
+t-filemem-CSRC = main.c
+t-filemem-DEPS = b-test-utils
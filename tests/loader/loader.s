@@ -0,0 +1,9 @@
+.section .text, "ax", @progbits
+
+tmain:
+	ld [%g0 + 0x10], %g1
+	st %g1, [%g0 + 0x800]
+	ld [%g0 + 0x800], %g2
+	ld [%g0 + 0x804], %g3
+
+	.word 0xdeadbeef
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "dev/device.h"
+#include "loader/loader.h"
+
+#define PROGFILE "../binaries/loader/loader.bin"
+#define KB 1024
+#define MEMSZ (64 * KB)
+#define NRINST 4
+/* Image size in words */
+#define IMGSZ 5
+/* Address a second copy of the image is loaded at */
+#define RELOAD 0x8000
+
+int main(int argc, char **argv)
+{
+	struct cpu *c;
+	struct dev *d;
+	size_t i;
+	int ret = -1;
+	uint32_t reg, val;
+	char f[FILENAME_MAX];
+
+	c = test_rawcpu_open(argc, argv, PROGFILE, MEMSZ);
+	if(c == NULL)
+		goto exit;
+
+	/* LD from image, ST and LD back, LD untouched anonymous memory */
+	for(i = 0; i < NRINST; ++i) {
+		ret = test_cpu_step(c);
+		if(ret != 0)
+			goto close;
+	}
+
+	reg = test_cpu_get_reg(c, 2);
+	if(reg != 0xdeadbeef) {
+		fprintf(stderr, "Wrong register value after exec 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	reg = test_cpu_get_reg(c, 3);
+	if(reg != 0) {
+		fprintf(stderr, "Wrong anonymous memory value 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	d = dev_get("rawmem");
+
+	/* Load image a second time at another address */
+	test_path(argc, argv, PROGFILE, f, FILENAME_MAX);
+	ret = load_raw(d, RELOAD, f);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot reload image\n");
+		goto close;
+	}
+
+	for(i = 0; i < IMGSZ; ++i) {
+		reg = test_cpu_get_mem32(c, RELOAD + i * 4);
+		val = test_cpu_get_mem32(c, i * 4);
+		if(reg != val) {
+			fprintf(stderr, "Wrong reloaded image word 0x%x\n",
+					reg);
+			ret = -1;
+			goto close;
+		}
+	}
+
+	printf("[OK]\n");
+	ret = 0;
+
+close:
+	test_rawcpu_close(c);
+exit:
+	return ret;
+}
@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = t-loader
+	CROSSTARGET = loader.bin
+endif
+
+t-loader-OUTDIR = tests/loader
+t-loader-CSRC = main.c
+t-loader-DEPS = b-test-utils
+
+loader.bin-OUTDIR = tests/binaries/loader
+loader.bin-ASRC = loader.s
+loader.bin-DEPS = b-test-tsparc-utils
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <endian.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "dev/device.h"
+
+#define PROGFILE "../binaries/pdcflush/pdcflush.bin"
+#define KB 1024
+#define MEMSZ (20 * KB)
+/* Small page descriptor cache, 4 sets of 4 ways */
+#define PDCSZ 16
+/* Instructions executed up to the first beacon translation */
+#define NRBOOT 10
+/* Instructions executed for page flush and context switch */
+#define NRPAGE 7
+/* Instructions executed for context and supervisor page flushes */
+#define NRCTX 8
+
+#define PTE_CTX0 0x4d0c
+#define PTE_CTX0_SUPER 0x4d10
+#define PTE_CTX1 0x4f0c
+/* Beacon PTEs remapping */
+#define PTE_3000 0x30e
+#define PTE_2000_SUPER 0x21e
+
+#define BEACON1 0x11111111
+#define BEACON2 0x22222222
+#define BEACON3 0x33333333
+
+/**
+ * Remap a page behind guest back, without any flush
+ */
+static int test_remap(struct dev *ram, phyaddr_t pta, uint32_t pte)
+{
+	int ret;
+
+	ret = ram->drv->phyops->write32(ram, pta, htobe32(pte));
+	if(ret < 0)
+		fprintf(stderr, "Cannot write PTE at 0x%x\n",
+				(unsigned int)pta);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct cpu *c;
+	struct dev *ram;
+	int ret = -1;
+
+	c = test_srmmucpu_open(argc, argv, PROGFILE, MEMSZ, PDCSZ, 0);
+	if(c == NULL)
+		goto exit;
+	ram = dev_get("ram0");
+
+	/* Enable MMU and cache context 0 user beacon translation */
+	ret = test_cpu_steps(c, NRBOOT);
+	if(ret != 0)
+		goto close;
+	ret = test_cpu_check_reg(c, 16, BEACON1);
+	if(ret != 0)
+		goto close;
+
+	ret = test_remap(ram, PTE_CTX0, PTE_3000);
+	if(ret != 0)
+		goto close;
+
+	/* Stale translation up to page flush, then context 1 beacon */
+	ret = test_cpu_steps(c, NRPAGE);
+	if(ret != 0)
+		goto close;
+	ret = test_cpu_check_reg(c, 17, BEACON1);
+	ret |= test_cpu_check_reg(c, 18, BEACON3);
+	ret |= test_cpu_check_reg(c, 19, BEACON1);
+	ret |= test_cpu_check_reg(c, 20, BEACON2);
+	if(ret != 0)
+		goto close;
+
+	ret = test_remap(ram, PTE_CTX1, PTE_3000);
+	if(ret != 0)
+		goto close;
+	ret = test_remap(ram, PTE_CTX0_SUPER, PTE_2000_SUPER);
+	if(ret != 0)
+		goto close;
+
+	/*
+	 * Context 1 flush drops context 1 translation, supervisor only page
+	 * needs its own page flush
+	 */
+	ret = test_cpu_steps(c, NRCTX);
+	if(ret != 0)
+		goto close;
+	ret = test_cpu_check_reg(c, 21, BEACON2);
+	ret |= test_cpu_check_reg(c, 22, BEACON3);
+	ret |= test_cpu_check_reg(c, 23, BEACON1);
+	ret |= test_cpu_check_reg(c, 8, BEACON2);
+	if(ret != 0)
+		goto close;
+
+	printf("[OK]\n");
+	ret = 0;
+
+close:
+	test_mmucpu_close(c);
+exit:
+	return ret;
+}
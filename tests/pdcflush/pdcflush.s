@@ -0,0 +1,116 @@
+.section .text, "ax", @progbits
+
+/*
+CTXTBL:       0x4000
+CTX0 LVL1:    0x4400
+CTX1 LVL1:    0x4800
+LVL2 (code):  0x4c00
+LVL3 (code):  0x4d00
+CTX1 LVL2:    0x4e00
+CTX1 LVL3:    0x4f00
+
+VA: CTX:0/1, 0x00000000 -> PA: 0x0000 (code)
+VA: CTX:0, 0x01083000 -> PA: 0x1000 (user beacon, remapped to 0x3000)
+VA: CTX:0, 0x01084000 -> PA: 0x1000 (supervisor beacon, remapped to 0x2000)
+VA: CTX:1, 0x01083000 -> PA: 0x2000 (user beacon, remapped to 0x3000)
+
+User beacons are read through user data ASI so that their translations are
+cached with current context, supervisor accesses are cached context free.
+
+PTEs referenced bit is left cleared, first access then goes through page
+descriptor cache instead of a direct host memory mapping.
+*/
+
+tmain:
+	/* Set Context Table address */
+	or %g0, 0x100, %g1
+	or %g0, 0x400, %g2 /* 0x400: (0x4000 >> 6) << 2 */
+	sta %g2, [%g1] 0x4
+
+	/* Context register and beacons addresses */
+	or %g0, 0x200, %g7
+	sethi %hi(0x01083000), %g6
+	sethi %hi(0x01084000), %g5
+
+	lda [%g0] 0x4, %g1
+	or %g1, 0x1, %g1
+	sta %g1, [%g0] 0x4 /* Enable MMU */
+
+	/* Cache context 0 beacon translation */
+	lda [%g6] 0xa, %l0
+
+	/* Beacon is remapped here, stale translation is still used */
+	lda [%g6] 0xa, %l1
+	sta %g0, [%g6] 0x3 /* Flush beacon page */
+	lda [%g6] 0xa, %l2
+
+	/* Cache supervisor only beacon translation */
+	ld [%g5], %l3
+
+	/* Switch to context 1 */
+	or %g0, 0x1, %g1
+	sta %g1, [%g7] 0x4
+	lda [%g6] 0xa, %l4
+
+	/* Context 1 and supervisor beacons are remapped here */
+	lda [%g6] 0xa, %l5
+	or %g0, 0x300, %g2
+	sta %g0, [%g2] 0x3 /* Flush context 1 */
+	lda [%g6] 0xa, %l6
+
+	/* Back to context 0, supervisor translation survived context flush */
+	sta %g0, [%g7] 0x4
+	ld [%g5], %l7
+	sta %g0, [%g5] 0x3 /* Flush supervisor beacon page */
+	ld [%g5], %o0
+
+	.org 0x1000
+	.word 0x11111111
+	.org 0x2000
+	.word 0x22222222
+	.org 0x3000
+	.word 0x33333333
+
+	/* Context table */
+	.org 0x4000
+	.word 0x441 /* (0x4400 >> 6) << 2 | ET == PTD */
+	.word 0x481 /* (0x4800 >> 6) << 2 | ET == PTD */
+
+	/* Context 0 LVL1 */
+	.org 0x4400
+	.word 0x4c1 /* (0x4c00 >> 6) << 2 | ET == PTD */
+	.word 0x4c1
+
+	/* Context 1 LVL1 */
+	.org 0x4800
+	.word 0x4c1
+	.word 0x4e1 /* (0x4e00 >> 6) << 2 | ET == PTD */
+
+	/* Shared LVL2 */
+	.org 0x4c00
+	.word 0x4d1 /* (0x4d00 >> 6) << 2 | ET == PTD */
+	.word 0x0
+	.word 0x4d1
+
+	/* Shared LVL3 */
+	.org 0x4d00
+	.word 0x0e /* 0x0e: (0x0 >> 12) << 8 | ACC == RWX | ET == PTE */
+	.word 0x0
+	.word 0x0
+	.word 0x10e /* 0x10e: (0x1000 >> 12) << 8 | ACC == RWX | PTE */
+	.word 0x11e /* 0x11e: (0x1000 >> 12) << 8 | ACC == S:RWX | PTE */
+
+	/* Context 1 LVL2 */
+	.org 0x4e00
+	.word 0x0
+	.word 0x0
+	.word 0x4f1 /* (0x4f00 >> 6) << 2 | ET == PTD */
+
+	/* Context 1 LVL3 */
+	.org 0x4f00
+	.word 0x0
+	.word 0x0
+	.word 0x0
+	.word 0x20e /* 0x20e: (0x2000 >> 12) << 8 | ACC == RWX | PTE */
+
+	.org 0x5000
@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = t-pdcflush
+	CROSSTARGET = pdcflush.bin
+endif
+
+t-pdcflush-OUTDIR = tests/pdcflush
+t-pdcflush-CSRC = main.c
+t-pdcflush-DEPS = b-test-utils
+
+pdcflush.bin-OUTDIR = tests/binaries/pdcflush
+pdcflush.bin-ASRC = pdcflush.s
+pdcflush.bin-DEPS = b-test-tsparc-utils
@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "dev/device.h"
+#include "dev/cfg/mmu/sparc/srmmu.h"
+
+#define PROGFILE "../binaries/prefetch/prefetch.bin"
+#define KB 1024
+#define MEMSZ (20 * KB)
+/* Small page descriptor cache, 4 sets of 4 ways */
+#define PDCSZ 16
+#define PDCSETS (PDCSZ / 4)
+/* Whole page table prefetch, clamped to the number of sets */
+#define PREFETCH 64
+/* Instructions executed up to MMU enabling */
+#define NRBOOT 7
+/* Number of beacon pages, each one read by two instructions */
+#define NRPAGE 32
+
+int main(int argc, char **argv)
+{
+	struct sparc_srmmu_stats st, st2;
+	struct cpu *c;
+	struct dev *d;
+	uint64_t pf, useful;
+	int ret = -1;
+
+	c = test_srmmucpu_open(argc, argv, PROGFILE, MEMSZ, PDCSZ, PREFETCH);
+	if(c == NULL)
+		goto exit;
+	d = dev_get("mmu0");
+
+	ret = test_cpu_steps(c, NRBOOT);
+	if(ret != 0)
+		goto close;
+	ret = sparc_srmmu_stats(d, &st);
+	if(ret != 0)
+		goto close;
+
+	/* Read all beacon pages in order */
+	ret = test_cpu_steps(c, NRPAGE * 2);
+	if(ret != 0)
+		goto close;
+	ret = sparc_srmmu_stats(d, &st2);
+	if(ret != 0)
+		goto close;
+
+	ret = test_cpu_check_reg(c, 16, 0x11111111);
+	if(ret != 0)
+		goto close;
+
+	ret = -1;
+
+	/* One walk per prefetch window, other window PTEs are prefetched */
+	pf = st2.prefetch - st.prefetch;
+	if(pf != NRPAGE - NRPAGE / PDCSETS) {
+		fprintf(stderr, "Wrong number of prefetched PTEs %lu\n",
+				(unsigned long)pf);
+		goto close;
+	}
+
+	/* Window fits in cache, no PTE is evicted before its use */
+	useful = st2.useful - st.useful;
+	if(useful != pf) {
+		fprintf(stderr, "Wrong number of useful prefetches %lu\n",
+				(unsigned long)useful);
+		goto close;
+	}
+
+	if(st2.hit - st.hit < useful) {
+		fprintf(stderr, "Prefetched PTEs not counted as hits\n");
+		goto close;
+	}
+
+	printf("[OK]\n");
+	ret = 0;
+
+close:
+	test_mmucpu_close(c);
+exit:
+	return ret;
+}
@@ -0,0 +1,60 @@
+.section .text, "ax", @progbits
+
+/*
+CTXTBL:       0x4000
+LVL1:         0x4400
+LVL2:         0x4800
+LVL3 (code):  0x4900
+LVL3 (data):  0x4a00
+
+VA: CTX:0, 0x00000000 -> PA: 0x0000 (code)
+VA: CTX:0, 0x01040000 - 0x0105ffff -> PA: 0x1000 (32 beacon pages)
+*/
+
+tmain:
+	/* Set Context Table address */
+	or %g0, 0x100, %g1
+	or %g0, 0x400, %g2 /* 0x400: (0x4000 >> 6) << 2 */
+	sta %g2, [%g1] 0x4
+
+	sethi %hi(0x01040000), %g6
+	sethi %hi(0x1000), %g5
+
+	lda [%g0] 0x4, %g1
+	or %g1, 0x1, %g1
+	sta %g1, [%g0] 0x4 /* Enable MMU */
+
+	/* Read all beacon pages in order */
+	.rept 32
+	ld [%g6], %l0
+	add %g6, %g5, %g6
+	.endr
+
+	.org 0x1000
+	.word 0x11111111
+
+	/* Context table */
+	.org 0x4000
+	.word 0x441 /* (0x4400 >> 6) << 2 | ET == PTD */
+
+	/* LVL1 */
+	.org 0x4400
+	.word 0x481 /* (0x4800 >> 6) << 2 | ET == PTD */
+	.word 0x481
+
+	/* LVL2 */
+	.org 0x4800
+	.word 0x491 /* (0x4900 >> 6) << 2 | ET == PTD */
+	.word 0x4a1 /* (0x4a00 >> 6) << 2 | ET == PTD */
+
+	/* Code LVL3 */
+	.org 0x4900
+	.word 0x0e /* 0x0e: (0x0 >> 12) << 8 | ACC == RWX | ET == PTE */
+
+	/* Beacon pages LVL3 */
+	.org 0x4a00
+	.rept 32
+	.word 0x10e /* 0x10e: (0x1000 >> 12) << 8 | ACC == RWX | ET == PTE */
+	.endr
+
+	.org 0x5000
@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = t-prefetch
+	CROSSTARGET = prefetch.bin
+endif
+
+t-prefetch-OUTDIR = tests/prefetch
+t-prefetch-CSRC = main.c
+t-prefetch-DEPS = b-test-utils
+
+prefetch.bin-OUTDIR = tests/binaries/prefetch
+prefetch.bin-ASRC = prefetch.s
+prefetch.bin-DEPS = b-test-tsparc-utils
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "cpu/sparc/sparc.h"
+
+#define PROGFILE "../binaries/run/run.bin"
+#define KB 1024
+#define MEMSZ (250 * KB)
+#define TRAPVEC 0x840
+
+/**
+ * Run cpu and check why and after how many instructions it stopped
+ */
+static int test_run(struct cpu *c, size_t budget, enum cpu_stop stop,
+		size_t nrisn)
+{
+	struct cpu_run run;
+	int ret;
+
+	ret = cpu_run(c, budget, &run);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot run cpu\n");
+		return ret;
+	}
+
+	if(run.stop != stop) {
+		fprintf(stderr, "Wrong stop reason %d\n", run.stop);
+		return -1;
+	}
+
+	if(run.nrisn != nrisn) {
+		fprintf(stderr, "Wrong executed instruction number %zu\n",
+				run.nrisn);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct cpu *c;
+	int ret = -1;
+	uint32_t reg, brk;
+
+	c = test_cpu_open(argc, argv, PROGFILE, MEMSZ);
+	if(c == NULL)
+		goto exit;
+
+	scpu_catch_trap(c, 132, 1);
+
+	/* CALL, NOP, RDPSR, WRPSR */
+	ret = test_run(c, 4, CS_BUDGET, 4);
+	if(ret != 0)
+		goto close;
+
+	/* NOP, NOP then stop on breakpoint */
+	brk = test_cpu_get_pc(c) + 8;
+	ret = scpu_set_break(c, brk);
+	if(ret != 0)
+		goto close;
+
+	ret = test_run(c, 100, CS_BREAK, 2);
+	if(ret != 0)
+		goto close;
+
+	reg = test_cpu_get_pc(c);
+	if(reg != brk) {
+		fprintf(stderr, "Wrong PC value after break 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	/* Resume from breakpoint, NOP, OR, 4 * ADD, TA */
+	ret = test_run(c, 100, CS_TRAP, 7);
+	if(ret != 0)
+		goto close;
+
+	reg = test_cpu_get_pc(c);
+	if(reg != TRAPVEC) {
+		fprintf(stderr, "Wrong PC value after trap 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	reg = test_cpu_get_reg(c, 1);
+	if(reg != 4) {
+		fprintf(stderr, "Wrong register value after exec 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	/* Device stop request */
+	cpu_stop_request(c);
+	ret = test_run(c, 100, CS_DEVREQ, 0);
+	if(ret != 0)
+		goto close;
+
+	/* CALL, NOP, OR, TA then stop in error mode */
+	ret = test_run(c, 100, CS_ERROR, 4);
+	if(ret != 0)
+		goto close;
+
+	reg = test_cpu_get_reg(c, 2);
+	if(reg != 0x42) {
+		fprintf(stderr, "Wrong register value after exec 0x%x\n", reg);
+		ret = -1;
+		goto close;
+	}
+
+	printf("[OK]\n");
+	ret = 0;
+
+close:
+	test_cpu_close(c);
+exit:
+	return ret;
+}
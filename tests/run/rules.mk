@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = t-run
+	CROSSTARGET = run.bin
+endif
+
+t-run-OUTDIR = tests/run
+t-run-CSRC = main.c
+t-run-DEPS = b-test-utils
+
+run.bin-OUTDIR = tests/binaries/run
+run.bin-ASRC = run.s
+run.bin-DEPS = b-test-tsparc-utils
@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <endian.h>
+
+#include <test-utils.h>
+#include "cpu/cpu.h"
+#include "dev/device.h"
+#include "dev/cfg/mmu/sparc/srmmu.h"
+#include "snapshot.h"
+
+#define PROGFILE "../binaries/snapshot/snapshot.bin"
+#define KB 1024
+#define MEMSZ (20 * KB)
+/* Instructions executed up to the MMU snapshot point */
+#define NRBOOT 27
+/* Instructions executed after the MMU snapshot point */
+#define NRRUN 4
+/* Interrupt level 1 trap, ignored while traps are disabled */
+#define INTTRAP 0x12
+#define BEACON_VA 0x01083000
+#define BEACON_PA 0x3000
+
+/**
+ * Check a memory word value
+ */
+static int test_mem(struct cpu *c, addr_t addr, uint32_t val)
+{
+	uint32_t mem;
+
+	mem = test_cpu_get_mem32(c, addr);
+	if(mem != htobe32(val)) {
+		fprintf(stderr, "Wrong memory value at 0x%x 0x%x\n", addr,
+				mem);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Check a physical memory word value, without going through MMU
+ */
+static int test_phymem(struct dev *ram, phyaddr_t addr, uint32_t val)
+{
+	uint32_t mem = 0;
+
+	ram->drv->phyops->read32(ram, addr, &mem);
+	if(mem != htobe32(val)) {
+		fprintf(stderr, "Wrong physical memory value at 0x%x 0x%x\n",
+				(unsigned int)addr, mem);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Check whether a trap is pending
+ */
+static int test_trap(struct cpu *c, int pending)
+{
+	uint8_t tn;
+
+	if(test_cpu_trap_pending(c, &tn) != pending) {
+		fprintf(stderr, "Wrong pending trap state\n");
+		return -1;
+	}
+
+	if(pending && (tn != INTTRAP)) {
+		fprintf(stderr, "Wrong pending trap 0x%x\n", tn);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sparc_srmmu_stats st, st2;
+	struct snapshot *boot, *mmu;
+	struct cpu *c;
+	struct dev *d, *ram;
+	int ret = -1;
+
+	c = test_mmucpu_open(argc, argv, PROGFILE, MEMSZ);
+	if(c == NULL)
+		goto exit;
+	d = dev_get("mmu0");
+	ram = dev_get("ram0");
+
+	/* Save machine right after boot with a pending trap */
+	test_cpu_raise_trap(c, INTTRAP);
+	boot = snapshot_take();
+	if(boot == NULL) {
+		fprintf(stderr, "Cannot take boot snapshot\n");
+		goto close;
+	}
+
+	/* Build page tables and enable MMU, trap is ignored on first step */
+	ret = test_cpu_steps(c, NRBOOT);
+	if(ret != 0)
+		goto bootfree;
+	ret = test_trap(c, 0);
+	if(ret != 0)
+		goto bootfree;
+	ret = test_cpu_check_reg(c, 4, 0xdeadbeef);
+	if(ret != 0)
+		goto bootfree;
+
+	/* Save machine with a PDC filled with beacon page */
+	mmu = snapshot_take();
+	if(mmu == NULL) {
+		fprintf(stderr, "Cannot take MMU snapshot\n");
+		ret = -1;
+		goto bootfree;
+	}
+
+	/* Clear beacon and flush PDC */
+	ret = test_cpu_steps(c, NRRUN);
+	if(ret != 0)
+		goto free;
+	ret = test_cpu_check_reg(c, 5, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+	ret = test_phymem(ram, BEACON_PA, 0);
+	if(ret != 0)
+		goto free;
+
+	ret = snapshot_restore(mmu);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore MMU snapshot\n");
+		goto free;
+	}
+	ret = test_cpu_check_reg(c, 5, 0);
+	if(ret != 0)
+		goto free;
+
+	/* Beacon page translation is back in PDC, no table walk needed */
+	sparc_srmmu_stats(d, &st);
+	ret = test_cpu_steps(c, 1);
+	if(ret != 0)
+		goto free;
+	sparc_srmmu_stats(d, &st2);
+	if((st2.walk != st.walk) || (st2.hit == st.hit)) {
+		fprintf(stderr, "PDC not restored (walk %lu hit %lu)\n",
+				(unsigned long)(st2.walk - st.walk),
+				(unsigned long)(st2.hit - st.hit));
+		ret = -1;
+		goto free;
+	}
+	ret = test_cpu_check_reg(c, 5, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(c, BEACON_VA, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+
+	/* Back to boot, MMU is disabled and beacon is not there yet */
+	ret = snapshot_restore(boot);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore boot snapshot\n");
+		goto free;
+	}
+	if(test_cpu_get_pc(c) != 0) {
+		fprintf(stderr, "Wrong PC value 0x%x\n", test_cpu_get_pc(c));
+		ret = -1;
+		goto free;
+	}
+	ret = test_cpu_check_reg(c, 4, 0);
+	if(ret != 0)
+		goto free;
+	ret = test_trap(c, 1);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(c, BEACON_PA, 0);
+	if(ret != 0)
+		goto free;
+
+	/* Machine runs the same way again */
+	ret = test_cpu_steps(c, NRBOOT);
+	if(ret != 0)
+		goto free;
+	ret = test_trap(c, 0);
+	if(ret != 0)
+		goto free;
+	ret = test_cpu_check_reg(c, 4, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+
+	printf("[OK]\n");
+	ret = 0;
+
+free:
+	snapshot_free(mmu);
+bootfree:
+	snapshot_free(boot);
+close:
+	test_mmucpu_close(c);
+exit:
+	return ret;
+}
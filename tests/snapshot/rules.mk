@@ -0,0 +1,12 @@
+ifeq ($(TESTS),1)
+	TARGET = t-snapshot
+	CROSSTARGET = snapshot.bin
+endif
+
+t-snapshot-OUTDIR = tests/snapshot
+t-snapshot-CSRC = main.c
+t-snapshot-DEPS = b-test-utils
+
+snapshot.bin-OUTDIR = tests/binaries/snapshot
+snapshot.bin-ASRC = snapshot.s
+snapshot.bin-DEPS = b-test-tsparc-utils
@@ -0,0 +1,66 @@
+.section .text, "ax", @progbits
+
+/*
+CTXTBL: 0x4000
+LVL1 :  0x4400
+LVL2 :  0x4800
+LVL3 :  0x4900
+
+VA: CTX:0, 0x00000000 -> PA: 0x0000 (code)
+VA: CTX:0, 0x01083000 -> PA: 0x3000 (beacon)
+*/
+
+tmain:
+	/* First place a beacon at 0x3000 in physical memory */
+	sethi %hi(0xdeadbeef), %g1
+	or %g1, %lo(0xdeadbeef), %g1
+	sethi %hi(0x3000), %g2
+	st %g1, [%g2]
+
+	/* Set Context Number */
+	or %g0, 0x200, %g1
+	sta %g0, [%g1] 0x4
+
+	/* Set Context Table address */
+	or %g0, 0x100, %g2
+	or %g0, 0x400, %g1 /* 0x400: (0x4000 >> 6) << 2 */
+	sta %g1, [%g2] 0x4
+
+	/* Set Context's LVL1 PA */
+	sethi %hi(0x4000), %g2
+	or %g0, 0x441, %g1 /* 0x441: (0x4400 >> 6) << 2 | ET == PTD */
+	st %g1, [%g2]
+
+	/* Set LVL1's LVL2 PA */
+	or %g0, 0x481, %g1 /* 0x481: (0x4800 >> 6) << 2 | ET == PTD */
+	st %g1, [%g2 + 0x400]
+	st %g1, [%g2 + 0x404]
+
+	/* Set LVL2's LVL3 PA */
+	or %g0, 0x491, %g1 /* 0x491: (0x4900 >> 6) << 2 | ET == PTD */
+	st %g1, [%g2 + 0x800]
+	st %g1, [%g2 + 0x808]
+
+	/* Set LVL3's pages PA */
+	or %g0, 0x0e, %g1 /* 0x0e: (0x0 >> 12) << 8 | ACC == RWX | ET == PTE */
+	st %g1, [%g2 + 0x900]
+	or %g0, 0x30e, %g1 /* 0x30e: (0x3000 >> 12) << 8 | ACC == RWX | PTE */
+	st %g1, [%g2 + 0x90c]
+
+	lda [%g0] 0x4, %g1
+	or %g1, 0x1, %g1
+	sta %g1, [%g0] 0x4 /* Enable MMU */
+
+	sethi %hi(0x01083000), %g3
+	ld [%g3], %g4 /* Get our beacon back */
+
+	/* Snapshot is taken here, PDC holds beacon page */
+	ld [%g3], %g5
+	st %g0, [%g3] /* Clear beacon */
+
+	/* Flush entire PDC */
+	or %g0, 0x400, %g6
+	sta %g0, [%g6] 0x3
+
+	/* Page tables and beacon have to be backed by the image */
+	.org 0x5000
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/sparsemem.h"
+
+#define MB (1024 * 1024)
+#define MEMSZ (512 * MB)
+/* Sparse memory chunk and page table coverage */
+#define CHUNKSZ (64 * 1024)
+#define TBLSZ (256 * MB)
+/* Chunk written before snapshot */
+#define OLDADDR 0x1000
+/* Chunks only written after snapshot, in same and next page table */
+#define NEWADDR (OLDADDR + 4 * CHUNKSZ)
+#define NEWTBLADDR (TBLSZ + OLDADDR)
+
+static struct devcfg const devcfg = {
+	.drvname = "sparse-mem",
+	.name = "smem0",
+	.cfg = DEVCFG(sparsemem_cfg) {
+		.sz = MEMSZ,
+		.perm = MP_R | MP_W,
+	},
+};
+
+/**
+ * Check memory word value
+ */
+static int test_mem(struct dev *d, phyaddr_t addr, uint32_t val)
+{
+	uint32_t v;
+	int ret;
+
+	ret = d->drv->phyops->read32(d, addr, &v);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot read 0x%x\n", (unsigned int)addr);
+		return ret;
+	}
+
+	if(v != val) {
+		fprintf(stderr, "Wrong memory value at 0x%x 0x%x\n",
+				(unsigned int)addr, v);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Check whether host memory backs a device address
+ */
+static int test_backed(struct dev *d, phyaddr_t addr, int backed)
+{
+	struct dev_hostmem hm;
+	int ret;
+
+	ret = d->drv->phyops->hostmem(d, addr, &hm);
+	if((ret == 0) != backed) {
+		fprintf(stderr, "Wrong host memory at 0x%x %d\n",
+				(unsigned int)addr, ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	struct dev_snapshot *snap;
+	struct dev *d;
+	uint8_t buf[64];
+	int ret = -1;
+
+	d = dev_create(&devcfg);
+	if(d == NULL)
+		goto exit;
+
+	/* Untouched memory reads as zero without being allocated */
+	ret = test_mem(d, OLDADDR, 0);
+	if(ret != 0)
+		goto close;
+	ret = test_backed(d, OLDADDR, 0);
+	if(ret != 0)
+		goto close;
+
+	ret = d->drv->phyops->write32(d, OLDADDR, 0xdeadbeef);
+	if(ret != 0)
+		goto close;
+	ret = test_backed(d, OLDADDR, 1);
+	if(ret != 0)
+		goto close;
+
+	/* Block write spanning two chunks */
+	memset(buf, 0xa5, sizeof(buf));
+	ret = d->drv->phyops->write_block(d, CHUNKSZ - sizeof(buf) / 2, buf,
+			sizeof(buf));
+	if(ret != 0)
+		goto close;
+	ret = test_mem(d, CHUNKSZ, 0xa5a5a5a5);
+	if(ret != 0)
+		goto close;
+
+	snap = dev_snapshot_take();
+	if(snap == NULL) {
+		fprintf(stderr, "Cannot take snapshot\n");
+		ret = -1;
+		goto close;
+	}
+
+	ret = d->drv->phyops->write32(d, OLDADDR, 0xb16b00b5);
+	if(ret != 0)
+		goto free;
+	ret = d->drv->phyops->write32(d, NEWADDR, 0x42);
+	if(ret != 0)
+		goto free;
+	ret = d->drv->phyops->write32(d, NEWTBLADDR, 0x43);
+	if(ret != 0)
+		goto free;
+
+	ret = dev_snapshot_restore(snap);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore snapshot\n");
+		goto free;
+	}
+
+	/* Saved chunks are back, chunks allocated since are freed */
+	ret = test_mem(d, OLDADDR, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(d, CHUNKSZ, 0xa5a5a5a5);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(d, NEWADDR, 0);
+	if(ret != 0)
+		goto free;
+	ret = test_backed(d, NEWADDR, 0);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(d, NEWTBLADDR, 0);
+	if(ret != 0)
+		goto free;
+	ret = test_backed(d, NEWTBLADDR, 0);
+	if(ret != 0)
+		goto free;
+
+	/* Memory is still usable after restore */
+	ret = d->drv->phyops->write32(d, NEWTBLADDR, 0x44);
+	if(ret != 0)
+		goto free;
+	ret = test_mem(d, NEWTBLADDR, 0x44);
+	if(ret != 0)
+		goto free;
+
+	printf("[OK]\n");
+	ret = 0;
+
+free:
+	dev_snapshot_free(snap);
+close:
+	dev_destroy(d);
+exit:
+	return ret;
+}
@@ -0,0 +1,7 @@
+ifeq ($(TESTS),1)
+	TARGET = t-sparse
+endif
+
+t-sparse-OUTDIR = tests/sparse
+t-sparse-CSRC = main.c
+t-sparse-DEPS = b-test-utils
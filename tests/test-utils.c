@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -7,11 +8,14 @@
 #include "dev/device.h"
 #include "dev/cfg/ramctl.h"
 #include "dev/cfg/filemem.h"
+#include "dev/cfg/anonmem.h"
 #include "dev/cfg/mmu/sparc/nommu.h"
+#include "dev/cfg/mmu/sparc/srmmu.h"
+#include "loader/loader.h"
 
 #include "test-utils.h"
 
-#include "../cpu/sparc/sparc.h"
+#include "../cpu/sparc/scpu.h"
 
 uint8_t test_cpu_get_cc_n(struct cpu *cpu)
 {
@@ -71,6 +75,16 @@ uint8_t test_cpu_get_mem8(struct cpu *cpu, addr_t addr)
 	return ret;
 }
 
+void test_cpu_raise_trap(struct cpu *cpu, uint8_t tn)
+{
+	tq_raise(&to_sparc_cpu(cpu)->tq, tn);
+}
+
+int test_cpu_trap_pending(struct cpu *cpu, uint8_t *tn)
+{
+	return tq_pending(&to_sparc_cpu(cpu)->tq, tn);
+}
+
 int test_cpu_step(struct cpu *cpu)
 {
 	int ret;
@@ -97,50 +111,87 @@ exit:
 	return ret;
 }
 
+int test_cpu_steps(struct cpu *cpu, size_t nr)
+{
+	size_t i;
+	int ret = 0;
+
+	for(i = 0; i < nr; ++i) {
+		ret = test_cpu_step(cpu);
+		if(ret != 0)
+			break;
+	}
+
+	return ret;
+}
+
+int test_cpu_check_reg(struct cpu *cpu, off_t ridx, uint32_t val)
+{
+	uint32_t reg;
+
+	reg = test_cpu_get_reg(cpu, ridx);
+	if(reg != val) {
+		fprintf(stderr, "Wrong register %d value 0x%x\n", (int)ridx,
+				reg);
+		return -1;
+	}
+
+	return 0;
+}
+
 /* Cpu description */
 static struct cpucfg const cpucfg = {
 	.cpu = "sparc",
 	.name = "cpu0",
 };
 
-static struct cpu *_test_open(int argc, char **argv, struct devcfg *cfg,
-		size_t sz, char const *memfile, size_t memsz)
+/**
+ * Get test file path relative to test program directory
+ */
+int test_path(int argc, char **argv, char const *memfile, char *file,
+		size_t sz)
 {
-	struct filemem_cfg fc = {
-		.off = 0,
-		.sz = memsz,
-	};
-	struct cpu *cpu = NULL;
-	struct dev *d;
-	char file[FILENAME_MAX], *end;
-	size_t i;
-	int ret;
+	char *end;
 
 	if(argc == 0) {
 		fprintf(stderr, "Malformed prog args\n");
-		goto err;
+		return -1;
 	}
 
-	/* Get relative memfile path */
 	end = strrchr(argv[0], '/');
 	if(end) {
-		snprintf(file, FILENAME_MAX - 1, "%.*s/%s",
-				(int)(end - argv[0]), argv[0], memfile);
+		snprintf(file, sz - 1, "%.*s/%s", (int)(end - argv[0]),
+				argv[0], memfile);
 	} else {
-		strncpy(file, memfile, FILENAME_MAX - 1);
+		strncpy(file, memfile, sz - 1);
 	}
-	file[FILENAME_MAX - 1] = '\0';
-	fc.path = file;
-	cfg[0].cfg = &fc;
+	file[sz - 1] = '\0';
+
+	return 0;
+}
+
+/**
+ * Create test cpu and platform devices. TEST_RAMCTL environment variable can
+ * select another RAM controller driver (e.g. ramctl-flat).
+ */
+static struct cpu *_test_create(struct devcfg *cfg, size_t sz)
+{
+	struct cpu *cpu;
+	struct dev *d;
+	char *ramctl;
+	size_t i;
+
+	ramctl = getenv("TEST_RAMCTL");
+	for(i = 0; (ramctl != NULL) && (i < sz); ++i)
+		if(strncmp(cfg[i].drvname, "ramctl", 6) == 0)
+			cfg[i].drvname = ramctl;
 
-	/* Create Cpu */
 	cpu = cpu_create(&cpucfg);
 	if(cpu == NULL) {
 		fprintf(stderr, "Cannot create cpu\n");
-		goto err;
+		return NULL;
 	}
 
-	/* Create devices */
 	for(i = 0; i < sz; ++i) {
 		if(dev_create(&cfg[i]) == NULL) {
 			fprintf(stderr, "Cannot create dev %s\n", cfg[i].name);
@@ -148,12 +199,6 @@ static struct cpu *_test_open(int argc, char **argv, struct devcfg *cfg,
 		}
 	}
 
-	ret = cpu_boot(cpu, 0x0);
-	if(ret < 0) {
-		fprintf(stderr, "Cannot boot cpu\n");
-		goto devexit;
-	}
-
 	return cpu;
 
 devexit:
@@ -161,7 +206,6 @@ devexit:
 		if((d = dev_get(cfg[i - 1].name)) != NULL)
 			dev_destroy(d);
 	cpu_destroy(cpu);
-err:
 	return NULL;
 }
 
@@ -177,6 +221,40 @@ static void _test_close(struct cpu *cpu, struct devcfg *cfg, size_t sz)
 	cpu_destroy(cpu);
 }
 
+static struct cpu *_test_open(int argc, char **argv, struct devcfg *cfg,
+		size_t sz, char const *memfile, size_t memsz)
+{
+	struct filemem_cfg fc = {
+		.off = 0,
+		.sz = memsz,
+	};
+	struct cpu *cpu = NULL;
+	char file[FILENAME_MAX];
+	int ret;
+
+	/* Get relative memfile path */
+	if(test_path(argc, argv, memfile, file, FILENAME_MAX) != 0)
+		goto err;
+	fc.path = file;
+	cfg[0].cfg = &fc;
+
+	cpu = _test_create(cfg, sz);
+	if(cpu == NULL)
+		goto err;
+
+	ret = cpu_boot(cpu, 0x0);
+	if(ret < 0) {
+		fprintf(stderr, "Cannot boot cpu\n");
+		_test_close(cpu, cfg, sz);
+		goto err;
+	}
+
+	return cpu;
+
+err:
+	return NULL;
+}
+
 /* NOMMU platform devices configuration */
 static struct devcfg devcfg[] = {
 	{
@@ -244,7 +322,7 @@ static struct devcfg mmudevcfg[] = {
 	{
 		.drvname = "sparc-srmmu",
 		.name = "mmu0",
-		.cfg = DEVCFG(sparc_nommu_cfg) {
+		.cfg = DEVCFG(sparc_srmmu_cfg) {
 			.dmem = "ram0",
 			.imem = "ram0",
 			.cpu = "cpu0",
@@ -263,3 +341,90 @@ void test_mmucpu_close(struct cpu *cpu)
 {
 	_test_close(cpu, mmudevcfg, ARRAY_SIZE(mmudevcfg));
 }
+
+struct cpu *test_srmmucpu_open(int argc, char **argv, char const *memfile,
+		size_t memsz, size_t pdcsz, size_t prefetch)
+{
+	struct sparc_srmmu_cfg *scfg = mmudevcfg[2].cfg;
+
+	scfg->pdcsz = pdcsz;
+	scfg->prefetch = prefetch;
+	return test_mmucpu_open(argc, argv, memfile, memsz);
+}
+
+/* Raw image platform devices configuration */
+static struct devcfg rawdevcfg[] = {
+	{
+		.drvname = "anon-mem",
+		.name = "rawmem",
+	},
+	{
+		.drvname = "ramctl",
+		.name = "ram0",
+		.cfg = DEVCFG(ramctl_cfg) {
+			.devlst = (struct rammap[]){
+				{
+					.devname = "rawmem",
+					.addr = 0x0,
+					.perm = MP_R | MP_W | MP_X,
+					.sz = -1,
+				},
+				{}, /* Sentinel */
+			},
+		},
+	},
+	{
+		.drvname = "sparc-nommu",
+		.name = "mmu0",
+		.cfg = DEVCFG(sparc_nommu_cfg) {
+			.dmem = "ram0",
+			.imem = "ram0",
+			.cpu = "cpu0",
+		}
+	},
+};
+
+struct cpu *test_rawcpu_open(int argc, char **argv, char const *rawfile,
+		size_t memsz)
+{
+	struct anonmem_cfg ac = {
+		.sz = memsz,
+		.perm = MP_R | MP_W | MP_X,
+	};
+	struct cpu *cpu = NULL;
+	char file[FILENAME_MAX];
+	int ret;
+
+	if(test_path(argc, argv, rawfile, file, FILENAME_MAX) != 0)
+		goto err;
+	rawdevcfg[0].cfg = &ac;
+
+	cpu = _test_create(rawdevcfg, ARRAY_SIZE(rawdevcfg));
+	if(cpu == NULL)
+		goto err;
+
+	/* Copy raw image at the beginning of anonymous memory */
+	ret = load_raw(dev_get("rawmem"), 0x0, file);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot load %s\n", file);
+		goto close;
+	}
+
+	ret = cpu_boot(cpu, 0x0);
+	if(ret < 0) {
+		fprintf(stderr, "Cannot boot cpu\n");
+		goto close;
+	}
+
+	return cpu;
+
+close:
+	test_rawcpu_close(cpu);
+err:
+	return NULL;
+}
+
+void test_rawcpu_close(struct cpu *cpu)
+{
+	_test_close(cpu, rawdevcfg, ARRAY_SIZE(rawdevcfg));
+}
@@ -15,12 +15,23 @@ uint32_t test_cpu_get_y(struct cpu *cpu);
 uint32_t test_cpu_get_mem32(struct cpu *cpu, addr_t addr);
 uint16_t test_cpu_get_mem16(struct cpu *cpu, addr_t addr);
 uint8_t test_cpu_get_mem8(struct cpu *cpu, addr_t addr);
+void test_cpu_raise_trap(struct cpu *cpu, uint8_t tn);
+int test_cpu_trap_pending(struct cpu *cpu, uint8_t *tn);
 int test_cpu_step(struct cpu *cpu);
+int test_cpu_steps(struct cpu *cpu, size_t nr);
+int test_cpu_check_reg(struct cpu *cpu, off_t ridx, uint32_t val);
+int test_path(int argc, char **argv, char const *file, char *path,
+		size_t sz);
 struct cpu *test_cpu_open(int argc, char **argv, char const *memfile,
 		size_t memsz);
 void test_cpu_close(struct cpu *cpu);
 struct cpu *test_mmucpu_open(int argc, char **argv, char const *memfile,
 		size_t memsz);
 void test_mmucpu_close(struct cpu *cpu);
+struct cpu *test_srmmucpu_open(int argc, char **argv, char const *memfile,
+		size_t memsz, size_t pdcsz, size_t prefetch);
+struct cpu *test_rawcpu_open(int argc, char **argv, char const *rawfile,
+		size_t memsz);
+void test_rawcpu_close(struct cpu *cpu);
 
 #endif
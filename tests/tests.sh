@@ -4,120 +4,42 @@ RES=""
 ERR=0
 
 test() {
-	RES="${RES} Test ${2}:\t\t $($(dirname ${0})/${1}/t-${2} 2>&1)\n"
+	RES="${RES} Test ${2}${3:+-${3}}:\t\t $($(dirname ${0})/${1}/t-${2} 2>&1)\n"
 	if [ ${?} -ne 0 ]; then
 		ERR=1
 	fi
 }
 
-test isa sethi
-test isa or
-test isa orcc
-test isa orn
-test isa orncc
-test isa and
-test isa andcc
-test isa andn
-test isa andncc
-test isa xor
-test isa xorcc
-test isa xnor
-test isa xnorcc
-test isa sll
-test isa srl
-test isa sra
-test isa add
-test isa addcc
-test isa addx
-test isa addxcc
-test isa taddcc
-test isa taddcctv
-test isa sub
-test isa subcc
-test isa tsubcc
-test isa tsubcctv
-test isa subx
-test isa subxcc
-test isa g0
-test isa stb
-test isa stba
-test isa sth
-test isa stha
-test isa st
-test isa sta
-test isa std
-test isa stda
-test isa ldsb
-test isa ldsba
-test isa ldub
-test isa lduba
-test isa ldsh
-test isa ldsha
-test isa lduh
-test isa lduha
-test isa ld
-test isa lda
-test isa ldd
-test isa ldda
-test isa ldstub
-test isa ldstuba
-test isa swap
-test isa swapa
-test isa call
-test isa jmpl
-test isa ba
-test isa bn
-test isa bne
-test isa be
-test isa bg
-test isa ble
-test isa bge
-test isa bl
-test isa bgu
-test isa bleu
-test isa bcc
-test isa bcs
-test isa bpos
-test isa bneg
-test isa bvc
-test isa bvs
-test isa save-restore
-test isa rdpsr
-test isa wrpsr
-test isa ta
-test isa tn
-test isa tne
-test isa te
-test isa tg
-test isa tle
-test isa tge
-test isa tl
-test isa tgu
-test isa tleu
-test isa tcc
-test isa tcs
-test isa tpos
-test isa tneg
-test isa tvc
-test isa tvs
-test isa wrwim
-test isa rdwim
-test isa wrtbr
-test isa rdtbr
-test isa rdasr
-test isa wrasr
-test isa mulscc
-test isa umul
-test isa umulcc
-test isa smul
-test isa smulcc
-test isa udiv
-test isa udivcc
-test isa sdiv
-test isa sdivcc
-test isa stbar
-test isa flush
-test isa unimp
+ISA="sethi or orcc orn orncc and andcc andn andncc xor xorcc xnor xnorcc sll
+	srl sra add addcc addx addxcc taddcc taddcctv sub subcc tsubcc tsubcctv
+	subx subxcc g0 stb stba sth stha st sta std stda ldsb ldsba ldub lduba
+	ldsh ldsha lduh lduha ld lda ldd ldda ldstub ldstuba swap swapa call
+	jmpl ba bn bne be bg ble bge bl bgu bleu bcc bcs bpos bneg bvc bvs
+	save-restore rdpsr wrpsr ta tn tne te tg tle tge tl tgu tleu tcc tcs
+	tpos tneg tvc tvs wrwim rdwim wrtbr rdtbr rdasr wrasr mulscc umul
+	umulcc smul smulcc udiv udivcc sdiv sdivcc stbar flush unimp"
+
+for t in ${ISA}; do
+	test isa ${t}
+done
+
+# ISA again on the flat host mirror RAM controller
+export TEST_RAMCTL=ramctl-flat
+for t in ${ISA}; do
+	test isa ${t} flat
+done
+unset TEST_RAMCTL
+
+test run run
+test loader loader
+test sparse sparse
+test anonsnap anonsnap
+test mmu mmu
+test pdcflush pdcflush
+test prefetch prefetch
+test snapshot snapshot
+test filemem filemem
+test zimg zimg
 
 printf "${RES}" | column -t
 
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "types.h"
+#include "dev/device.h"
+#include "dev/cfg/zimgmem.h"
+#include "../dev/mem/lz.h"
+
+#define PGSZ 4096
+/* Image pages: random, repetitive, same repetitive, zero, partial last */
+#define NRPG 5
+#define MEMSZ ((NRPG - 1) * PGSZ + PGSZ / 2)
+#define PG_RAND 0
+#define PG_REP 1
+#define PG_SAME 2
+#define PG_ZERO 3
+#define PG_LAST 4
+
+/**
+ * Compress then decompress a page and check it is left unchanged
+ *
+ * @return: Compressed page size, 0 on error
+ */
+static size_t test_lz(uint8_t const *page)
+{
+	uint8_t blk[2 * PGSZ], out[PGSZ];
+	size_t len;
+
+	len = lz_compress(page, PGSZ, blk, sizeof(blk));
+	if(len == 0) {
+		fprintf(stderr, "Cannot compress page\n");
+		return 0;
+	}
+
+	if(lz_decompress(blk, len, out, sizeof(out)) != 0) {
+		fprintf(stderr, "Cannot decompress page\n");
+		return 0;
+	}
+
+	if(memcmp(page, out, PGSZ) != 0) {
+		fprintf(stderr, "Wrong decompressed page\n");
+		return 0;
+	}
+
+	return len;
+}
+
+/**
+ * Check device memory matches expected content
+ */
+static int test_mem(struct dev *d, uint8_t const *mem, phyaddr_t addr,
+		size_t len)
+{
+	uint8_t buf[MEMSZ];
+	int ret;
+
+	ret = d->drv->phyops->read_block(d, addr, buf, len);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot read 0x%x\n", (unsigned int)addr);
+		return ret;
+	}
+
+	if(memcmp(buf, mem + addr, len) != 0) {
+		fprintf(stderr, "Wrong memory content at 0x%x\n",
+				(unsigned int)addr);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static uint8_t mem[MEMSZ];
+	uint8_t blk[PGSZ - 1];
+	char path[] = "/tmp/sporc-zimg-XXXXXX";
+	struct zimgmem_cfg zc = {
+		.path = path,
+		.sz = -1,
+		.perm = MP_R | MP_W,
+	};
+	struct devcfg const dc = {
+		.drvname = "zimg-mem",
+		.name = "zmem0",
+		.cfg = &zc,
+	};
+	struct dev_snapshot *snap;
+	struct stat st;
+	struct dev *d;
+	size_t i, len;
+	int fd, ret = -1;
+
+	srand(42);
+	for(i = 0; i < PGSZ; ++i) {
+		mem[PG_RAND * PGSZ + i] = rand();
+		mem[PG_REP * PGSZ + i] = "sporc"[i % 5];
+	}
+	memcpy(mem + PG_SAME * PGSZ, mem + PG_REP * PGSZ, PGSZ);
+	memset(mem + PG_LAST * PGSZ, 0xa5, MEMSZ - PG_LAST * PGSZ);
+
+	/* Every kind of page survives a compression round trip */
+	for(i = 0; i < PG_LAST; ++i) {
+		len = test_lz(mem + i * PGSZ);
+		if(len == 0)
+			goto exit;
+		if((i != PG_RAND) && (len >= PGSZ / 16)) {
+			fprintf(stderr, "Page %zu only shrunk to %zu\n", i,
+					len);
+			goto exit;
+		}
+	}
+
+	/* Random page does not shrink, image keeps it as is */
+	if(lz_compress(mem + PG_RAND * PGSZ, PGSZ, blk, sizeof(blk)) != 0) {
+		fprintf(stderr, "Random page shrunk\n");
+		goto exit;
+	}
+
+	fd = mkstemp(path);
+	if(fd < 0) {
+		perror("Cannot create image file");
+		goto exit;
+	}
+	close(fd);
+
+	ret = zimgmem_write(path, mem, MEMSZ);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot write image\n");
+		goto unlink;
+	}
+
+	/* Identical and zero pages take no room in image */
+	ret = -1;
+	if((stat(path, &st) != 0) || (st.st_size >= 2 * PGSZ)) {
+		fprintf(stderr, "Image is too large\n");
+		goto unlink;
+	}
+
+	d = dev_create(&dc);
+	if(d == NULL)
+		goto unlink;
+
+	if(d->drv->phyops->read_block(d, MEMSZ, mem, 1) == 0) {
+		fprintf(stderr, "Memory is larger than image\n");
+		goto close;
+	}
+
+	/* Only the repetitive page is filled before snapshot */
+	ret = test_mem(d, mem, PG_REP * PGSZ, PGSZ);
+	if(ret != 0)
+		goto close;
+
+	snap = dev_snapshot_take();
+	if(snap == NULL) {
+		fprintf(stderr, "Cannot take snapshot\n");
+		ret = -1;
+		goto close;
+	}
+
+	/* Fill new pages, from image or zero */
+	ret = d->drv->phyops->write32(d, PG_SAME * PGSZ, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+	ret = d->drv->phyops->write32(d, PG_ZERO * PGSZ, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+	ret = d->drv->phyops->write32(d, PG_REP * PGSZ, 0xdeadbeef);
+	if(ret != 0)
+		goto free;
+
+	ret = dev_snapshot_restore(snap);
+	if(ret != 0) {
+		fprintf(stderr, "Cannot restore snapshot\n");
+		goto free;
+	}
+
+	/* Pages filled since snapshot are decompressed again */
+	ret = test_mem(d, mem, 0, MEMSZ);
+	if(ret != 0)
+		goto free;
+
+	printf("[OK]\n");
+
+free:
+	dev_snapshot_free(snap);
+close:
+	dev_destroy(d);
+unlink:
+	unlink(path);
+exit:
+	return ret;
+}
@@ -0,0 +1,7 @@
+ifeq ($(TESTS),1)
+	TARGET = t-zimg
+endif
+
+t-zimg-OUTDIR = tests/zimg
+t-zimg-CSRC = main.c
+t-zimg-DEPS = b-test-utils